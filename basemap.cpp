@@ -0,0 +1,149 @@
+#include "basemap.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace {
+
+    /** Bumped whenever render() draws differently, so old cache files go unused. */
+    const unsigned StyleVersion = 1;
+
+    /** Scrambles the bits of a value (the splitmix64 finalizer). */
+    uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    uint64_t bits(double value)
+    {
+        uint64_t result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    uint64_t hashPoint(const Vertex& v)
+    {
+        return mix(bits(v.getExactX()) ^ mix(bits(v.getExactY())));
+    }
+}
+
+BaseMap::BaseMap(const Graph& g, cs225::RGBAPNG background, const string& cacheDirectory)
+    : graph_(&g), snapshot_(NULL), background_(std::move(background)), backgroundHash_(0),
+      cacheDirectory_(cacheDirectory), hasBase_(false), version_(0), key_(0), canvasCurrent_(false),
+      renders_(0), loads_(0)
+{
+    backgroundHash_ = hashImage(background_);
+}
+
+BaseMap::BaseMap(const CsrGraph& g, cs225::RGBAPNG background, const string& cacheDirectory)
+    : graph_(NULL), snapshot_(&g), background_(std::move(background)), backgroundHash_(0),
+      cacheDirectory_(cacheDirectory), hasBase_(false), version_(0), key_(0), canvasCurrent_(false),
+      renders_(0), loads_(0)
+{
+    backgroundHash_ = hashImage(background_);
+}
+
+const cs225::RGBAPNG& BaseMap::base()
+{
+    refresh();
+    return base_;
+}
+
+uint64_t BaseMap::key()
+{
+    refresh();
+    return key_;
+}
+
+/**
+ * Draws the paths on the canvas, after undoing the last ones.
+ */
+const cs225::RGBAPNG& BaseMap::route(const Search& search, Vertex start, Vertex end)
+{
+    refresh();
+    if (!canvasCurrent_) {
+        canvas_ = base_;
+        canvasCurrent_ = true;
+    } else {
+        for (const Search::Region& region : drawn_) {
+            for (unsigned y = region.y0; y < region.y1; y++) {
+                const cs225::RGBAPixel* from = base_.row(y) + region.x0;
+                std::copy(from, from + (region.x1 - region.x0), canvas_.row(y) + region.x0);
+            }
+        }
+    }
+    search.drawPathInto(canvas_, start, end, &drawn_);
+    return canvas_;
+}
+
+void BaseMap::refresh()
+{
+    if (hasBase_ && (graph_ == NULL || version_ == graph_->getVersion())) return;
+
+    EdgeTree tree = graph_ != NULL ? EdgeTree(*graph_) : EdgeTree(*snapshot_);
+    version_ = graph_ != NULL ? graph_->getVersion() : 0;
+    key_ = mix(hashSegments(tree) ^ mix(backgroundHash_ + StyleVersion));
+    hasBase_ = true;
+    canvasCurrent_ = false;
+
+    bool loaded = false;
+    if (!cacheDirectory_.empty() && std::ifstream(cacheFile().c_str()).good()) {
+        loaded = base_.readFromFile(cacheFile()) && base_.width() == background_.width()
+                 && base_.height() == background_.height();
+    }
+    // a snapshot never changes, so its background is not needed again
+    if (loaded) {
+        loads_++;
+        if (graph_ == NULL) background_ = cs225::RGBAPNG();
+    } else {
+        if (graph_ == NULL) {
+            base_ = std::move(background_);
+        } else {
+            base_ = background_;
+        }
+        Graph::renderInto(tree, base_);
+        renders_++;
+        if (!cacheDirectory_.empty()) base_.writeToFile(cacheFile());
+    }
+}
+
+string BaseMap::cacheFile() const
+{
+    char name[40];
+    std::snprintf(name, sizeof(name), "/basemap-%016llx.png", (unsigned long long) key_);
+    return cacheDirectory_ + name;
+}
+
+/**
+ * Sums a hash of each segment, so the order of Graph::edges() does not
+ * matter; a segment hashes the same with its ends swapped.
+ */
+uint64_t BaseMap::hashSegments(const EdgeTree& tree)
+{
+    uint64_t sum = 0;
+    for (const EdgeTree::Segment& segment : tree.segments()) {
+        sum += mix(hashPoint(segment.first) + hashPoint(segment.second));
+    }
+    return mix(sum ^ mix(tree.size()));
+}
+
+uint64_t BaseMap::hashImage(const cs225::RGBAPNG& image)
+{
+    uint64_t hash = mix(((uint64_t) image.width() << 32) | image.height());
+    for (unsigned y = 0; y < image.height(); y++) {
+        const cs225::RGBAPixel* row = image.row(y);
+        for (unsigned x = 0; x < image.width(); x++) {
+            uint32_t pixel;
+            std::memcpy(&pixel, &row[x], sizeof(pixel));
+            hash = (hash ^ pixel) * 0x100000001b3ULL;
+        }
+    }
+    return mix(hash);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file basemap.h
+ * A rendered road map kept between route images.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "cs225/RGBAPNG.h"
+#include "csrgraph.h"
+#include "edgetree.h"
+#include "graph.h"
+#include "search.h"
+#include "vertex.h"
+
+using std::string;
+
+/**
+ * The road network drawn over a background image, rendered once and
+ * reused for every route drawn on top of it.
+ *
+ * The base layer is rendered on first use and again only when a Graph
+ * changes version; a CsrGraph never changes, so it is rendered once. Each
+ * base is identified by a hash of the background pixels and the segments
+ * drawn, so with a cache directory a base rendered by an earlier run of
+ * the same graph and background is read from disk instead.
+ *
+ * route() draws paths on a canvas kept next to the base. Before drawing,
+ * it copies back from the base only the regions the previous route drew
+ * on, so an image costs about as much as drawing its paths, not the map.
+ *
+ * The graph must outlive the map. A map is not safe to use from several
+ * threads at once.
+ */
+class BaseMap
+{
+  public:
+    /**
+     * Prepares to draw a graph, which may change between uses.
+     * @param g - the graph
+     * @param background - the image the network is drawn over
+     * @param cacheDirectory - an existing directory to keep rendered
+     *  bases in, or "" to keep them only in memory
+     */
+    BaseMap(const Graph& g, cs225::RGBAPNG background, const string& cacheDirectory = "");
+
+    /**
+     * Prepares to draw a snapshot.
+     * @param g - the snapshot
+     * @param background - the image the network is drawn over
+     * @param cacheDirectory - an existing directory to keep rendered
+     *  bases in, or "" to keep them only in memory
+     */
+    BaseMap(const CsrGraph& g, cs225::RGBAPNG background, const string& cacheDirectory = "");
+
+    /**
+     * @return the network drawn over the background, rendered or read from
+     *  the cache first if the graph has changed since the last call
+     */
+    const cs225::RGBAPNG& base();
+
+    /**
+     * Draws the bfs and astar paths between two vertices over the base,
+     * as Search::drawPath does.
+     * @param search - a search over the same graph
+     * @return the image, valid until the next call
+     */
+    const cs225::RGBAPNG& route(const Search& search, Vertex start, Vertex end);
+
+    /** @return the hash naming the current base, refreshed first like base() */
+    uint64_t key();
+
+    /** @return the number of bases rendered */
+    unsigned renders() const { return renders_; }
+
+    /** @return the number of bases read from the cache directory */
+    unsigned loads() const { return loads_; }
+
+  private:
+    const Graph* graph_;
+    const CsrGraph* snapshot_;
+    cs225::RGBAPNG background_;     /**< emptied once a snapshot's base is drawn */
+    uint64_t backgroundHash_;
+    string cacheDirectory_;
+
+    bool hasBase_;
+    unsigned long version_;         /**< of graph_ when base_ was drawn */
+    uint64_t key_;
+    cs225::RGBAPNG base_;
+
+    bool canvasCurrent_;            /**< canvas_ is base_ but for drawn_ */
+    cs225::RGBAPNG canvas_;
+    vector<Search::Region> drawn_;  /**< where the last route drew on canvas_ */
+
+    unsigned renders_;
+    unsigned loads_;
+
+    /** Renders or loads base_ unless it is current. */
+    void refresh();
+
+    /** @return the file of the cache directory that holds the base named key_ */
+    string cacheFile() const;
+
+    /** @return a hash of every segment of a tree, whatever their order */
+    static uint64_t hashSegments(const EdgeTree& tree);
+
+    /** @return a hash of the size and pixels of an image */
+    static uint64_t hashImage(const cs225::RGBAPNG& image);
+};
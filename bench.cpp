@@ -0,0 +1,1311 @@
+/**
+ * @file bench.cpp
+ * Benchmark driver for the graph loader, searches and renderer.
+ *
+ * Usage: ./bench <name> [args...]; run without arguments for the list.
+ * Synthetic inputs are written to bench_data/ on first use.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "basemap.h"
+#include "compressedgraph.h"
+#include "contractionhierarchy.h"
+#include "csrgraph.h"
+#include "csvparser.h"
+#include "edgetree.h"
+#include "graph.h"
+#include "landmarks.h"
+#include "search.h"
+#include "spatialindex.h"
+#include "tilepyramid.h"
+#include "vertexorder.h"
+#include "cs225/PNG.h"
+#include "cs225/PNGEncoder.h"
+#include "cs225/RGBAPNG.h"
+#include "cs225/lodepng/lodepng.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** @return seconds elapsed since start */
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Runs f once and returns its wall time in seconds. */
+double timeOnce(const std::function<void()>& f)
+{
+    Clock::time_point start = Clock::now();
+    f();
+    return secondsSince(start);
+}
+
+/**
+ * Paths of a synthetic city written in the same CSV format as the
+ * Oldenburg files.
+ */
+struct SyntheticCity {
+    string vertices;
+    string connections;
+    size_t numVertices;
+    size_t numEdges;
+};
+
+/**
+ * Writes (once) a jittered side x side street grid with some streets
+ * missing. Vertex indices are shuffled so that, like the Oldenburg data,
+ * neighboring vertices do not have neighboring indices.
+ */
+SyntheticCity syntheticCity(unsigned side, unsigned seed = 225)
+{
+    mkdir("bench_data", 0755);
+    string prefix = "bench_data/city_" + std::to_string(side) + "_" + std::to_string(seed);
+    SyntheticCity city;
+    city.vertices = prefix + "_coords.csv";
+    city.connections = prefix + "_network.csv";
+    city.numVertices = (size_t) side * side;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> jitter(-3.0, 3.0);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    vector<int> index(city.numVertices);
+    for (size_t i = 0; i < index.size(); i++) index[i] = (int) i;
+    std::shuffle(index.begin(), index.end(), rng);
+
+    vector<double> xs(city.numVertices), ys(city.numVertices);
+    for (size_t i = 0; i < city.numVertices; i++) {
+        xs[i] = 20.0 + (i % side) * 10.0 + jitter(rng);
+        ys[i] = 20.0 + (i / side) * 10.0 + jitter(rng);
+    }
+
+    vector<std::pair<size_t, size_t>> edges;
+    for (size_t i = 0; i < city.numVertices; i++) {
+        if (i % side + 1 < side && coin(rng) < 0.9) edges.push_back(std::make_pair(i, i + 1));
+        if (i / side + 1 < side && coin(rng) < 0.9) edges.push_back(std::make_pair(i, i + side));
+    }
+    city.numEdges = edges.size();
+
+    struct stat info;
+    if (stat(city.connections.c_str(), &info) == 0) return city;
+
+    std::ofstream vout(city.vertices);
+    vout << std::fixed << std::setprecision(6);
+    vector<size_t> byIndex(city.numVertices);
+    for (size_t i = 0; i < city.numVertices; i++) byIndex[index[i]] = i;
+    for (size_t k = 0; k < city.numVertices; k++) {
+        size_t i = byIndex[k];
+        vout << k << "," << xs[i] << "," << ys[i] << "\r\n";
+    }
+
+    std::ofstream eout(city.connections);
+    eout << std::fixed << std::setprecision(6);
+    for (size_t e = 0; e < edges.size(); e++) {
+        size_t a = edges[e].first, b = edges[e].second;
+        double w = std::hypot(xs[a] - xs[b], ys[a] - ys[b]);
+        eout << e << "," << index[a] << "," << index[b] << "," << w << "\r\n";
+    }
+    return city;
+}
+
+/**
+ * Resolves every edge endpoint by scanning the vertex list, the way
+ * readConnectionsCSV did before it used an index.
+ */
+size_t legacyResolve(const vector<Vertex>& vertices, const vector<std::pair<int, int>>& ends)
+{
+    size_t found = 0;
+    for (const std::pair<int, int>& e : ends) {
+        Vertex one(-1);
+        Vertex two(-1);
+        for (Vertex v : vertices) {
+            if (v.getIndex() == e.first) {
+                one = v;
+            } else if (v.getIndex() == e.second) {
+                two = v;
+            }
+            if (one.getIndex() != -1 && two.getIndex() != -1) break;
+        }
+        found += (one.getIndex() != -1) + (two.getIndex() != -1);
+    }
+    return found;
+}
+
+/** Load time of the CSV constructor on growing synthetic cities. */
+int benchLoad(const vector<string>& args)
+{
+    cout << std::setw(10) << "vertices" << std::setw(10) << "edges"
+         << std::setw(14) << "load (s)" << std::setw(16) << "legacy scan (s)" << endl;
+    for (unsigned side : {32u, 64u, 128u, 256u, 512u}) {
+        SyntheticCity city = syntheticCity(side);
+        double load = timeOnce([&]() { Graph g(city.connections, city.vertices, true); });
+
+        cout << std::setw(10) << city.numVertices << std::setw(10) << city.numEdges
+             << std::setw(14) << std::setprecision(4) << load;
+        if (side <= 128) {
+            // the old O(E * V) endpoint scan on the same input
+            Graph g(city.connections, city.vertices, true);
+            vector<Vertex> vertices = g.getVertices();
+            vector<std::pair<int, int>> ends;
+            for (const Edge& e : g.getEdges())
+                ends.push_back(std::make_pair(e.source.getIndex(), e.dest.getIndex()));
+            double legacy = timeOnce([&]() { legacyResolve(vertices, ends); });
+            cout << std::setw(16) << legacy;
+        } else {
+            cout << std::setw(16) << "-";
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+/**
+ * Parse throughput of the in-place CSV parser next to a plain scan of the
+ * mapped bytes, which is the best a loader could do from the page cache.
+ */
+int benchParse(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    SyntheticCity city = syntheticCity(side);
+
+    cout << std::setw(40) << "file" << std::setw(10) << "rows" << std::setw(10) << "MB"
+         << std::setw(14) << "scan MB/s" << std::setw(14) << "parse MB/s" << endl;
+    for (const string& path : {city.vertices, city.connections}) {
+        MappedFile file(path);
+        double mb = file.size() / 1e6;
+
+        double scan = timeOnce([&]() { csv::countLines(file.begin(), file.end()); });
+
+        size_t rows = 0;
+        double parse = timeOnce([&]() {
+            if (path == city.vertices) {
+                rows = csv::forEachRow<VertexRecord>(file.begin(), file.end(),
+                    [](const VertexRecord& r) {});
+            } else {
+                rows = csv::forEachRow<ConnectionRecord>(file.begin(), file.end(),
+                    [](const ConnectionRecord& r) {});
+            }
+        });
+        cout << std::setw(40) << path << std::setw(10) << rows
+             << std::setw(10) << std::setprecision(4) << mb
+             << std::setw(14) << mb / scan << std::setw(14) << mb / parse << endl;
+    }
+
+    double load = timeOnce([&]() { Graph g(city.connections, city.vertices, true); });
+    cout << "Graph construction: " << load << " s" << endl;
+    return 0;
+}
+
+/**
+ * Scaling of parallel ingestion with the thread count: parsing alone and
+ * the whole CSV constructor.
+ */
+int benchIngest(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    unsigned maxThreads = args.size() > 1 ? std::stoul(args[1])
+                                          : std::max(1u, std::thread::hardware_concurrency());
+    SyntheticCity city = syntheticCity(side);
+    MappedFile file(city.connections);
+
+    cout << city.numVertices << " vertices, " << city.numEdges << " edges, "
+         << file.size() / 1e6 << " MB of connections" << endl;
+    cout << std::setw(8) << "threads" << std::setw(12) << "parse (s)" << std::setw(10) << "speedup"
+         << std::setw(12) << "load (s)" << std::setw(10) << "speedup" << endl;
+
+    double parseBase = 0, loadBase = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        double parse = timeOnce([&]() {
+            csv::parseParallel<ConnectionRecord>(file.begin(), file.end(), threads,
+                                                 [](const ConnectionRecord& r) { return r; });
+        });
+        double load = timeOnce([&]() { Graph g(city.connections, city.vertices, true, threads); });
+        if (threads == 1) {
+            parseBase = parse;
+            loadBase = load;
+        }
+        cout << std::setw(8) << threads << std::setprecision(4)
+             << std::setw(12) << parse << std::setw(10) << parseBase / parse
+             << std::setw(12) << load << std::setw(10) << loadBase / load << endl;
+        if (threads < maxThreads && threads * 2 > maxThreads)
+            threads = maxThreads / 2;
+    }
+    return 0;
+}
+
+/**
+ * Time to a first query answer: CSV load and freeze versus mapping a
+ * binary snapshot written by writeToFile.
+ */
+int benchStartup(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    SyntheticCity city = syntheticCity(side);
+    string snapshotFile = "bench_data/city_" + std::to_string(side) + ".csrg";
+
+    CsrGraph fromCsv;
+    double csv = timeOnce([&]() { fromCsv = Graph(city.connections, city.vertices, true).freeze(); });
+    double write = timeOnce([&]() { fromCsv.writeToFile(snapshotFile); });
+
+    CsrGraph mapped;
+    double map = timeOnce([&]() { mapped.readFromFile(snapshotFile); });
+    Vertex start = mapped.getVertex(0), end = mapped.getVertex(mapped.numVertices() - 1);
+    double query = timeOnce([&]() { Search(mapped).astar(start, end); });
+
+    cout << city.numVertices << " vertices, " << mapped.memoryUsage() / 1e6 << " MB snapshot" << endl;
+    cout << "CSV load + freeze: " << csv << " s" << endl;
+    cout << "snapshot write:    " << write << " s" << endl;
+    cout << "snapshot map:      " << map << " s" << endl;
+    cout << "first query:       " << query << " s (includes page faults)" << endl;
+    return 0;
+}
+
+/**
+ * Latency of short astar queries with a workspace created per query
+ * versus one reused workspace, on graphs of growing size. Clearing the
+ * per-query arrays costs O(V) and the reused workspace does not pay it.
+ */
+int benchWorkspace(const vector<string>& args)
+{
+    const size_t queries = 2000;
+    cout << std::setw(10) << "vertices" << std::setw(16) << "fresh (us/q)"
+         << std::setw(16) << "reused (us/q)" << std::setw(10) << "speedup" << endl;
+    for (unsigned side : {64u, 128u, 256u, 512u, 1024u}) {
+        SyntheticCity city = syntheticCity(side);
+        CsrGraph g = Graph(city.connections, city.vertices, true).freeze();
+        Search search(g);
+
+        // endpoints a few hops apart, as in local routing queries
+        std::mt19937 rng(side);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        while (pairs.size() < queries) {
+            CsrGraph::VertexId start = rng() % g.numVertices(), end = start;
+            for (int hop = 0; hop < 8 && g.arcEnd(end) > g.arcBegin(end); hop++)
+                end = g.target(g.arcBegin(end) + rng() % (g.arcEnd(end) - g.arcBegin(end)));
+            pairs.push_back(std::make_pair(start, end));
+        }
+
+        vector<CsrGraph::VertexId> path;
+        double fresh = timeOnce([&]() {
+            for (const auto& q : pairs) {
+                SearchWorkspace workspace;
+                search.astar(q.first, q.second, workspace, path);
+            }
+        });
+        SearchWorkspace workspace;
+        double reused = timeOnce([&]() {
+            for (const auto& q : pairs)
+                search.astar(q.first, q.second, workspace, path);
+        });
+        cout << std::setw(10) << g.numVertices() << std::setprecision(4)
+             << std::setw(16) << fresh / queries * 1e6 << std::setw(16) << reused / queries * 1e6
+             << std::setw(10) << fresh / reused << endl;
+    }
+    return 0;
+}
+
+/**
+ * The astar Search used before the settled-set rewrite: a vertex is
+ * final once it is pushed, weights and coordinates are truncated to int,
+ * and visited vertices are found by scanning a vector.
+ */
+vector<Vertex> legacyAstar(const Graph& graph, Vertex start, Vertex end, size_t& settled)
+{
+    struct Node {
+        Vertex current;
+        Node* previous;
+        double cost;
+        double priority;
+    };
+    auto heuristic = [](Vertex a, Vertex b) {
+        return sqrt(pow(b.getX() - a.getX(), 2) + pow(b.getY() - a.getY(), 2));
+    };
+    auto compare = [](const Node* lhs, const Node* rhs) { return lhs->priority > rhs->priority; };
+    std::priority_queue<Node*, vector<Node*>, decltype(compare)> queue(compare);
+    vector<std::unique_ptr<Node>> nodes;
+    vector<Vertex> visited;
+
+    nodes.emplace_back(new Node{start, NULL, 0, heuristic(start, end)});
+    queue.push(nodes.back().get());
+    visited.push_back(start);
+    settled = 0;
+
+    Node* current = NULL;
+    while (!queue.empty()) {
+        current = queue.top();
+        queue.pop();
+        settled++;
+        if (current->current == end) break;
+
+        for (Vertex neighbor : graph.getAdjacent(current->current)) {
+            if (std::find(visited.begin(), visited.end(), neighbor) == visited.end()) {
+                double cost = current->cost + (int) graph.getEdgeWeight(current->current, neighbor);
+                nodes.emplace_back(new Node{neighbor, current, cost, cost + heuristic(neighbor, end)});
+                queue.push(nodes.back().get());
+                visited.push_back(neighbor);
+            }
+        }
+    }
+
+    vector<Vertex> path;
+    for (; current != NULL; current = current->previous) path.push_back(current->current);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+/** @return the total weight of a path of vertices */
+double pathWeight(const Graph& graph, const vector<Vertex>& path)
+{
+    double total = 0;
+    for (size_t i = 1; i < path.size(); i++) total += graph.getEdgeWeight(path[i - 1], path[i]);
+    return total;
+}
+
+/**
+ * Settled vertices, latency and path quality of astar on random query
+ * pairs: the legacy search, and the new one with either queue strategy.
+ */
+int benchAstar(const vector<string>& args)
+{
+    size_t queries = args.empty() ? 200 : std::stoul(args[0]);
+    SyntheticCity city = syntheticCity(64);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {"city 64x64", {city.connections, city.vertices}},
+    };
+
+    for (const auto& input : inputs) {
+        Graph graph(input.second.first, input.second.second, true);
+        CsrGraph g = graph.freeze();
+        Search search(g);
+        SearchWorkspace workspace;
+        vector<CsrGraph::VertexId> path;
+
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        while (pairs.size() < queries) {
+            CsrGraph::VertexId s = rng() % g.numVertices(), t = rng() % g.numVertices();
+            if (search.astar(s, t, workspace, path)) pairs.push_back(std::make_pair(s, t));
+        }
+
+        double legacySettled = 0, legacyTime = 0, legacyExcess = 0;
+        size_t legacyWorse = 0;
+        double settled[2] = {0, 0}, time[2] = {0, 0};
+        for (const auto& q : pairs) {
+            Vertex s = g.getVertex(q.first), t = g.getVertex(q.second);
+            size_t count = 0;
+            vector<Vertex> old;
+            legacyTime += timeOnce([&]() { old = legacyAstar(graph, s, t, count); });
+            legacySettled += count;
+
+            for (int strategy = 0; strategy < 2; strategy++) {
+                time[strategy] += timeOnce([&]() {
+                    search.astar(q.first, q.second, workspace, path, (Search::QueueStrategy) strategy);
+                });
+                settled[strategy] += workspace.settledCount();
+            }
+            double optimal = workspace.distance(q.second);
+            double legacyCost = pathWeight(graph, old);
+            if (legacyCost > optimal * (1 + 1e-9)) {
+                legacyWorse++;
+                legacyExcess += legacyCost / optimal - 1;
+            }
+        }
+
+        double n = pairs.size();
+        cout << input.first << ": " << g.numVertices() << " vertices, " << pairs.size() << " queries" << endl;
+        cout << std::setw(24) << "" << std::setw(14) << "settled/q" << std::setw(14) << "us/q" << endl;
+        cout << std::setprecision(4);
+        cout << std::setw(24) << "legacy astar" << std::setw(14) << legacySettled / n
+             << std::setw(14) << legacyTime / n * 1e6 << endl;
+        cout << std::setw(24) << "astar, decrease-key" << std::setw(14) << settled[0] / n
+             << std::setw(14) << time[0] / n * 1e6 << endl;
+        cout << std::setw(24) << "astar, lazy deletion" << std::setw(14) << settled[1] / n
+             << std::setw(14) << time[1] / n * 1e6 << endl;
+        cout << "legacy paths longer than optimal: " << legacyWorse << " of " << pairs.size();
+        if (legacyWorse > 0) cout << ", by " << 100 * legacyExcess / legacyWorse << "% on average";
+        cout << endl << endl;
+    }
+    return 0;
+}
+
+/**
+ * Copy of a snapshot with every coordinate at the origin, on which astar
+ * has no heuristic and is plain Dijkstra.
+ */
+CsrGraph withoutCoordinates(const CsrGraph& g)
+{
+    vector<uint32_t> offsets(1, 0);
+    vector<CsrGraph::VertexId> targets;
+    vector<double> weights;
+    vector<int> indices;
+    for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+        for (uint32_t arc = g.arcBegin(u); arc < g.arcEnd(u); arc++) {
+            targets.push_back(g.target(arc));
+            weights.push_back(g.weight(arc));
+        }
+        offsets.push_back(g.arcEnd(u));
+        indices.push_back(g.getIndex(u));
+    }
+    return CsrGraph(g.isWeighted(), g.isDirected(), offsets, targets, weights,
+                    vector<double>(2 * g.numVertices(), 0.0), indices);
+}
+
+/**
+ * Settled vertices and latency of unidirectional and bidirectional
+ * Dijkstra and astar on random pairs, which are mostly long routes.
+ */
+int benchBidirectional(const vector<string>& args)
+{
+    size_t queries = args.empty() ? 200 : std::stoul(args[0]);
+    SyntheticCity city = syntheticCity(256);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {"city 256x256", {city.connections, city.vertices}},
+    };
+
+    for (const auto& input : inputs) {
+        CsrGraph g = Graph(input.second.first, input.second.second, true).freeze();
+        CsrGraph flat = withoutCoordinates(g);
+        Search search(g);
+        Search dijkstra(flat);
+        SearchWorkspace forward, backward;
+        vector<CsrGraph::VertexId> path;
+
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        while (pairs.size() < queries) {
+            CsrGraph::VertexId s = rng() % g.numVertices(), t = rng() % g.numVertices();
+            if (search.astar(s, t, forward, path)) pairs.push_back(std::make_pair(s, t));
+        }
+
+        const char* names[] = {"dijkstra", "bidirectional dijkstra", "astar", "bidirectional astar"};
+        double settled[4] = {0, 0, 0, 0}, time[4] = {0, 0, 0, 0};
+        for (const auto& q : pairs) {
+            for (int mode = 0; mode < 4; mode++) {
+                time[mode] += timeOnce([&]() {
+                    switch (mode) {
+                        case 0: dijkstra.astar(q.first, q.second, forward, path); break;
+                        case 1: search.bidirectionalDijkstra(q.first, q.second, forward, backward, path); break;
+                        case 2: search.astar(q.first, q.second, forward, path); break;
+                        default: search.bidirectionalAstar(q.first, q.second, forward, backward, path); break;
+                    }
+                });
+                settled[mode] += forward.settledCount() + (mode % 2 == 1 ? backward.settledCount() : 0);
+            }
+        }
+
+        double n = pairs.size();
+        cout << input.first << ": " << g.numVertices() << " vertices, " << pairs.size() << " queries" << endl;
+        cout << std::setw(24) << "" << std::setw(14) << "settled/q" << std::setw(14) << "us/q" << endl;
+        cout << std::setprecision(4);
+        for (int mode = 0; mode < 4; mode++)
+            cout << std::setw(24) << names[mode] << std::setw(14) << settled[mode] / n
+                 << std::setw(14) << time[mode] / n * 1e6 << endl;
+        cout << endl;
+    }
+    return 0;
+}
+
+/**
+ * Contraction Hierarchies: preprocessing time and size, then queries
+ * against bidirectional astar on the same random pairs.
+ */
+int benchHierarchy(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 128 : std::stoul(args[0]);
+    unsigned threads = args.size() > 1 ? std::stoul(args[1])
+                                       : std::max(1u, std::thread::hardware_concurrency());
+    const size_t queries = 1000;
+    SyntheticCity city = syntheticCity(side);
+    string cityName = "city " + std::to_string(side) + "x" + std::to_string(side);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {cityName, {city.connections, city.vertices}},
+    };
+
+    for (const auto& input : inputs) {
+        CsrGraph g = Graph(input.second.first, input.second.second, true).freeze();
+        ContractionHierarchy ch;
+        double build = timeOnce([&]() { ch = ContractionHierarchy(g, threads); });
+        cout << input.first << ": " << g.numVertices() << " vertices, " << g.numArcs() << " arcs" << endl;
+        cout << "  preprocessing: " << build << " s on " << threads << " threads, "
+             << ch.numShortcuts() << " shortcuts, " << ch.numArcs() << " hierarchy arcs" << endl;
+
+        Search search(g);
+        SearchWorkspace forward, backward;
+        vector<CsrGraph::VertexId> path;
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        for (size_t i = 0; i < queries; i++)
+            pairs.push_back(std::make_pair(rng() % g.numVertices(), rng() % g.numVertices()));
+
+        double astarSettled = 0, chSettled = 0;
+        double astarTime = timeOnce([&]() {
+            for (const auto& q : pairs) {
+                search.bidirectionalAstar(q.first, q.second, forward, backward, path);
+                astarSettled += forward.settledCount() + backward.settledCount();
+            }
+        });
+        double chTime = timeOnce([&]() {
+            for (const auto& q : pairs) {
+                ch.query(q.first, q.second, forward, backward, path);
+                chSettled += forward.settledCount() + backward.settledCount();
+            }
+        });
+        cout << std::setprecision(4)
+             << "  bidirectional astar: " << astarSettled / queries << " settled/q, "
+             << astarTime / queries * 1e6 << " us/q" << endl
+             << "  hierarchy:           " << chSettled / queries << " settled/q, "
+             << chTime / queries * 1e6 << " us/q (path unpacked)" << endl;
+    }
+    return 0;
+}
+
+/**
+ * ALT: settled vertices and latency of astar with landmark bounds against
+ * straight-line astar, for both ways of picking landmarks.
+ */
+int benchLandmarks(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 256 : std::stoul(args[0]);
+    unsigned count = args.size() > 1 ? std::stoul(args[1]) : 16;
+    const size_t queries = 1000;
+    SyntheticCity city = syntheticCity(side);
+    string cityName = "city " + std::to_string(side) + "x" + std::to_string(side);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {cityName, {city.connections, city.vertices}},
+    };
+
+    for (const auto& input : inputs) {
+        CsrGraph g = Graph(input.second.first, input.second.second, true).freeze();
+        Search search(g);
+        SearchWorkspace workspace;
+        vector<CsrGraph::VertexId> path;
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        while (pairs.size() < queries) {
+            CsrGraph::VertexId s = rng() % g.numVertices(), t = rng() % g.numVertices();
+            if (search.astar(s, t, workspace, path)) pairs.push_back(std::make_pair(s, t));
+        }
+
+        auto run = [&](const char* name) {
+            double settled = 0;
+            double time = timeOnce([&]() {
+                for (const auto& q : pairs) {
+                    search.astar(q.first, q.second, workspace, path);
+                    settled += workspace.settledCount();
+                }
+            });
+            cout << std::setprecision(4) << "  " << std::left << std::setw(20) << name << std::right
+                 << std::setw(10) << settled / queries << " settled/q" << std::setw(10)
+                 << time / queries * 1e6 << " us/q" << endl;
+        };
+
+        cout << input.first << ": " << g.numVertices() << " vertices, " << queries << " queries" << endl;
+        run("euclidean");
+        const char* names[] = {"farthest", "avoid"};
+        Landmarks::Strategy strategies[] = {Landmarks::Farthest, Landmarks::Avoid};
+        for (int i = 0; i < 2; i++) {
+            Landmarks landmarks;
+            double build = timeOnce([&]() { landmarks = Landmarks(g, count, strategies[i]); });
+            search.setLandmarks(&landmarks);
+            run((string("alt ") + names[i] + " x" + std::to_string(count)).c_str());
+            cout << std::setprecision(4) << "  " << std::setw(20) << "" << build << " s preprocessing, "
+                 << landmarks.memoryUsage() / 1048576.0 << " MiB" << endl;
+            search.setLandmarks(NULL);
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+/**
+ * Counts the cache misses of the calling thread through perf_event_open,
+ * where the kernel allows it.
+ */
+class CacheMissCounter
+{
+  public:
+    CacheMissCounter()
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~CacheMissCounter()
+    {
+        if (fd >= 0) close(fd);
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start()
+    {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    /** @return the misses since start() */
+    long long stop()
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+    }
+
+  private:
+    int fd;
+};
+
+/**
+ * Vertex orderings: how far apart the ends of an arc are in memory, and
+ * astar latency and cache misses on the same random routes.
+ */
+int benchReorder(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 512 : std::stoul(args[0]);
+    size_t queries = args.size() > 1 ? std::stoul(args[1]) : 300;
+    SyntheticCity city = syntheticCity(side);
+    string cityName = "city " + std::to_string(side) + "x" + std::to_string(side);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {cityName, {city.connections, city.vertices}},
+    };
+    CacheMissCounter counter;
+    if (!counter.available())
+        cout << "(cache miss counter not available here)" << endl;
+
+    for (const auto& input : inputs) {
+        CsrGraph base = Graph(input.second.first, input.second.second, true).freeze();
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        for (size_t i = 0; i < queries; i++)
+            pairs.push_back(std::make_pair(rng() % base.numVertices(), rng() % base.numVertices()));
+
+        cout << input.first << ": " << base.numVertices() << " vertices, " << queries << " queries" << endl;
+        cout << std::setw(10) << "ordering" << std::setw(12) << "build (s)" << std::setw(14) << "mean arc gap"
+             << std::setw(12) << "us/q" << std::setw(16) << "misses/q" << endl;
+        for (vertexorder::Ordering ordering : {vertexorder::Original, vertexorder::Hilbert,
+                                               vertexorder::BreadthFirst, vertexorder::ReverseCuthillMcKee}) {
+            vector<CsrGraph::VertexId> order;
+            double build = timeOnce([&]() { order = vertexorder::compute(base, ordering); });
+            CsrGraph g = base.permuted(order);
+            vector<CsrGraph::VertexId> position = vertexorder::inverse(order);
+
+            double gap = 0;
+            for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+                for (CsrGraph::Arc arc : g.neighbors(u))
+                    gap += std::abs((double) arc.target - (double) u);
+            }
+
+            Search search(g);
+            SearchWorkspace workspace;
+            vector<CsrGraph::VertexId> path;
+            search.astar(0, 0, workspace, path);
+            long long misses = 0;
+            if (counter.available()) counter.start();
+            double time = timeOnce([&]() {
+                for (const auto& q : pairs)
+                    search.astar(position[q.first], position[q.second], workspace, path);
+            });
+            if (counter.available()) misses = counter.stop();
+
+            cout << std::setw(10) << vertexorder::name(ordering) << std::setprecision(4)
+                 << std::setw(12) << build << std::setw(14) << gap / g.numArcs()
+                 << std::setw(12) << time / queries * 1e6;
+            if (counter.available()) cout << std::setw(16) << (double) misses / queries;
+            else cout << std::setw(16) << "-";
+            cout << endl;
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+/**
+ * Compressed adjacency: bytes per arc and astar latency next to the plain
+ * snapshot, on Hilbert-ordered graphs.
+ */
+int benchCompress(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 512 : std::stoul(args[0]);
+    size_t queries = args.size() > 1 ? std::stoul(args[1]) : 300;
+    SyntheticCity city = syntheticCity(side);
+    string cityName = "city " + std::to_string(side) + "x" + std::to_string(side);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {cityName, {city.connections, city.vertices}},
+    };
+
+    for (const auto& input : inputs) {
+        CsrGraph base = Graph(input.second.first, input.second.second, true).freeze();
+        CsrGraph g = base.permuted(vertexorder::hilbert(base));
+        std::mt19937 rng(225);
+        vector<std::pair<CsrGraph::VertexId, CsrGraph::VertexId>> pairs;
+        for (size_t i = 0; i < queries; i++)
+            pairs.push_back(std::make_pair(rng() % g.numVertices(), rng() % g.numVertices()));
+
+        cout << input.first << ": " << g.numVertices() << " vertices, " << g.numArcs() << " arcs, "
+             << queries << " queries" << endl;
+        cout << std::setw(14) << "" << std::setw(12) << "arc B/arc" << std::setw(12) << "total B/arc"
+             << std::setw(12) << "us/q" << std::setw(16) << "max cost error" << endl;
+
+        Search search(g);
+        SearchWorkspace workspace;
+        vector<CsrGraph::VertexId> path;
+        vector<double> costs;
+        double time = timeOnce([&]() {
+            for (const auto& q : pairs) {
+                search.astar(q.first, q.second, workspace, path);
+                costs.push_back(workspace.distance(q.second));
+            }
+        });
+        double arcBytes = g.numArcs() * (sizeof(CsrGraph::VertexId) + sizeof(double));
+        cout << std::setw(14) << "csr" << std::setprecision(4) << std::setw(12) << arcBytes / g.numArcs()
+             << std::setw(12) << (double) g.memoryUsage() / g.numArcs()
+             << std::setw(12) << time / queries * 1e6 << std::setw(16) << 0 << endl;
+
+        for (CompressedGraph::WeightBits bits : {CompressedGraph::Weight32, CompressedGraph::Weight16}) {
+            CompressedGraph compressed(g, bits);
+            double error = 0;
+            size_t i = 0;
+            double compressedTime = timeOnce([&]() {
+                for (const auto& q : pairs) {
+                    if (compressed.astar(q.first, q.second, workspace, path))
+                        error = std::max(error, std::abs(workspace.distance(q.second) - costs[i]) / costs[i]);
+                    i++;
+                }
+            });
+            string name = "compressed " + std::to_string((int) bits);
+            cout << std::setw(14) << name << std::setw(12) << (double) compressed.arcBytes() / g.numArcs()
+                 << std::setw(12) << (double) compressed.memoryUsage() / g.numArcs()
+                 << std::setw(12) << compressedTime / queries * 1e6 << std::setw(16) << error << endl;
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+/**
+ * Spatial index build time and nearest-vertex, k-nearest and nearest-edge
+ * lookups from random coordinates, next to a linear scan.
+ */
+int benchSnap(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 512 : std::stoul(args[0]);
+    size_t queries = args.size() > 1 ? std::stoul(args[1]) : 100000;
+    SyntheticCity city = syntheticCity(side);
+    CsrGraph g = Graph(city.connections, city.vertices, true).freeze();
+
+    SpatialIndex index;
+    double build = timeOnce([&]() { index = SpatialIndex(g); });
+    cout << g.numVertices() << " vertices, " << g.numArcs() << " arcs; index built in "
+         << std::setprecision(4) << build * 1e3 << " ms" << endl;
+
+    double minX = g.getX(0), maxX = minX, minY = g.getY(0), maxY = minY;
+    for (CsrGraph::VertexId v = 0; v < g.numVertices(); v++) {
+        minX = std::min(minX, g.getX(v));
+        maxX = std::max(maxX, g.getX(v));
+        minY = std::min(minY, g.getY(v));
+        maxY = std::max(maxY, g.getY(v));
+    }
+    std::mt19937 rng(225);
+    std::uniform_real_distribution<double> xs(minX, maxX), ys(minY, maxY);
+    vector<std::pair<double, double>> points;
+    for (size_t i = 0; i < queries; i++)
+        points.push_back(std::make_pair(xs(rng), ys(rng)));
+
+    size_t checksum = 0;
+    vector<CsrGraph::VertexId> near;
+    SpatialIndex::EdgeSnap snap;
+    double nearest = timeOnce([&]() {
+        for (const auto& p : points) checksum += index.nearest(p.first, p.second);
+    });
+    double kNearest = timeOnce([&]() {
+        for (const auto& p : points) {
+            index.nearest(p.first, p.second, 8, near);
+            checksum += near.back();
+        }
+    });
+    double edge = timeOnce([&]() {
+        for (const auto& p : points) {
+            if (index.nearestEdge(p.first, p.second, snap)) checksum += snap.from;
+        }
+    });
+    size_t scanned = std::min<size_t>(queries, 200);
+    double scan = timeOnce([&]() {
+        for (size_t i = 0; i < scanned; i++) {
+            double best = std::numeric_limits<double>::infinity();
+            CsrGraph::VertexId bestId = 0;
+            for (CsrGraph::VertexId v = 0; v < g.numVertices(); v++) {
+                double d = std::hypot(g.getX(v) - points[i].first, g.getY(v) - points[i].second);
+                if (d < best) {
+                    best = d;
+                    bestId = v;
+                }
+            }
+            checksum += bestId;
+        }
+    });
+
+    cout << std::setw(22) << "lookup" << std::setw(12) << "us/query" << endl;
+    cout << std::setw(22) << "nearest vertex" << std::setw(12) << nearest / queries * 1e6 << endl;
+    cout << std::setw(22) << "8 nearest vertices" << std::setw(12) << kNearest / queries * 1e6 << endl;
+    cout << std::setw(22) << "nearest edge" << std::setw(12) << edge / queries * 1e6 << endl;
+    cout << std::setw(22) << "linear scan" << std::setw(12) << scan / scanned * 1e6 << endl;
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
+
+/**
+ * Rendering a fixed-size crop from the middle of cities of growing size,
+ * through the edge tree and by testing every arc.
+ */
+int benchViewport(const vector<string>& args)
+{
+    unsigned crop = args.empty() ? 512 : std::stoul(args[0]);
+    cout << std::setw(10) << "vertices" << std::setw(10) << "segments" << std::setw(14) << "tree build ms"
+         << std::setw(14) << "tree crop ms" << std::setw(14) << "scan crop ms" << std::setw(10) << "drawn" << endl;
+    for (unsigned side : {256u, 1024u, 2048u}) {
+        SyntheticCity city = syntheticCity(side);
+        CsrGraph g = Graph(city.connections, city.vertices, true).freeze();
+        EdgeTree tree;
+        double build = timeOnce([&]() { tree = EdgeTree(g); });
+
+        int originX = 20 + side * 5 - crop / 2, originY = originX;
+        cs225::PNG png(crop, crop);
+        double viaTree = timeOnce([&]() { Graph::render(tree, png, originX, originY); });
+
+        // the same crop, finding the visible arcs by testing every one
+        size_t drawn = 0;
+        double scan = timeOnce([&]() {
+            cs225::PNG out(png);
+            cs225::HSLAPixel black(226, 1, 0, 1);
+            for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+                Vertex first = g.getVertex(u);
+                for (CsrGraph::Arc arc : g.neighbors(u)) {
+                    Vertex second = g.getVertex(arc.target);
+                    if (u > arc.target) continue;
+                    if (std::max(first.getX(), second.getX()) < originX - 11
+                        || std::min(first.getX(), second.getX()) > originX + (int) crop
+                        || std::max(first.getY(), second.getY()) < originY - 11
+                        || std::min(first.getY(), second.getY()) > originY + (int) crop) continue;
+                    Graph::drawPathHelper(out, black, Vertex(0, first.getX() - originX, first.getY() - originY),
+                                          Vertex(0, second.getX() - originX, second.getY() - originY), 10);
+                    drawn++;
+                }
+            }
+        });
+        cout << std::setw(10) << g.numVertices() << std::setw(10) << tree.size() << std::setprecision(4)
+             << std::setw(14) << build * 1e3 << std::setw(14) << viaTree * 1e3 << std::setw(14) << scan * 1e3
+             << std::setw(10) << drawn << endl;
+    }
+    return 0;
+}
+
+/**
+ * The edges of the full Oldenburg map drawn with stamped squares and with
+ * spans. The 10050 x 10050 map is drawn in tiles, which gives the same
+ * pixels without holding the whole image.
+ */
+int benchRaster(const vector<string>& args)
+{
+    unsigned tile = args.empty() ? 2048 : std::stoul(args[0]);
+    Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+    EdgeTree tree(g);
+    double minX, minY, maxX, maxY;
+    tree.bounds(minX, minY, maxX, maxY);
+    cs225::HSLAPixel black(226, 1, 0, 1);
+
+    double legacy = 0, spans = 0, render = 0;
+    size_t segments = 0, mismatches = 0;
+    vector<EdgeTree::Segment> visible;
+    for (int originY = 0; originY < maxY + 11; originY += tile) {
+        for (int originX = 0; originX < maxX + 11; originX += tile) {
+            tree.inRectangle(originX - 11, originY - 11, originX + (double) tile, originY + (double) tile, visible);
+            segments += visible.size();
+            auto shift = [&](const Vertex& v) { return Vertex(0, v.getX() - originX, v.getY() - originY); };
+            cs225::PNG stamped(tile, tile), filled(tile, tile);
+            legacy += timeOnce([&]() {
+                for (const EdgeTree::Segment& s : visible)
+                    Graph::drawPathStamped(stamped, black, shift(s.first), shift(s.second), 10);
+            });
+            spans += timeOnce([&]() {
+                for (const EdgeTree::Segment& s : visible)
+                    Graph::drawPathHelper(filled, black, shift(s.first), shift(s.second), 10);
+            });
+            if (!(stamped == filled)) mismatches++;
+            render += timeOnce([&]() { Graph::render(tree, cs225::PNG(tile, tile), originX, originY); });
+        }
+    }
+    cout << "oldenburg: " << segments << " segment draws in " << tile << "px tiles" << endl;
+    cout << std::setprecision(4) << "stamped squares: " << legacy * 1e3 << " ms" << endl;
+    cout << "spans:           " << spans * 1e3 << " ms (" << legacy / spans << "x), "
+         << mismatches << " tiles differ" << endl;
+    cout << "full render:     " << render * 1e3 << " ms" << endl;
+    return 0;
+}
+
+/**
+ * Route images of Oldenburg: rendering the map again for every image, as
+ * main does, versus drawing each route over a cached base map.
+ */
+int benchBaseMap(const vector<string>& args)
+{
+    string file = args.empty() ? "background.png" : args[0];
+    unsigned routes = args.size() > 1 ? std::stoul(args[1]) : 20;
+    cs225::RGBAPNG background;
+    if (!background.readFromFile(file)) return 1;
+    CsrGraph g = Graph("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true).freeze();
+    Search search(g);
+    std::mt19937 rng(21);
+    vector<std::pair<Vertex, Vertex>> pairs;
+    for (unsigned i = 0; i < routes; i++)
+        pairs.push_back(std::make_pair(g.getVertex(rng() % g.numVertices()), g.getVertex(rng() % g.numVertices())));
+    cout << background.width() << "x" << background.height() << " image, " << routes << " routes" << endl;
+
+    cs225::RGBAPNG last;
+    double full = timeOnce([&]() {
+        for (const auto& ends : pairs)
+            last = search.drawPath(Graph::render(g, background), ends.first, ends.second);
+    });
+    cout << std::setw(24) << "render every image" << std::setw(12) << std::setprecision(4)
+         << full * 1e3 / routes << " ms/image" << endl;
+
+    BaseMap map(g, background, "bench_data");
+    double first = timeOnce([&]() { map.base(); });
+    double canvas = timeOnce([&]() { map.route(search, pairs[0].first, pairs[0].second); });
+    double cached = timeOnce([&]() {
+        for (const auto& ends : pairs) map.route(search, ends.first, ends.second);
+    });
+    bool same = map.route(search, pairs.back().first, pairs.back().second) == last;
+    cout << std::setw(24) << "render and save the base" << std::setw(12) << first * 1e3 << " ms" << endl;
+    cout << std::setw(24) << "first route (copies it)" << std::setw(12) << canvas * 1e3 << " ms" << endl;
+    cout << std::setw(24) << "routes over the base" << std::setw(12) << cached * 1e3 / routes << " ms/image"
+         << (same ? "" : "  (differs)") << endl;
+
+    double paths = timeOnce([&]() {
+        for (const auto& ends : pairs) {
+            search.BFS(ends.first, ends.second);
+            search.astar(ends.first, ends.second);
+        }
+    });
+    cout << std::setw(24) << "searches alone" << std::setw(12) << paths * 1e3 / routes << " ms/image" << endl;
+
+    BaseMap again(g, background, "bench_data");
+    double load = timeOnce([&]() { again.base(); });
+    cout << std::setw(24) << "base from the cache" << std::setw(12) << load * 1e3 << " ms"
+         << (again.loads() == 1 ? "" : "  (not loaded)") << endl;
+    return 0;
+}
+
+/**
+ * Loading, rendering and saving with HSLA and with packed RGBA8 pixels.
+ */
+int benchImage(const vector<string>& args)
+{
+    string background = args.empty() ? "background.png" : args[0];
+    unsigned crop = args.size() > 1 ? std::stoul(args[1]) : 2048;
+    cout << std::setw(8) << "" << std::setw(12) << "load ms" << std::setw(12) << "MB" << std::setw(14)
+         << "render ms" << std::setw(14) << "save ms" << endl;
+
+    Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+    EdgeTree tree(g);
+    {
+        cs225::PNG png;
+        double load = timeOnce([&]() { png.readFromFile(background); });
+        double mb = png.width() * (double) png.height() * sizeof(cs225::HSLAPixel) / 1e6;
+        cs225::PNG part(crop, crop);
+        double render = timeOnce([&]() { part = Graph::render(tree, part, 4000, 4000); });
+        double save = timeOnce([&]() { part.writeToFile("bench_data/image_hsla.png"); });
+        cout << std::setw(8) << "hsla" << std::setprecision(4) << std::setw(12) << load * 1e3
+             << std::setw(12) << mb << std::setw(14) << render * 1e3 << std::setw(14) << save * 1e3 << endl;
+    }
+    {
+        cs225::RGBAPNG png;
+        double load = timeOnce([&]() { png.readFromFile(background); });
+        double mb = png.width() * (double) png.height() * sizeof(cs225::RGBAPixel) / 1e6;
+        cs225::RGBAPNG part(crop, crop);
+        double render = timeOnce([&]() { part = Graph::render(tree, part, 4000, 4000); });
+        double save = timeOnce([&]() { part.writeToFile("bench_data/image_rgba.png"); });
+        cout << std::setw(8) << "rgba8" << std::setw(12) << load * 1e3 << std::setw(12) << mb
+             << std::setw(14) << render * 1e3 << std::setw(14) << save * 1e3 << endl;
+    }
+    cout << "(render and save are for a " << crop << "x" << crop << " crop of the Oldenburg map)" << endl;
+    return 0;
+}
+
+/**
+ * PNG size versus encode time for each encoder mode, serial and in
+ * stripes on every core, on a crop of the Oldenburg map (few colors) and
+ * on the same crop tinted with a gradient (many colors).
+ */
+int benchEncode(const vector<string>& args)
+{
+    string background = args.empty() ? "background.png" : args[0];
+    unsigned crop = args.size() > 1 ? std::stoul(args[1]) : 4000;
+    cs225::RGBAPNG full;
+    if (!full.readFromFile(background)) return 1;
+    crop = std::min(crop, std::min(full.width(), full.height()));
+    unsigned left = (full.width() - crop) / 2, top = (full.height() - crop) / 2;
+    cs225::RGBAPNG map(crop, crop);
+    for (unsigned y = 0; y < crop; y++) std::copy(full.row(top + y) + left, full.row(top + y) + left + crop, map.row(y));
+    full = cs225::RGBAPNG();
+    Graph::RenderOptions view;
+    view.originX = left;
+    view.originY = top;
+    Graph::renderInto(EdgeTree(Graph("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true)),
+                      map, view);
+    cs225::RGBAPNG tinted = map;
+    for (unsigned y = 0; y < crop; y++) {
+        cs225::RGBAPixel* row = tinted.row(y);
+        for (unsigned x = 0; x < crop; x++) {
+            row[x].r = (unsigned char) (row[x].r + x / 16);
+            row[x].b = (unsigned char) (row[x].b + y / 16);
+        }
+    }
+
+    vector<std::pair<string, cs225::EncodeOptions>> modes(8);
+    modes[0].first = "default";
+    modes[1].first = "fast";
+    modes[1].second.fast = true;
+    modes[2].first = "level 0";
+    modes[2].second.level = 0;
+    modes[3].first = "level 1";
+    modes[3].second.level = 1;
+    modes[4].first = "level 9";
+    modes[4].second.level = 9;
+    modes[5].first = "no filter";
+    modes[5].second.filter = cs225::EncodeOptions::None;
+    modes[6].first = "paeth";
+    modes[6].second.filter = cs225::EncodeOptions::Paeth;
+    modes[7].first = "entropy";
+    modes[7].second.filter = cs225::EncodeOptions::Entropy;
+
+    cout << crop << "x" << crop << " images, " << std::thread::hardware_concurrency() << " cores" << endl;
+    for (const cs225::RGBAPNG* image : {&map, &tinted}) {
+        const unsigned char* pixels = reinterpret_cast<const unsigned char*>(image->row(0));
+        cout << (image == &map ? "map" : "tinted map") << endl;
+        cout << std::setw(12) << "" << std::setw(12) << "serial KB" << std::setw(10) << "ms" << std::setw(14)
+             << "striped KB" << std::setw(10) << "ms" << endl;
+        vector<unsigned char> file;
+        double lodepngTime = timeOnce([&]() { lodepng::encode(file, pixels, crop, crop); });
+        cout << std::setw(12) << "lodepng" << std::setprecision(5) << std::setw(12) << file.size() / 1e3
+             << std::setw(10) << lodepngTime * 1e3 << endl;
+        for (auto& mode : modes) {
+            mode.second.parallel = false;
+            double serial = timeOnce([&]() { cs225::encodePNG(pixels, crop, crop, mode.second, file); });
+            size_t serialSize = file.size();
+            mode.second.parallel = true;
+            double striped = timeOnce([&]() { cs225::encodePNG(pixels, crop, crop, mode.second, file); });
+            cout << std::setw(12) << mode.first << std::setw(12) << serialSize / 1e3 << std::setw(10) << serial * 1e3
+                 << std::setw(14) << file.size() / 1e3 << std::setw(10) << striped * 1e3 << endl;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Full render of a large synthetic city: every arc drawn on one thread,
+ * as Graph::render used to, then the tiled renderer on 1..N threads.
+ */
+int benchTiles(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    unsigned maxThreads = args.size() > 1 ? std::stoul(args[1]) : std::max(4u, std::thread::hardware_concurrency());
+    SyntheticCity city = syntheticCity(side);
+    CsrGraph g = Graph(city.connections, city.vertices, true).freeze();
+    EdgeTree tree(g);
+    unsigned size = 40 + side * 10;
+    cout << g.numVertices() << " vertices, " << tree.size() << " segments, " << size << "x" << size
+         << " image, " << std::thread::hardware_concurrency() << " cores" << endl;
+
+    cs225::RGBAPNG canvas(size, size);
+    double arcs = timeOnce([&]() {
+        cs225::HSLAPixel black(226, 1, 0, 1), pink(328, 1, 0.76, 1);
+        for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+            for (CsrGraph::Arc arc : g.neighbors(u))
+                Graph::drawPathHelper(canvas, black, g.getVertex(u), g.getVertex(arc.target), 10);
+        }
+        for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+            Vertex v = g.getVertex(u);
+            for (int i = 0; i <= 10; i++) {
+                for (int j = 0; j <= 10; j++) canvas.getPixel(v.getX() + i, v.getY() + j) = pink;
+            }
+        }
+    });
+    cout << std::setw(16) << "every arc" << std::setw(12) << std::setprecision(4) << arcs * 1e3 << " ms" << endl;
+
+    double serial = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        cs225::RGBAPNG out;
+        double time = timeOnce([&]() { out = Graph::render(tree, cs225::RGBAPNG(size, size), 0, 0, threads); });
+        if (threads == 1) serial = time;
+        cout << std::setw(10) << threads << " thr" << std::setw(14) << time * 1e3 << " ms" << std::setw(8)
+             << serial / time << "x" << (out == canvas ? "" : "  (differs)") << endl;
+    }
+    return 0;
+}
+
+/**
+ * A 1000x1000 overview of a large synthetic city: every edge drawn to
+ * scale versus edges shorter than a pixel merged into dots.
+ */
+int benchOverview(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    unsigned size = args.size() > 1 ? std::stoul(args[1]) : 1000;
+    SyntheticCity city = syntheticCity(side);
+    double cellSize = args.size() > 2 ? std::stod(args[2]) : Graph::RenderOptions::fit(EdgeTree(), 1, 1).cellSize;
+    EdgeTree tree(Graph(city.connections, city.vertices, true).freeze());
+    cout << tree.size() << " segments, " << size << "x" << size << " image, "
+         << std::thread::hardware_concurrency() << " cores" << endl;
+
+    Graph::RenderOptions merged = Graph::RenderOptions::fit(tree, size, size);
+    merged.cellSize = cellSize;
+    Graph::RenderOptions exact = merged;
+    exact.minLength = 0;
+    exact.cellSize = 0;
+    cs225::RGBAPNG a, b;
+    for (unsigned threads : {1u, 0u}) {
+        merged.threads = exact.threads = threads;
+        double all = timeOnce([&]() { a = Graph::render(tree, cs225::RGBAPNG(size, size), exact); });
+        double lod = timeOnce([&]() { b = Graph::render(tree, cs225::RGBAPNG(size, size), merged); });
+        size_t differ = 0;
+        for (unsigned y = 0; y < size; y++) {
+            for (unsigned x = 0; x < size; x++) differ += a.getPixel(x, y) != b.getPixel(x, y);
+        }
+        cout << std::setw(10) << (threads == 0 ? "all" : "1") << " thr" << std::setprecision(4)
+             << "  every edge " << std::setw(8) << all * 1e3 << " ms"
+             << "  merged " << std::setw(8) << lod * 1e3 << " ms"
+             << "  (" << 100.0 * differ / ((double) size * size) << "% of pixels differ)" << endl;
+    }
+    return 0;
+}
+
+/**
+ * Builds the z/x/y tile pyramid of Oldenburg and of a large synthetic
+ * city, then updates it after a few edges change.
+ */
+int benchPyramid(const vector<string>& args)
+{
+    unsigned side = args.empty() ? 1024 : std::stoul(args[0]);
+    unsigned maxThreads = args.size() > 1 ? std::stoul(args[1]) : std::max(4u, std::thread::hardware_concurrency());
+    SyntheticCity city = syntheticCity(side);
+    vector<std::pair<string, std::pair<string, string>>> inputs = {
+        {"oldenburg", {"sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv"}},
+        {"city " + std::to_string(side), {city.connections, city.vertices}},
+    };
+    cout << std::thread::hardware_concurrency() << " cores" << endl;
+    cout << std::setw(12) << "" << std::setw(8) << "threads" << std::setw(10) << "tiles" << std::setw(8) << "zoom"
+         << std::setw(12) << "s" << std::setw(12) << "tiles/s" << endl;
+
+    for (const auto& input : inputs) {
+        EdgeTree tree(Graph(input.second.first, input.second.second, true).freeze());
+        string directory = "bench_data/tiles_" + input.first.substr(0, input.first.find(' '));
+        TilePyramid pyramid(directory);
+        for (unsigned threads : {1u, maxThreads}) {
+            size_t tiles = 0;
+            double time = timeOnce([&]() { tiles = pyramid.build(tree, threads); });
+            cout << std::setw(12) << input.first << std::setw(8) << threads << std::setw(10) << tiles
+                 << std::setw(8) << pyramid.maxZoom() << std::setw(12) << std::setprecision(4) << time
+                 << std::setw(12) << tiles / time << endl;
+        }
+
+        // move ten segments elsewhere
+        std::mt19937 rng(3);
+        vector<EdgeTree::Segment> segments = tree.segments();
+        for (int i = 0; i < 10; i++) {
+            EdgeTree::Segment& s = segments[rng() % segments.size()];
+            s.second = Vertex(s.second.getIndex(), s.first.getExactX() + 40, s.first.getExactY() + 30);
+        }
+        EdgeTree after(segments);
+        vector<EdgeTree::Segment> changed;
+        TilePyramid::changedSegments(tree, after, changed);
+        size_t tiles = 0;
+        double time = timeOnce([&]() { tiles = pyramid.update(after, changed, maxThreads); });
+        cout << std::setw(12) << input.first << " update of " << changed.size() << " segments: " << tiles
+             << " tiles in " << time * 1e3 << " ms" << endl;
+    }
+    return 0;
+}
+
+struct Benchmark {
+    const char* description;
+    int (*run)(const vector<string>& args);
+};
+
+const std::map<string, Benchmark> benchmarks = {
+    {"astar", {"astar versus the legacy search on random pairs [queries]", benchAstar}},
+    {"basemap", {"route images rendering the map each time versus a cached base [background] [routes]", benchBaseMap}},
+    {"bidirectional", {"one-way versus bidirectional dijkstra and astar [queries]", benchBidirectional}},
+    {"load", {"CSV load time on inputs of increasing size", benchLoad}},
+    {"overview", {"fit a large city into a small image, every edge versus merged [grid side] [image side] [cell size]", benchOverview}},
+    {"parse", {"CSV parse throughput [grid side]", benchParse}},
+    {"pyramid", {"z/x/y map tiles of Oldenburg and a city: build and update [grid side] [max threads]", benchPyramid}},
+    {"raster", {"Oldenburg edges with stamped squares versus spans [tile side]", benchRaster}},
+    {"reorder", {"vertex orderings: locality, latency, cache misses [grid side] [queries]", benchReorder}},
+    {"compress", {"compressed adjacency versus the plain snapshot [grid side] [queries]", benchCompress}},
+    {"hierarchy", {"contraction hierarchy build and queries [grid side] [threads]", benchHierarchy}},
+    {"ingest", {"parallel CSV ingestion, 1..N threads [grid side] [max threads]", benchIngest}},
+    {"encode", {"PNG size versus encode time per encoder mode, serial and striped [background] [crop side]", benchEncode}},
+    {"image", {"load, render and save with HSLA versus RGBA8 pixels [background] [crop side]", benchImage}},
+    {"landmarks", {"ALT versus straight-line astar [grid side] [landmarks]", benchLandmarks}},
+    {"snap", {"spatial index: nearest vertex, k nearest, nearest edge [grid side] [queries]", benchSnap}},
+    {"startup", {"CSV load versus mapped binary snapshot [grid side]", benchStartup}},
+    {"tiles", {"full render, every arc versus tiles on 1..N threads [grid side] [max threads]", benchTiles}},
+    {"viewport", {"render a crop through the edge tree versus scanning every arc [crop side]", benchViewport}},
+    {"workspace", {"short queries with a fresh versus a reused search workspace", benchWorkspace}},
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || benchmarks.find(argv[1]) == benchmarks.end()) {
+        cout << "usage: ./bench <name> [args...]" << endl;
+        for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it)
+            cout << "  " << std::left << std::setw(12) << it->first << it->second.description << endl;
+        return 1;
+    }
+    vector<string> args(argv + 2, argv + argc);
+    return benchmarks.at(argv[1]).run(args);
+}
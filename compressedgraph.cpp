@@ -0,0 +1,145 @@
+#include "compressedgraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "indexedheap.h"
+
+namespace {
+
+    /** Appends value as a base-128 varint, low bits first. */
+    void writeVarint(vector<uint8_t>& out, uint32_t value)
+    {
+        while (value >= 0x80) {
+            out.push_back((uint8_t) (value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t) value);
+    }
+
+    /** Maps a signed difference to an unsigned one: 0, -1, 1, -2, ... */
+    uint32_t zigzag(int64_t value)
+    {
+        return (uint32_t) ((value << 1) ^ (value >> 63));
+    }
+}
+
+CompressedGraph::CompressedGraph()
+    : directed_(false), numVertices_(0), numArcs_(0), weightBytes_(4), scale_(0), heuristicScale_(0),
+      offsets_(1, 0)
+{
+}
+
+CompressedGraph::CompressedGraph(const CsrGraph& g, WeightBits bits)
+    : directed_(g.isDirected()), numVertices_(g.numVertices()), numArcs_(g.numArcs()),
+      weightBytes_(bits / 8), scale_(0), heuristicScale_(0)
+{
+    double maxWeight = 0;
+    for (VertexId u = 0; u < numVertices_; u++) {
+        for (CsrGraph::Arc arc : g.neighbors(u)) {
+            if (arc.weight < 0)
+                throw std::invalid_argument("CompressedGraph: negative weight");
+            maxWeight = std::max(maxWeight, arc.weight);
+        }
+    }
+    double maxStored = bits == Weight16 ? 65535.0 : 4294967295.0;
+    scale_ = maxWeight > 0 ? maxWeight / maxStored : 1;
+
+    offsets_.reserve(numVertices_ + 1);
+    arcs_.reserve(numArcs_ * (2 + weightBytes_) + numVertices_);
+    coords_.reserve(2 * numVertices_);
+    indices_.reserve(numVertices_);
+    vector<std::pair<VertexId, uint32_t>> sorted;
+    for (VertexId u = 0; u < numVertices_; u++) {
+        if (arcs_.size() > UINT32_MAX)
+            throw std::length_error("CompressedGraph: more than 4 GiB of arcs");
+        offsets_.push_back((uint32_t) arcs_.size());
+        coords_.push_back(g.getX(u));
+        coords_.push_back(g.getY(u));
+        indices_.push_back(g.getIndex(u));
+
+        sorted.clear();
+        for (CsrGraph::Arc arc : g.neighbors(u)) {
+            double rounded = std::round(arc.weight / scale_);
+            sorted.push_back(std::make_pair(arc.target, (uint32_t) std::min(rounded, maxStored)));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        writeVarint(arcs_, (uint32_t) sorted.size());
+        VertexId previous = u;
+        for (size_t i = 0; i < sorted.size(); i++) {
+            if (i == 0)
+                writeVarint(arcs_, zigzag((int64_t) sorted[i].first - (int64_t) u));
+            else
+                writeVarint(arcs_, sorted[i].first - previous);
+            previous = sorted[i].first;
+            uint32_t q = sorted[i].second;
+            for (unsigned b = 0; b < weightBytes_; b++)
+                arcs_.push_back((uint8_t) (q >> (8 * b)));
+        }
+    }
+    offsets_.push_back((uint32_t) arcs_.size());
+    arcs_.shrink_to_fit();
+
+    // the largest factor that keeps straight-line distance below every
+    // rounded weight, as Search does for its snapshots
+    double heuristicScale = std::numeric_limits<double>::infinity();
+    for (VertexId u = 0; u < numVertices_; u++) {
+        for (CsrGraph::Arc arc : neighbors(u)) {
+            double length = std::hypot(getX(arc.target) - getX(u), getY(arc.target) - getY(u));
+            if (length > 0)
+                heuristicScale = std::min(heuristicScale, arc.weight / length);
+        }
+    }
+    heuristicScale_ = std::isinf(heuristicScale) ? 0 : heuristicScale;
+}
+
+bool CompressedGraph::astar(VertexId start, VertexId end, SearchWorkspace& workspace,
+                            vector<VertexId>& path) const
+{
+    workspace.reset(numVertices_);
+    path.clear();
+    IndexedHeap<>& heap = workspace.indexedHeap();
+
+    auto heuristic = [&](VertexId v) {
+        return heuristicScale_ * std::hypot(getX(end) - getX(v), getY(end) - getY(v));
+    };
+
+    workspace.reach(start, CsrGraph::InvalidId, 0);
+    heap.push(start, heuristic(start));
+    while (!heap.empty()) {
+        VertexId current = heap.pop().vertex;
+        workspace.settle(current);
+        if (current == end) {
+            workspace.tracePath(end, path);
+            return true;
+        }
+
+        double cost = workspace.distance(current);
+        for (CsrGraph::Arc arc : neighbors(current)) {
+            VertexId neighbor = arc.target;
+            if (workspace.isSettled(neighbor)) continue;
+
+            double nextCost = cost + arc.weight;
+            bool seen = workspace.isReached(neighbor);
+            if (seen && nextCost >= workspace.distance(neighbor)) continue;
+
+            workspace.reach(neighbor, current, nextCost);
+            double priority = nextCost + heuristic(neighbor);
+            if (seen)
+                heap.decreaseKey(neighbor, priority);
+            else
+                heap.push(neighbor, priority);
+        }
+    }
+    return false;
+}
+
+size_t CompressedGraph::memoryUsage() const
+{
+    return offsets_.size() * sizeof(uint32_t) + arcs_.size() + coords_.size() * sizeof(double)
+           + indices_.size() * sizeof(int);
+}
@@ -0,0 +1,198 @@
+/**
+ * @file compressedgraph.h
+ * Compressed adjacency lists for graphs too large for a plain CsrGraph.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "csrgraph.h"
+#include "searchworkspace.h"
+#include "vertex.h"
+
+using std::vector;
+
+/**
+ * Read-only graph whose arcs are stored in a few bytes each.
+ *
+ * A CsrGraph spends 12 bytes on every arc: a 32-bit target and a 64-bit
+ * weight. Here each vertex's arcs are sorted by target and written as one
+ * byte record: the number of arcs, then for every arc the distance from
+ * the previous target (from the vertex itself for the first, zigzag
+ * encoded since it may be negative) as a base-128 varint, followed by the
+ * weight quantized to 16 or 32 bits with one scale for the whole graph.
+ * On a locality-ordered graph (see vertexorder.h) most targets are near
+ * their source, so a target takes one or two bytes.
+ *
+ * neighbors() decodes arcs on the fly, so searches walk the compressed
+ * lists directly; astar() is such a search. Vertex ids are those of the
+ * CsrGraph the graph was built from, and coordinates and indices are kept
+ * as they are there.
+ *
+ * A compressed graph never changes once built, so any number of threads
+ * may query it at the same time, each with its own workspace.
+ */
+class CompressedGraph
+{
+  public:
+    typedef CsrGraph::VertexId VertexId;
+
+    /** Bits kept of each weight. */
+    enum WeightBits { Weight16 = 16, Weight32 = 32 };
+
+    /**
+     * The arcs leaving one vertex, decoded while they are walked:
+     *   for (CsrGraph::Arc arc : g.neighbors(u)) ...
+     */
+    class ArcRange
+    {
+      public:
+        class iterator
+        {
+          public:
+            iterator(const uint8_t* p, uint32_t remaining, VertexId source, const CompressedGraph* g)
+                : p_(p), remaining_(remaining), previous_(source), first_(true), g_(g)
+            {
+                if (remaining_ > 0)
+                    decode();
+            }
+            CsrGraph::Arc operator*() const { return arc_; }
+            iterator& operator++()
+            {
+                if (--remaining_ > 0)
+                    decode();
+                return *this;
+            }
+            bool operator!=(const iterator& other) const { return remaining_ != other.remaining_; }
+            bool operator==(const iterator& other) const { return remaining_ == other.remaining_; }
+
+          private:
+            const uint8_t* p_;
+            uint32_t remaining_;
+            VertexId previous_;
+            bool first_;
+            const CompressedGraph* g_;
+            CsrGraph::Arc arc_;
+
+            void decode()
+            {
+                uint32_t delta = readVarint(p_);
+                if (first_) {
+                    // zigzag: the first target may lie below the source
+                    previous_ = (VertexId) ((int64_t) previous_ + ((int64_t) (delta >> 1) ^ -(int64_t) (delta & 1)));
+                    first_ = false;
+                } else {
+                    previous_ += delta;
+                }
+                arc_.target = previous_;
+                arc_.weight = g_->readWeight(p_);
+            }
+        };
+
+        ArcRange(const uint8_t* p, VertexId source, const CompressedGraph* g)
+            : p_(p), source_(source), g_(g) {}
+
+        iterator begin() const
+        {
+            const uint8_t* p = p_;
+            uint32_t count = readVarint(p);
+            return iterator(p, count, source_, g_);
+        }
+        iterator end() const { return iterator(NULL, 0, 0, g_); }
+        uint32_t size() const
+        {
+            const uint8_t* p = p_;
+            return readVarint(p);
+        }
+        bool empty() const { return size() == 0; }
+
+      private:
+        const uint8_t* p_;
+        VertexId source_;
+        const CompressedGraph* g_;
+    };
+
+    /**
+     * Creates an empty graph.
+     */
+    CompressedGraph();
+
+    /**
+     * Compresses the arcs of a snapshot. Weights are rounded to a multiple
+     * of maxWeight / (2^bits - 1), so shortest paths are exact for the
+     * rounded weights and within that rounding of the original ones.
+     * @param g - the snapshot; order it with vertexorder first for the
+     *  best compression
+     * @param bits - bits kept of each weight
+     */
+    explicit CompressedGraph(const CsrGraph& g, WeightBits bits = Weight32);
+
+    uint32_t numVertices() const { return numVertices_; }
+    size_t numArcs() const { return numArcs_; }
+    bool isDirected() const { return directed_; }
+
+    /** @return the weight of one unit of a stored weight */
+    double weightScale() const { return scale_; }
+
+    /** @return the arcs leaving u, decoded as they are walked */
+    ArcRange neighbors(VertexId u) const { return ArcRange(arcs_.data() + offsets_[u], u, this); }
+
+    Vertex getVertex(VertexId id) const
+    {
+        return Vertex(indices_[id], coords_[2 * id], coords_[2 * id + 1]);
+    }
+
+    double getX(VertexId id) const { return coords_[2 * id]; }
+    double getY(VertexId id) const { return coords_[2 * id + 1]; }
+
+    /**
+     * Finds the shortest path between two ids with astar, walking the
+     * compressed arcs directly. Same contract as Search::astar().
+     * @param start - id of the first vertex
+     * @param end - id of the last vertex
+     * @param workspace - scratch state, reset by the query
+     * @param path - cleared and filled with the ids on the path
+     * @return true, if end was reached
+     */
+    bool astar(VertexId start, VertexId end, SearchWorkspace& workspace, vector<VertexId>& path) const;
+
+    /** @return the number of bytes held by the encoded arcs */
+    size_t arcBytes() const { return arcs_.size(); }
+
+    /** @return the number of bytes held by the graph */
+    size_t memoryUsage() const;
+
+  private:
+    bool directed_;
+    uint32_t numVertices_;
+    size_t numArcs_;
+    unsigned weightBytes_;
+    double scale_;
+    double heuristicScale_;
+    vector<uint32_t> offsets_;      /**< start of each vertex's record in arcs_ */
+    vector<uint8_t> arcs_;          /**< the encoded records */
+    vector<double> coords_;         /**< interleaved x, y per vertex */
+    vector<int> indices_;           /**< original vertex index per id */
+
+    /** Reads a varint at p and moves p past it. */
+    static uint32_t readVarint(const uint8_t*& p)
+    {
+        uint32_t value = *p & 0x7f;
+        for (unsigned shift = 7; *p++ & 0x80; shift += 7)
+            value |= (uint32_t) (*p & 0x7f) << shift;
+        return value;
+    }
+
+    /** Reads a stored weight at p and moves p past it. */
+    double readWeight(const uint8_t*& p) const
+    {
+        uint32_t q = 0;
+        std::memcpy(&q, p, weightBytes_);   // little-endian: low bytes first
+        p += weightBytes_;
+        return q * scale_;
+    }
+};
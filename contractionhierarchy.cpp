@@ -0,0 +1,688 @@
+#include "contractionhierarchy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+#include "indexedheap.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+const uint32_t ContractionHierarchy::FileVersion = 1;
+
+namespace {
+
+    typedef CsrGraph::VertexId VertexId;
+
+    /** Heap storage for a hierarchy built in memory. */
+    struct Buffers
+    {
+        vector<uint32_t> ranks;
+        vector<uint32_t> upOffsets;
+        vector<VertexId> upTargets;
+        vector<double> upWeights;
+        vector<VertexId> upMiddles;
+        vector<uint32_t> downOffsets;
+        vector<VertexId> downSources;
+        vector<double> downWeights;
+        vector<VertexId> downMiddles;
+    };
+
+    /** Arc of the graph being contracted, kept at both of its ends. */
+    struct Arc
+    {
+        VertexId other;     /**< target of an out-arc, source of an in-arc */
+        double weight;
+        VertexId middle;    /**< vertex a shortcut bypasses, or InvalidId */
+    };
+
+    struct Shortcut
+    {
+        VertexId from;
+        VertexId to;
+        double weight;
+    };
+
+    /**
+     * Vertices a witness search may settle before it gives up. Giving up
+     * only costs an unneeded shortcut, never a wrong answer.
+     */
+    const size_t WitnessSettleLimit = 100;
+
+    /**
+     * The graph while it is being contracted: in- and out-arcs of every
+     * vertex not contracted yet, plus the arcs each contracted vertex had
+     * when it was removed, which become the hierarchy.
+     */
+    class Contractor
+    {
+      public:
+        Contractor(const CsrGraph& graph, unsigned threads);
+
+        /** Contracts every vertex and writes the hierarchy's arrays. */
+        void run(Buffers& result);
+
+      private:
+        uint32_t n;
+        unsigned threads;
+        vector<vector<Arc>> out;
+        vector<vector<Arc>> in;
+        vector<char> removed;               /**< contracted or being contracted */
+        vector<uint32_t> contractedNeighbors;
+        vector<uint32_t> level;             /**< depth in the hierarchy so far */
+        vector<int> priority;
+        vector<SearchWorkspace> workspaces; /**< one per thread */
+        vector<vector<Shortcut>> scratch;   /**< one per thread */
+
+        void addArc(VertexId from, VertexId to, double weight, VertexId middle);
+        void witnessSearch(VertexId source, VertexId skip, double limit, SearchWorkspace& workspace) const;
+        void findShortcuts(VertexId v, SearchWorkspace& workspace, vector<Shortcut>& shortcuts) const;
+        int computePriority(VertexId v, unsigned thread);
+        bool isLocalMinimum(VertexId v) const;
+    };
+
+    Contractor::Contractor(const CsrGraph& graph, unsigned threads)
+        : n(graph.numVertices()), threads(threads), out(n), in(n), removed(n, 0),
+          contractedNeighbors(n, 0), level(n, 0), priority(n, 0), workspaces(threads), scratch(threads)
+    {
+        for (VertexId u = 0; u < n; u++) {
+            for (uint32_t arc = graph.arcBegin(u); arc < graph.arcEnd(u); arc++) {
+                if (graph.target(arc) != u)
+                    addArc(u, graph.target(arc), graph.weight(arc), CsrGraph::InvalidId);
+            }
+        }
+    }
+
+    /** Adds an arc, or lowers the weight of an existing one between the same ends. */
+    void Contractor::addArc(VertexId from, VertexId to, double weight, VertexId middle)
+    {
+        for (Arc& arc : out[from]) {
+            if (arc.other != to)
+                continue;
+            if (weight < arc.weight) {
+                arc.weight = weight;
+                arc.middle = middle;
+                for (Arc& back : in[to]) {
+                    if (back.other == from) {
+                        back.weight = weight;
+                        back.middle = middle;
+                    }
+                }
+            }
+            return;
+        }
+        Arc forward = {to, weight, middle};
+        Arc backward = {from, weight, middle};
+        out[from].push_back(forward);
+        in[to].push_back(backward);
+    }
+
+    /**
+     * Dijkstra from source, avoiding skip and removed vertices, until it
+     * passes limit or has settled every out-neighbor of skip.
+     */
+    void Contractor::witnessSearch(VertexId source, VertexId skip, double limit,
+                                   SearchWorkspace& workspace) const
+    {
+        size_t targets = 0;
+        for (const Arc& arc : out[skip])
+            targets += arc.other != source;
+
+        workspace.reset(n);
+        IndexedHeap<>& heap = workspace.indexedHeap();
+        workspace.reach(source, CsrGraph::InvalidId, 0);
+        heap.push(source, 0);
+
+        while (!heap.empty()) {
+            IndexedHeap<>::Entry top = heap.pop();
+            if (top.key > limit || workspace.settledCount() >= WitnessSettleLimit)
+                break;
+            workspace.settle(top.vertex);
+            for (const Arc& arc : out[skip])
+                targets -= arc.other == top.vertex;
+            if (targets == 0)
+                break;
+
+            for (const Arc& arc : out[top.vertex]) {
+                VertexId next = arc.other;
+                if (next == skip || removed[next] || workspace.isSettled(next))
+                    continue;
+                double distance = top.key + arc.weight;
+                if (!workspace.isReached(next)) {
+                    workspace.reach(next, top.vertex, distance);
+                    heap.push(next, distance);
+                } else if (distance < workspace.distance(next)) {
+                    workspace.reach(next, top.vertex, distance);
+                    heap.decreaseKey(next, distance);
+                }
+            }
+        }
+    }
+
+    /** Lists the shortcuts needed to contract v. */
+    void Contractor::findShortcuts(VertexId v, SearchWorkspace& workspace,
+                                   vector<Shortcut>& shortcuts) const
+    {
+        shortcuts.clear();
+        double longestOut = 0;
+        for (const Arc& second : out[v])
+            longestOut = std::max(longestOut, second.weight);
+
+        for (const Arc& first : in[v]) {
+            VertexId u = first.other;
+            witnessSearch(u, v, first.weight + longestOut, workspace);
+            for (const Arc& second : out[v]) {
+                VertexId w = second.other;
+                if (w == u)
+                    continue;
+                double through = first.weight + second.weight;
+                // any path found is a witness, settled or not
+                if (workspace.isReached(w) && workspace.distance(w) <= through)
+                    continue;
+                Shortcut shortcut = {u, w, through};
+                shortcuts.push_back(shortcut);
+            }
+        }
+    }
+
+    /**
+     * Edge difference of contracting v plus its contracted neighbors and
+     * its level (one more than the highest contracted neighbor), which
+     * keeps the hierarchy shallow by spreading contraction over the map.
+     */
+    int Contractor::computePriority(VertexId v, unsigned thread)
+    {
+        findShortcuts(v, workspaces[thread], scratch[thread]);
+        int edgeDifference = (int) scratch[thread].size() - (int) (in[v].size() + out[v].size());
+        return edgeDifference + (int) contractedNeighbors[v] + (int) level[v];
+    }
+
+    /** Orders vertices by priority, ties broken by a hash of the id. */
+    bool lessImportant(int priority, VertexId v, int otherPriority, VertexId other)
+    {
+        if (priority != otherPriority)
+            return priority < otherPriority;
+        uint32_t hash = v * 2654435761u, otherHash = other * 2654435761u;
+        if (hash != otherHash)
+            return hash < otherHash;
+        return v < other;
+    }
+
+    /** Whether v is less important than every remaining neighbor. */
+    bool Contractor::isLocalMinimum(VertexId v) const
+    {
+        for (const vector<Arc>* arcs : {&out[v], &in[v]}) {
+            for (const Arc& arc : *arcs) {
+                if (!lessImportant(priority[v], v, priority[arc.other], arc.other))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void Contractor::run(Buffers& result)
+    {
+        vector<vector<Arc>> up(n);
+        vector<vector<Arc>> down(n);
+        result.ranks.assign(n, 0);
+
+        vector<VertexId> remaining(n);
+        for (VertexId v = 0; v < n; v++)
+            remaining[v] = v;
+        parallelFor(n, threads, [&](size_t i, unsigned thread) {
+            priority[i] = computePriority((VertexId) i, thread);
+        });
+
+        uint32_t nextRank = 0;
+        vector<VertexId> selected;
+        vector<vector<Shortcut>> shortcuts;
+        vector<VertexId> touched;
+        while (!remaining.empty()) {
+            // vertices that are less important than all their neighbors
+            // are never adjacent, so they can be contracted together
+            selected.clear();
+            for (VertexId v : remaining) {
+                if (isLocalMinimum(v))
+                    selected.push_back(v);
+            }
+            for (VertexId v : selected)
+                removed[v] = 1;
+
+            // witness searches avoid every vertex of the round
+            shortcuts.resize(selected.size());
+            parallelFor(selected.size(), threads, [&](size_t i, unsigned thread) {
+                findShortcuts(selected[i], workspaces[thread], shortcuts[i]);
+            });
+
+            touched.clear();
+            for (size_t i = 0; i < selected.size(); i++) {
+                VertexId v = selected[i];
+                result.ranks[v] = nextRank++;
+                up[v].swap(out[v]);
+                down[v].swap(in[v]);
+
+                size_t firstNeighbor = touched.size();
+                for (const Arc& arc : up[v]) {
+                    vector<Arc>& arcs = in[arc.other];
+                    arcs.erase(std::remove_if(arcs.begin(), arcs.end(),
+                                              [v](const Arc& a) { return a.other == v; }), arcs.end());
+                    touched.push_back(arc.other);
+                }
+                for (const Arc& arc : down[v]) {
+                    vector<Arc>& arcs = out[arc.other];
+                    arcs.erase(std::remove_if(arcs.begin(), arcs.end(),
+                                              [v](const Arc& a) { return a.other == v; }), arcs.end());
+                    touched.push_back(arc.other);
+                }
+                std::sort(touched.begin() + firstNeighbor, touched.end());
+                touched.erase(std::unique(touched.begin() + firstNeighbor, touched.end()), touched.end());
+                for (size_t k = firstNeighbor; k < touched.size(); k++) {
+                    contractedNeighbors[touched[k]]++;
+                    level[touched[k]] = std::max(level[touched[k]], level[v] + 1);
+                }
+
+                for (const Shortcut& shortcut : shortcuts[i])
+                    addArc(shortcut.from, shortcut.to, shortcut.weight, v);
+            }
+
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            parallelFor(touched.size(), threads, [&](size_t i, unsigned thread) {
+                priority[touched[i]] = computePriority(touched[i], thread);
+            });
+
+            remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                           [this](VertexId v) { return removed[v] != 0; }),
+                            remaining.end());
+        }
+
+        result.upOffsets.assign(1, 0);
+        result.downOffsets.assign(1, 0);
+        for (VertexId v = 0; v < n; v++) {
+            for (const Arc& arc : up[v]) {
+                result.upTargets.push_back(arc.other);
+                result.upWeights.push_back(arc.weight);
+                result.upMiddles.push_back(arc.middle);
+            }
+            for (const Arc& arc : down[v]) {
+                result.downSources.push_back(arc.other);
+                result.downWeights.push_back(arc.weight);
+                result.downMiddles.push_back(arc.middle);
+            }
+            result.upOffsets.push_back((uint32_t) result.upTargets.size());
+            result.downOffsets.push_back((uint32_t) result.downSources.size());
+        }
+    }
+
+    const char FileMagic[8] = {'C', 'H', 'I', 'E', 'R', 'A', 'R', 'C'};
+    const uint32_t ByteOrderMark = 0x01020304;
+
+    /** Order of the arrays in a hierarchy file. */
+    enum Section {
+        Ranks, UpOffsets, UpTargets, UpWeights, UpMiddles,
+        DownOffsets, DownSources, DownWeights, DownMiddles, NumSections
+    };
+
+    /**
+     * Fixed-size header at the start of a hierarchy file; laid out like
+     * the snapshot header, with every section 8-byte aligned.
+     */
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t numVertices;
+        uint64_t graphArcs;
+        uint64_t numUpArcs;
+        uint64_t numDownArcs;
+        uint64_t fileSize;
+        uint64_t sections[NumSections];
+    };
+
+    /** @return the size in bytes of a section */
+    uint64_t sectionBytes(Section section, uint64_t numVertices, uint64_t up, uint64_t down)
+    {
+        switch (section) {
+            case Ranks: return numVertices * sizeof(uint32_t);
+            case UpOffsets: return (numVertices + 1) * sizeof(uint32_t);
+            case UpTargets: return up * sizeof(VertexId);
+            case UpWeights: return up * sizeof(double);
+            case UpMiddles: return up * sizeof(VertexId);
+            case DownOffsets: return (numVertices + 1) * sizeof(uint32_t);
+            case DownSources: return down * sizeof(VertexId);
+            case DownWeights: return down * sizeof(double);
+            case DownMiddles: return down * sizeof(VertexId);
+            default: return 0;
+        }
+    }
+
+    uint64_t alignUp(uint64_t bytes)
+    {
+        return (bytes + 7) & ~(uint64_t) 7;
+    }
+
+    /**
+     * Checks one direction of a mapped hierarchy: the offsets rise from 0 to
+     * numArcs, every arc leads to a vertex ranked above the one storing it,
+     * and every shortcut bypasses a vertex ranked below both of its ends,
+     * so searches stay in bounds and unpacking terminates.
+     */
+    bool validArcs(uint64_t numVertices, uint64_t numArcs, const uint32_t* ranks, const uint32_t* offsets,
+                   const VertexId* others, const VertexId* middles)
+    {
+        if (offsets[0] != 0 || offsets[numVertices] != numArcs)
+            return false;
+        for (uint64_t v = 0; v < numVertices; v++) {
+            if (offsets[v] > offsets[v + 1])
+                return false;
+            for (uint32_t arc = offsets[v]; arc < offsets[v + 1]; arc++) {
+                VertexId other = others[arc];
+                VertexId middle = middles[arc];
+                if (other >= numVertices || ranks[other] <= ranks[v])
+                    return false;
+                if (middle != CsrGraph::InvalidId
+                    && (middle >= numVertices || ranks[middle] >= ranks[v]))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /** @return whether ranks holds each of 0 to numVertices - 1 once */
+    bool isPermutation(uint64_t numVertices, const uint32_t* ranks)
+    {
+        vector<char> seen(numVertices, 0);
+        for (uint64_t v = 0; v < numVertices; v++) {
+            if (ranks[v] >= numVertices || seen[ranks[v]])
+                return false;
+            seen[ranks[v]] = 1;
+        }
+        return true;
+    }
+}
+
+ContractionHierarchy::ContractionHierarchy() : ContractionHierarchy(CsrGraph(), 1)
+{
+}
+
+ContractionHierarchy::ContractionHierarchy(const CsrGraph& graph, unsigned threads)
+    : graph_(graph), numVertices_(graph.numVertices())
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::shared_ptr<Buffers> buffers = std::make_shared<Buffers>();
+    Contractor(graph, threads).run(*buffers);
+
+    numUpArcs_ = buffers->upTargets.size();
+    numDownArcs_ = buffers->downSources.size();
+    ranks_ = buffers->ranks.data();
+    upOffsets_ = buffers->upOffsets.data();
+    upTargets_ = buffers->upTargets.data();
+    upWeights_ = buffers->upWeights.data();
+    upMiddles_ = buffers->upMiddles.data();
+    downOffsets_ = buffers->downOffsets.data();
+    downSources_ = buffers->downSources.data();
+    downWeights_ = buffers->downWeights.data();
+    downMiddles_ = buffers->downMiddles.data();
+    storage_ = buffers;
+}
+
+size_t ContractionHierarchy::numShortcuts() const
+{
+    size_t count = 0;
+    for (size_t arc = 0; arc < numUpArcs_; arc++)
+        count += upMiddles_[arc] != CsrGraph::InvalidId;
+    for (size_t arc = 0; arc < numDownArcs_; arc++)
+        count += downMiddles_[arc] != CsrGraph::InvalidId;
+    return count;
+}
+
+bool ContractionHierarchy::query(VertexId start, VertexId end, SearchWorkspace& forward,
+                                 SearchWorkspace& backward, vector<VertexId>& path,
+                                 double* distance) const
+{
+    forward.reset(numVertices_);
+    backward.reset(numVertices_);
+    path.clear();
+
+    IndexedHeap<>& forwardHeap = forward.indexedHeap();
+    IndexedHeap<>& backwardHeap = backward.indexedHeap();
+    forward.reach(start, CsrGraph::InvalidId, 0);
+    forwardHeap.push(start, 0);
+    backward.reach(end, CsrGraph::InvalidId, 0);
+    backwardHeap.push(end, 0);
+
+    double mu = std::numeric_limits<double>::infinity();
+    VertexId meeting = CsrGraph::InvalidId;
+    if (start == end) {
+        mu = 0;
+        meeting = start;
+    }
+
+    // both searches only go up, so neither can stop at the first meeting:
+    // each runs until its smallest key reaches the best distance found
+    while (true) {
+        bool forwardDone = forwardHeap.empty() || forwardHeap.top().key >= mu;
+        bool backwardDone = backwardHeap.empty() || backwardHeap.top().key >= mu;
+        if (forwardDone && backwardDone)
+            break;
+
+        bool isForward = backwardDone
+                         || (!forwardDone && forwardHeap.top().key <= backwardHeap.top().key);
+        const uint32_t* offsets = isForward ? upOffsets_ : downOffsets_;
+        const VertexId* others = isForward ? upTargets_ : downSources_;
+        const double* weights = isForward ? upWeights_ : downWeights_;
+        SearchWorkspace& self = isForward ? forward : backward;
+        SearchWorkspace& other = isForward ? backward : forward;
+        IndexedHeap<>& heap = isForward ? forwardHeap : backwardHeap;
+
+        VertexId current = heap.pop().vertex;
+        self.settle(current);
+        double cost = self.distance(current);
+
+        // stall-on-demand: if a higher vertex already reached has an arc
+        // back down to current that is shorter, current's distance is not
+        // a shortest one and expanding it would only waste time
+        const uint32_t* stallOffsets = isForward ? downOffsets_ : upOffsets_;
+        const VertexId* stallOthers = isForward ? downSources_ : upTargets_;
+        const double* stallWeights = isForward ? downWeights_ : upWeights_;
+        bool stalled = false;
+        for (uint32_t arc = stallOffsets[current]; arc < stallOffsets[current + 1] && !stalled; arc++) {
+            VertexId higher = stallOthers[arc];
+            stalled = self.isReached(higher) && self.distance(higher) + stallWeights[arc] < cost;
+        }
+        if (stalled)
+            continue;
+
+        for (uint32_t arc = offsets[current]; arc < offsets[current + 1]; arc++) {
+            VertexId next = others[arc];
+            if (self.isSettled(next))
+                continue;
+
+            double nextCost = cost + weights[arc];
+            bool seen = self.isReached(next);
+            if (seen && nextCost >= self.distance(next))
+                continue;
+
+            self.reach(next, current, nextCost);
+            if (seen) {
+                heap.decreaseKey(next, nextCost);
+            } else {
+                heap.push(next, nextCost);
+            }
+
+            if (other.isReached(next) && nextCost + other.distance(next) < mu) {
+                mu = nextCost + other.distance(next);
+                meeting = next;
+            }
+        }
+    }
+
+    if (meeting == CsrGraph::InvalidId)
+        return false;
+    if (distance != NULL)
+        *distance = mu;
+
+    // the path in the hierarchy goes up from start to meeting and down to
+    // end; forward's BFS queue is unused here and holds it
+    vector<VertexId>& route = forward.queue();
+    forward.tracePath(meeting, route);
+    for (VertexId v = backward.parent(meeting); v != CsrGraph::InvalidId; v = backward.parent(v))
+        route.push_back(v);
+
+    path.push_back(route[0]);
+    for (size_t i = 1; i < route.size(); i++)
+        unpack(route[i - 1], route[i], path);
+    return true;
+}
+
+void ContractionHierarchy::unpack(VertexId from, VertexId to, vector<VertexId>& path) const
+{
+    // an arc is stored at whichever end was contracted first
+    VertexId middle = CsrGraph::InvalidId;
+    if (ranks_[from] < ranks_[to]) {
+        for (uint32_t arc = upOffsets_[from]; arc < upOffsets_[from + 1]; arc++) {
+            if (upTargets_[arc] == to) {
+                middle = upMiddles_[arc];
+                break;
+            }
+        }
+    } else {
+        for (uint32_t arc = downOffsets_[to]; arc < downOffsets_[to + 1]; arc++) {
+            if (downSources_[arc] == from) {
+                middle = downMiddles_[arc];
+                break;
+            }
+        }
+    }
+
+    if (middle == CsrGraph::InvalidId) {
+        path.push_back(to);
+        return;
+    }
+    unpack(from, middle, path);
+    unpack(middle, to, path);
+}
+
+vector<Vertex> ContractionHierarchy::shortestPath(Vertex start, Vertex end) const
+{
+    VertexId source = graph_.getId(start);
+    VertexId target = graph_.getId(end);
+    SearchWorkspace forward, backward;
+    vector<VertexId> ids;
+    vector<Vertex> path;
+    if (source == CsrGraph::InvalidId || target == CsrGraph::InvalidId
+        || !query(source, target, forward, backward, ids))
+        return path;
+
+    path.reserve(ids.size());
+    for (VertexId v : ids)
+        path.push_back(graph_.getVertex(v));
+    return path;
+}
+
+bool ContractionHierarchy::writeToFile(const string& fileName) const
+{
+    const void* data[NumSections] = {ranks_, upOffsets_, upTargets_, upWeights_, upMiddles_,
+                                     downOffsets_, downSources_, downWeights_, downMiddles_};
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.byteOrder = ByteOrderMark;
+    header.numVertices = numVertices_;
+    header.graphArcs = graph_.numArcs();
+    header.numUpArcs = numUpArcs_;
+    header.numDownArcs = numDownArcs_;
+
+    uint64_t position = alignUp(sizeof(FileHeader));
+    for (int section = 0; section < NumSections; section++) {
+        header.sections[section] = position;
+        position = alignUp(position + sectionBytes((Section) section, numVertices_, numUpArcs_, numDownArcs_));
+    }
+    header.fileSize = position;
+
+    // replaced by rename, as CsrGraph snapshots are, so that mappings of
+    // the old file stay valid
+    string tempName;
+    if (!createTempFile(fileName, tempName))
+        return false;
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+
+    const char padding[8] = {0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, alignUp(sizeof(header)) - sizeof(header));
+    for (int section = 0; section < NumSections; section++) {
+        uint64_t bytes = sectionBytes((Section) section, numVertices_, numUpArcs_, numDownArcs_);
+        if (bytes > 0)
+            file.write(static_cast<const char*>(data[section]), bytes);
+        file.write(padding, alignUp(bytes) - bytes);
+    }
+    file.close();
+    if (!file || std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ContractionHierarchy::readFromFile(const string& fileName, const CsrGraph& graph)
+{
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(fileName, false);
+    if (!mapping->isOpen() || mapping->size() < sizeof(FileHeader))
+        return false;
+
+    FileHeader header;
+    memcpy(&header, mapping->begin(), sizeof(header));
+    if (memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0
+        || header.version != FileVersion
+        || header.byteOrder != ByteOrderMark
+        || header.fileSize != mapping->size()
+        || header.numVertices != graph.numVertices()
+        || header.graphArcs != graph.numArcs()
+        || header.numUpArcs > UINT32_MAX
+        || header.numDownArcs > UINT32_MAX)
+        return false;
+
+    const char* base = mapping->begin();
+    for (int section = 0; section < NumSections; section++) {
+        uint64_t start = header.sections[section];
+        uint64_t bytes = sectionBytes((Section) section, header.numVertices, header.numUpArcs,
+                                      header.numDownArcs);
+        if (start % 8 != 0 || start > header.fileSize || bytes > header.fileSize - start)
+            return false;
+    }
+
+    const uint32_t* ranks = reinterpret_cast<const uint32_t*>(base + header.sections[Ranks]);
+    const uint32_t* upOffsets = reinterpret_cast<const uint32_t*>(base + header.sections[UpOffsets]);
+    const VertexId* upTargets = reinterpret_cast<const VertexId*>(base + header.sections[UpTargets]);
+    const VertexId* upMiddles = reinterpret_cast<const VertexId*>(base + header.sections[UpMiddles]);
+    const uint32_t* downOffsets = reinterpret_cast<const uint32_t*>(base + header.sections[DownOffsets]);
+    const VertexId* downSources = reinterpret_cast<const VertexId*>(base + header.sections[DownSources]);
+    const VertexId* downMiddles = reinterpret_cast<const VertexId*>(base + header.sections[DownMiddles]);
+    if (!isPermutation(header.numVertices, ranks)
+        || !validArcs(header.numVertices, header.numUpArcs, ranks, upOffsets, upTargets, upMiddles)
+        || !validArcs(header.numVertices, header.numDownArcs, ranks, downOffsets, downSources, downMiddles))
+        return false;
+
+    graph_ = graph;
+    numVertices_ = (uint32_t) header.numVertices;
+    numUpArcs_ = header.numUpArcs;
+    numDownArcs_ = header.numDownArcs;
+    ranks_ = ranks;
+    upOffsets_ = upOffsets;
+    upTargets_ = upTargets;
+    upWeights_ = reinterpret_cast<const double*>(base + header.sections[UpWeights]);
+    upMiddles_ = upMiddles;
+    downOffsets_ = downOffsets;
+    downSources_ = downSources;
+    downWeights_ = reinterpret_cast<const double*>(base + header.sections[DownWeights]);
+    downMiddles_ = downMiddles;
+    storage_ = mapping;
+    return true;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file contractionhierarchy.h
+ * Contraction Hierarchies preprocessing and point-to-point queries.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "csrgraph.h"
+#include "searchworkspace.h"
+#include "vertex.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Contraction Hierarchy of a CsrGraph.
+ *
+ * Preprocessing removes ("contracts") the vertices one at a time, least
+ * important first, by edge difference (shortcuts needed minus arcs
+ * removed) plus the number of neighbors already contracted and the depth
+ * reached so far. When v is contracted, a shortcut u -> w of weight
+ * w(u, v) + w(v, w) is added unless a witness search finds a path from u
+ * to w that avoids v and is no longer. Every vertex thus gets a rank, and
+ * the shortest path between any two vertices can be found using only arcs
+ * that go up in rank from either end.
+ *
+ * A query runs a Dijkstra search upward from the start and one upward over
+ * the reversed arcs from the end, skipping ("stalling") vertices reached
+ * more cheaply from above; each explores only a few hundred vertices even
+ * on large road networks. The resulting path is unpacked, shortcut by
+ * shortcut, into original arcs of the graph.
+ *
+ * Contraction proceeds in rounds: each round contracts, on several threads,
+ * a set of vertices that are not adjacent to each other and are less
+ * important than all their neighbors.
+ *
+ * The hierarchy keeps a copy of the snapshot it was built from (which
+ * shares its arrays) and uses the same vertex ids. It can be saved to a
+ * file and mapped again together with that snapshot. A hierarchy never
+ * changes once built, so any number of threads may query it at the same
+ * time, each with its own workspaces.
+ */
+class ContractionHierarchy
+{
+  public:
+    typedef CsrGraph::VertexId VertexId;
+
+    /** Version of the binary format written by writeToFile(). */
+    static const uint32_t FileVersion;
+
+    /**
+     * Creates an empty hierarchy.
+     */
+    ContractionHierarchy();
+
+    /**
+     * Contracts every vertex of a snapshot.
+     * @param graph - the snapshot to preprocess
+     * @param threads - number of threads to use; 0 for one per core
+     */
+    explicit ContractionHierarchy(const CsrGraph& graph, unsigned threads = 0);
+
+    /** @return the snapshot the hierarchy was built from */
+    const CsrGraph& graph() const { return graph_; }
+
+    uint32_t numVertices() const { return numVertices_; }
+
+    /** @return the number of upward and downward arcs, shortcuts included */
+    size_t numArcs() const { return numUpArcs_ + numDownArcs_; }
+
+    /** @return the number of arcs that are shortcuts */
+    size_t numShortcuts() const;
+
+    /** @return the position of v in the contraction order (0 = first) */
+    uint32_t rank(VertexId v) const { return ranks_[v]; }
+
+    /**
+     * Finds the shortest path between two ids of the snapshot.
+     * @param start - id of the first vertex
+     * @param end - id of the last vertex
+     * @param forward - scratch state of the upward search from start
+     * @param backward - scratch state of the upward search from end
+     * @param path - cleared and filled with the ids on the path, with
+     *  every shortcut replaced by the original arcs it stands for
+     * @param distance - if not NULL, set to the length of the path
+     * @return true, if end was reached
+     */
+    bool query(VertexId start, VertexId end, SearchWorkspace& forward, SearchWorkspace& backward,
+               vector<VertexId>& path, double* distance = NULL) const;
+
+    /**
+     * Finds the shortest path between two vertices, for one-off queries:
+     * each call allocates its own workspaces.
+     * @return the shortest path, or an empty path if end cannot be reached
+     */
+    vector<Vertex> shortestPath(Vertex start, Vertex end) const;
+
+    /**
+     * Writes the hierarchy in a binary format mapped again by
+     * readFromFile(). The snapshot is not included. The file is written
+     * under a unique name beside fileName and renamed over it, so mappings
+     * of the old file stay valid and concurrent writers never mix.
+     * @param fileName - name of the file to write
+     * @return true, if the file was successfully written
+     */
+    bool writeToFile(const string& fileName) const;
+
+    /**
+     * Replaces this hierarchy with one mapped read-only from a file
+     * written by writeToFile(). The ranks must be a permutation, and every
+     * arc and shortcut must respect them, or the file is rejected.
+     * @param fileName - name of the file to read
+     * @param graph - the snapshot the hierarchy was built from
+     * @return true, if the file was a valid hierarchy for graph
+     */
+    bool readFromFile(const string& fileName, const CsrGraph& graph);
+
+  private:
+    CsrGraph graph_;
+    uint32_t numVertices_;
+    size_t numUpArcs_;
+    size_t numDownArcs_;
+
+    const uint32_t* ranks_;             /**< contraction rank of each vertex */
+
+    /** Arcs u -> w to higher-ranked w, used by the forward search. */
+    const uint32_t* upOffsets_;
+    const VertexId* upTargets_;
+    const double* upWeights_;
+    const VertexId* upMiddles_;         /**< contracted vertex, or InvalidId */
+
+    /** Arcs w -> u from higher-ranked w, stored at u for the backward search. */
+    const uint32_t* downOffsets_;
+    const VertexId* downSources_;
+    const double* downWeights_;
+    const VertexId* downMiddles_;
+
+    /** Owner of the arrays above: heap buffers or a file mapping. */
+    std::shared_ptr<const void> storage_;
+
+    /**
+     * Appends the original arcs that the hierarchy arc from -> to stands
+     * for, without from itself, to path.
+     */
+    void unpack(VertexId from, VertexId to, vector<VertexId>& path) const;
+};
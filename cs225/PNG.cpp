@@ -17,6 +17,7 @@ using std::vector;
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include "lodepng/lodepng.h"
@@ -25,7 +26,36 @@ using std::vector;
 
 
 namespace cs225 {
+  namespace {
+    std::atomic<unsigned long> copyCount(0);
+
+    /** The rows of an HSLA image, converted to RGBA as the encoder asks for them. */
+    class HSLARows : public RowSource {
+    public:
+      HSLARows(const HSLAPixel * pixels, unsigned width) : pixels_(pixels), width_(width) { }
+
+      const unsigned char * row(unsigned y, unsigned char * scratch) const {
+        const HSLAPixel * pixel = pixels_ + (size_t) y * width_;
+        for (unsigned x = 0; x < width_; x++) {
+          hslaColor hsl = {pixel[x].h, pixel[x].s, pixel[x].l, pixel[x].a};
+          rgbaColor rgb = hsl2rgb(hsl);
+          scratch[4 * x] = rgb.r;
+          scratch[4 * x + 1] = rgb.g;
+          scratch[4 * x + 2] = rgb.b;
+          scratch[4 * x + 3] = rgb.a;
+        }
+        return scratch;
+      }
+
+    private:
+      const HSLAPixel * pixels_;
+      unsigned width_;
+    };
+  }
+
   void PNG::_copy(PNG const & other) {
+    copyCount++;
+
     // Clear self
     delete[] imageData_;
 
@@ -55,6 +85,13 @@ namespace cs225 {
     _copy(other);
   }
 
+  PNG::PNG(PNG && other) noexcept
+    : width_(other.width_), height_(other.height_), imageData_(other.imageData_) {
+    other.width_ = 0;
+    other.height_ = 0;
+    other.imageData_ = NULL;
+  }
+
   PNG::~PNG() {
     delete[] imageData_;
   }
@@ -64,6 +101,23 @@ namespace cs225 {
     return *this;
   }
 
+  PNG const & PNG::operator=(PNG && other) noexcept {
+    if (this != &other) {
+      delete[] imageData_;
+      width_ = other.width_;
+      height_ = other.height_;
+      imageData_ = other.imageData_;
+      other.width_ = 0;
+      other.height_ = 0;
+      other.imageData_ = NULL;
+    }
+    return *this;
+  }
+
+  unsigned long PNG::copies() {
+    return copyCount;
+  }
+
   bool PNG::operator== (PNG const & other) const {
     if (width_ != other.width_) { return false; }
     if (height_ != other.height_) { return false; }
@@ -178,6 +232,10 @@ namespace cs225 {
     return (error == 0);
   }
 
+  bool PNG::writeToFile(string const & fileName, EncodeOptions const & options) const {
+    return writePNG(HSLARows(imageData_, width_), width_, height_, options, fileName);
+  }
+
   unsigned int PNG::width() const {
     return width_;
   }
@@ -10,10 +10,13 @@
 using std::string;
 
 #include "HSLAPixel.h"
+#include "PNGEncoder.h"
 
 namespace cs225 {
   class PNG {
   public:
+    typedef HSLAPixel Pixel;
+
     /**
       * Creates an empty PNG image.
       */
@@ -33,6 +36,13 @@ namespace cs225 {
       */
     PNG(PNG const & other);
 
+    /**
+      * Move constructor: takes the pixels of another PNG without copying
+      * them, leaving it an empty image.
+      * @param other PNG to be moved from.
+      */
+    PNG(PNG && other) noexcept;
+
     /**
       * Destructor: frees all memory associated with a given PNG object.
       * Invoked by the system.
@@ -46,6 +56,14 @@ namespace cs225 {
       */
     PNG const & operator= (PNG const & other);
 
+    /**
+      * Move assignment: frees the current pixels and takes those of
+      * another PNG, leaving it an empty image.
+      * @param other Image to move into the current image.
+      * @return The current image for assignment chaining.
+      */
+    PNG const & operator= (PNG && other) noexcept;
+
     /**
       * Equality operator: checks if two images are the same.
       * @param other Image to be checked.
@@ -76,6 +94,14 @@ namespace cs225 {
       */
     bool writeToFile(string const & fileName);
 
+    /**
+      * Writes a PNG image to a file, encoded as options say.
+      * @param fileName Name of the file to be written.
+      * @param options Filtering, compression and threads of the encoder.
+      * @return true, if the image was successfully written.
+      */
+    bool writeToFile(string const & fileName, EncodeOptions const & options) const;
+
     /**
       * Pixel access operator. Gets a reference to the pixel at the given
       * coordinates in the image. (0,0) is the upper left corner.
@@ -117,6 +143,14 @@ namespace cs225 {
       */
     void resize(unsigned int newWidth, unsigned int newHeight);
 
+    /**
+      * Counts the full copies of pixel data made by the copy constructor
+      * and copy assignment of any PNG, so callers can check that a
+      * pipeline moves its images instead.
+      * @return The number of copies since the program started.
+      */
+    static unsigned long copies();
+
   private:
     unsigned int width_;            /*< Width of the image */
     unsigned int height_;           /*< Height of the image */
@@ -0,0 +1,613 @@
+/**
+ * @file PNGEncoder.cpp
+ * Implementation of a PNG encoder that deflates stripes of an image on
+ * several threads with lodepng and stitches them into one stream.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+using std::cerr;
+using std::endl;
+
+#include "lodepng/lodepng.h"
+#include "PNGEncoder.h"
+#include "../parallel.h"
+
+namespace cs225 {
+  namespace {
+    /** Bytes of filtered rows deflated together in a parallel encode. */
+    const size_t StripeBytes = 256 * 1024;
+
+    /**
+     * Window, nice match length and lazy matching of each level; level 0
+     * stores. lodepng follows the hash chain through the whole window from
+     * 8192 up, which on flat map colors costs far more than it saves, so
+     * no level goes past that.
+     */
+    const unsigned Levels[10][3] = {
+      {0, 0, 0}, {256, 16, 0}, {512, 32, 0}, {1024, 64, 0}, {2048, 64, 1},
+      {2048, 96, 1}, {2048, 128, 1}, {4096, 258, 1}, {8192, 128, 1}, {8192, 258, 1}
+    };
+
+    /** Extra bits after each length symbol from 257, and each distance symbol. */
+    const unsigned LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                      5, 5, 5, 5, 0};
+    const unsigned DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+                                        11, 11, 12, 12, 13, 13};
+
+    const unsigned AdlerBase = 65521;
+
+    enum ColorType { ColorRGB = 2, ColorPalette = 3, ColorRGBA = 6 };
+
+    /** The PNG color type an image is written in, and how to convert rows to it. */
+    struct Format {
+      unsigned colorType;
+      unsigned bitDepth;
+      std::vector<uint32_t> palette;      /**< translucent colors first, so tRNS stays short */
+      std::unordered_map<uint32_t, unsigned char> index;
+      size_t rowBytes;                    /**< of a converted row, without its filter type */
+      unsigned pixelBytes;                /**< distance of the pixel to the left when filtering */
+    };
+
+    /** One stripe of rows, filtered and deflated on its own. */
+    struct Stripe {
+      std::vector<unsigned char> deflated;
+      size_t bytes;                       /**< filtered bytes deflated */
+      unsigned adler;                     /**< adler32 of the filtered bytes */
+      size_t finalBit;                    /**< where the header of the final block starts */
+      size_t endBit;                      /**< where the final block ends */
+      unsigned error;
+    };
+
+    /** The rows of pixels stored one after another. */
+    class PixelRows : public RowSource {
+    public:
+      PixelRows(const unsigned char * rgba, unsigned width) : rgba_(rgba), width_(width) { }
+
+      const unsigned char * row(unsigned y, unsigned char *) const {
+        return rgba_ + 4 * (size_t) y * width_;
+      }
+
+    private:
+      const unsigned char * rgba_;
+      unsigned width_;
+    };
+
+    uint32_t colorAt(const unsigned char * pixel) {
+      uint32_t color;
+      std::memcpy(&color, pixel, sizeof(color));
+      return color;
+    }
+
+    unsigned char alphaOf(uint32_t color) {
+      unsigned char bytes[4];
+      std::memcpy(bytes, &color, sizeof(bytes));
+      return bytes[3];
+    }
+
+    /**
+     * Picks the smallest of an indexed, an RGB and an RGBA image that holds
+     * every pixel. Rows are scanned in chunks on several threads, each
+     * chunk collecting its colors until the image is known to have more
+     * than a palette holds.
+     */
+    void chooseFormat(RowSource const & rows, unsigned width, unsigned height, unsigned threads,
+                      Format & format) {
+      format.colorType = ColorRGBA;
+      format.bitDepth = 8;
+      size_t rowsPerChunk = std::max((size_t) 1, StripeBytes / (4 * (size_t) width));
+      size_t chunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+      std::vector<std::vector<uint32_t>> colors(chunks);
+      std::atomic<bool> many(false), translucent(false);
+      parallelFor(chunks, threads, [&](size_t chunk, unsigned) {
+        std::unordered_set<uint32_t> seen;
+        std::vector<unsigned char> scratch(4 * (size_t) width);
+        uint32_t last = 0;
+        bool hasLast = false, seesTranslucent = false;
+        size_t end = std::min((size_t) height, (chunk + 1) * rowsPerChunk);
+        for (size_t y = chunk * rowsPerChunk; y < end && !(many && (seesTranslucent || translucent)); y++) {
+          const unsigned char * pixel = rows.row((unsigned) y, scratch.data());
+          for (unsigned x = 0; x < width; x++, pixel += 4) {
+            if (pixel[3] != 255) seesTranslucent = true;
+            if (many) {
+              if (seesTranslucent || translucent) break;
+              continue;
+            }
+            uint32_t color = colorAt(pixel);
+            if (hasLast && color == last) continue;
+            last = color;
+            hasLast = true;
+            seen.insert(color);
+            if (seen.size() > 256) many = true;
+          }
+        }
+        if (seesTranslucent) translucent = true;
+        colors[chunk].assign(seen.begin(), seen.end());
+      }, 1);
+
+      std::vector<uint32_t> all;
+      for (size_t chunk = 0; chunk < chunks && !many && all.size() <= 256; chunk++) {
+        all.insert(all.end(), colors[chunk].begin(), colors[chunk].end());
+        std::sort(all.begin(), all.end());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+      }
+      if (!many && all.size() <= 256) {
+        format.colorType = ColorPalette;
+        std::stable_partition(all.begin(), all.end(), [](uint32_t color) { return alphaOf(color) != 255; });
+        format.palette = all;
+        for (size_t i = 0; i < all.size(); i++) format.index[all[i]] = (unsigned char) i;
+        size_t size = all.size();
+        format.bitDepth = size <= 2 ? 1 : size <= 4 ? 2 : size <= 16 ? 4 : 8;
+      } else if (!translucent) {
+        format.colorType = ColorRGB;
+      }
+
+      unsigned channels = format.colorType == ColorRGBA ? 4 : format.colorType == ColorRGB ? 3 : 1;
+      format.rowBytes = ((size_t) width * channels * format.bitDepth + 7) / 8;
+      format.pixelBytes = std::max(1u, channels * format.bitDepth / 8);
+    }
+
+    /** Writes a row of RGBA pixels in format, packed as in a PNG file. */
+    void convertRow(const unsigned char * pixel, unsigned width, const Format & format, unsigned char * out) {
+      if (format.colorType == ColorRGBA) {
+        std::memcpy(out, pixel, 4 * (size_t) width);
+      } else if (format.colorType == ColorRGB) {
+        for (unsigned x = 0; x < width; x++, pixel += 4, out += 3) {
+          out[0] = pixel[0];
+          out[1] = pixel[1];
+          out[2] = pixel[2];
+        }
+      } else {
+        // maps are mostly runs of one color, so the last lookup is kept
+        std::memset(out, 0, format.rowBytes);
+        unsigned depth = format.bitDepth;
+        uint32_t last = colorAt(pixel);
+        unsigned char index = format.index.find(last)->second;
+        for (unsigned x = 0; x < width; x++, pixel += 4) {
+          uint32_t color = colorAt(pixel);
+          if (color != last) {
+            last = color;
+            index = format.index.find(color)->second;
+          }
+          size_t bit = (size_t) x * depth;
+          out[bit / 8] |= (unsigned char) (index << (8 - depth - bit % 8));
+        }
+      }
+    }
+
+    unsigned char paeth(int a, int b, int c) {
+      int p = a + b - c;
+      int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+      if (pa <= pb && pa <= pc) return (unsigned char) a;
+      return (unsigned char) (pb <= pc ? b : c);
+    }
+
+    /** Applies one of the five PNG filters to a row; prev is NULL for the first row. */
+    void filterRow(unsigned type, const unsigned char * row, const unsigned char * prev, size_t size,
+                   unsigned pixelBytes, unsigned char * out) {
+      for (size_t i = 0; i < size; i++) {
+        int a = i >= pixelBytes ? row[i - pixelBytes] : 0;
+        int b = prev != NULL ? prev[i] : 0;
+        int c = prev != NULL && i >= pixelBytes ? prev[i - pixelBytes] : 0;
+        int predicted = 0;
+        switch (type) {
+          case EncodeOptions::Sub: predicted = a; break;
+          case EncodeOptions::Up: predicted = b; break;
+          case EncodeOptions::Average: predicted = (a + b) / 2; break;
+          case EncodeOptions::Paeth: predicted = paeth(a, b, c); break;
+        }
+        out[i] = (unsigned char) (row[i] - predicted);
+      }
+    }
+
+    /**
+     * @return how compressible a filtered row looks to a heuristic; lower
+     *  is better
+     */
+    double score(EncodeOptions::Filter heuristic, unsigned type, const unsigned char * filtered, size_t size) {
+      if (heuristic == EncodeOptions::MinSum) {
+        // the sum of the bytes as signed differences, but for an unfiltered row
+        size_t sum = 0;
+        for (size_t i = 0; i < size; i++) {
+          sum += type == EncodeOptions::None ? filtered[i] : std::abs((int) (signed char) filtered[i]);
+        }
+        return (double) sum;
+      }
+      size_t count[256] = {0};
+      for (size_t i = 0; i < size; i++) count[filtered[i]]++;
+      double bits = 0;
+      for (size_t n : count) {
+        if (n > 0) bits += n * std::log2((double) size / n);
+      }
+      return bits;
+    }
+
+    /**
+     * Filters rows [y0, y1) into out, each preceded by its filter type.
+     * The rows above y0 are converted again, so stripes are independent.
+     */
+    void filterRows(RowSource const & rows, unsigned width, unsigned y0, unsigned y1, const Format & format,
+                    EncodeOptions::Filter filter, std::vector<unsigned char> & out) {
+      size_t size = format.rowBytes;
+      std::vector<unsigned char> previous(size), current(size), candidate(size), scratch(4 * (size_t) width);
+      if (y0 > 0) convertRow(rows.row(y0 - 1, scratch.data()), width, format, previous.data());
+      out.resize((size + 1) * (y1 - y0));
+      for (unsigned y = y0; y < y1; y++) {
+        convertRow(rows.row(y, scratch.data()), width, format, current.data());
+        const unsigned char * prev = y > 0 ? previous.data() : NULL;
+        unsigned char * row = &out[(size + 1) * (y - y0)];
+        if (filter != EncodeOptions::MinSum && filter != EncodeOptions::Entropy) {
+          row[0] = (unsigned char) filter;
+          filterRow(filter, current.data(), prev, size, format.pixelBytes, row + 1);
+        } else {
+          double best = 0;
+          for (unsigned type = EncodeOptions::None; type <= EncodeOptions::Paeth; type++) {
+            filterRow(type, current.data(), prev, size, format.pixelBytes, candidate.data());
+            double cost = score(filter, type, candidate.data(), size);
+            if (type == EncodeOptions::None || cost < best) {
+              best = cost;
+              row[0] = (unsigned char) type;
+              std::copy(candidate.begin(), candidate.end(), row + 1);
+            }
+          }
+        }
+        previous.swap(current);
+      }
+    }
+
+    unsigned adler32(const unsigned char * data, size_t size) {
+      unsigned s1 = 1, s2 = 0;
+      while (size > 0) {
+        // the most bytes before s2 can overflow 32 bits
+        size_t n = std::min(size, (size_t) 5552);
+        size -= n;
+        while (n-- > 0) {
+          s1 += *data++;
+          s2 += s1;
+        }
+        s1 %= AdlerBase;
+        s2 %= AdlerBase;
+      }
+      return s2 << 16 | s1;
+    }
+
+    /** @return the adler32 of two byte strings one after the other, from theirs (as zlib's adler32_combine) */
+    unsigned adler32Combine(unsigned first, unsigned second, size_t secondSize) {
+      unsigned rem = (unsigned) (secondSize % AdlerBase);
+      unsigned s1 = first & 0xffff;
+      unsigned s2 = (unsigned) (((uint64_t) rem * s1) % AdlerBase);
+      s1 += (second & 0xffff) + AdlerBase - 1;
+      s2 += (first >> 16) + (second >> 16) + AdlerBase - rem;
+      if (s1 >= AdlerBase) s1 -= AdlerBase;
+      if (s1 >= AdlerBase) s1 -= AdlerBase;
+      if (s2 >= 2 * AdlerBase) s2 -= 2 * AdlerBase;
+      if (s2 >= AdlerBase) s2 -= AdlerBase;
+      return s2 << 16 | s1;
+    }
+
+    /** Reads a deflate stream bit by bit, least significant bit first. */
+    class BitReader {
+    public:
+      BitReader(const std::vector<unsigned char> & data) : data_(data), pos_(0), overrun_(false) { }
+
+      unsigned bits(unsigned count) {
+        unsigned value = 0;
+        for (unsigned i = 0; i < count; i++, pos_++) {
+          if (pos_ >= data_.size() * 8) {
+            overrun_ = true;
+            return 0;
+          }
+          value |= (unsigned) ((data_[pos_ / 8] >> (pos_ % 8)) & 1) << i;
+        }
+        return value;
+      }
+
+      void skipBytes(size_t count) { pos_ = (pos_ + 7) / 8 * 8 + 8 * count; }
+
+      size_t pos() const { return pos_; }
+      bool overrun() const { return overrun_ || pos_ > data_.size() * 8; }
+
+    private:
+      const std::vector<unsigned char> & data_;
+      size_t pos_;
+      bool overrun_;
+    };
+
+    /** A canonical Huffman code, decoded one bit at a time as in zlib's puff. */
+    class HuffmanCode {
+    public:
+      HuffmanCode(const unsigned char * lengths, unsigned symbols) : count_(16, 0), symbol_(symbols) {
+        for (unsigned s = 0; s < symbols; s++) count_[lengths[s]]++;
+        std::vector<unsigned> offset(16, 0);
+        for (unsigned length = 1; length < 15; length++) offset[length + 1] = offset[length] + count_[length];
+        for (unsigned s = 0; s < symbols; s++) {
+          if (lengths[s] != 0) symbol_[offset[lengths[s]]++] = s;
+        }
+      }
+
+      /** @return the next symbol, or -1 for a code that is not in the table */
+      int decode(BitReader & in) const {
+        int code = 0, first = 0, index = 0;
+        for (unsigned length = 1; length < 16; length++) {
+          code |= (int) in.bits(1);
+          int count = count_[length];
+          if (code - count < first) return symbol_[index + (code - first)];
+          index += count;
+          first = (first + count) << 1;
+          code <<= 1;
+        }
+        return -1;
+      }
+
+    private:
+      std::vector<unsigned> count_;
+      std::vector<unsigned> symbol_;
+    };
+
+    /** Reads the codes of a compressed block up to its end-of-block code. */
+    bool skipCodes(BitReader & in, const HuffmanCode & literals, const HuffmanCode & distances) {
+      while (!in.overrun()) {
+        int symbol = literals.decode(in);
+        if (symbol < 0 || symbol > 285) return false;
+        if (symbol < 256) continue;
+        if (symbol == 256) return true;
+        in.bits(LengthExtra[symbol - 257]);
+        int distance = distances.decode(in);
+        if (distance < 0 || distance > 29) return false;
+        in.bits(DistanceExtra[distance]);
+      }
+      return false;
+    }
+
+    /**
+     * Finds where the final block of a deflate stream starts and ends, by
+     * walking its blocks; lodepng does not report the bit a stream ends
+     * at, and a stitched stream needs it.
+     */
+    bool findFinalBlock(const std::vector<unsigned char> & stream, size_t & finalBit, size_t & endBit) {
+      BitReader in(stream);
+      const unsigned char order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+      while (!in.overrun()) {
+        size_t header = in.pos();
+        unsigned final = in.bits(1);
+        unsigned type = in.bits(2);
+        if (type == 0) {
+          in.skipBytes(0);
+          unsigned length = in.bits(16);
+          in.bits(16);
+          in.skipBytes(length);
+        } else if (type == 1) {
+          unsigned char lengths[318];
+          std::fill(lengths, lengths + 144, 8);
+          std::fill(lengths + 144, lengths + 256, 9);
+          std::fill(lengths + 256, lengths + 280, 7);
+          std::fill(lengths + 280, lengths + 288, 8);
+          std::fill(lengths + 288, lengths + 318, 5);
+          if (!skipCodes(in, HuffmanCode(lengths, 288), HuffmanCode(lengths + 288, 30))) return false;
+        } else if (type == 2) {
+          unsigned literalCount = in.bits(5) + 257, distanceCount = in.bits(5) + 1, codeCount = in.bits(4) + 4;
+          unsigned char codeLengths[19] = {0};
+          for (unsigned i = 0; i < codeCount; i++) codeLengths[order[i]] = (unsigned char) in.bits(3);
+          HuffmanCode lengthCode(codeLengths, 19);
+          unsigned char lengths[320] = {0};
+          unsigned total = literalCount + distanceCount;
+          for (unsigned i = 0; i < total && !in.overrun();) {
+            int symbol = lengthCode.decode(in);
+            if (symbol < 0) return false;
+            if (symbol < 16) {
+              lengths[i++] = (unsigned char) symbol;
+              continue;
+            }
+            unsigned char repeated = 0;
+            unsigned times;
+            if (symbol == 16) {
+              if (i == 0) return false;
+              repeated = lengths[i - 1];
+              times = 3 + in.bits(2);
+            } else {
+              times = symbol == 17 ? 3 + in.bits(3) : 11 + in.bits(7);
+            }
+            if (i + times > total) return false;
+            std::fill(lengths + i, lengths + i + times, repeated);
+            i += times;
+          }
+          HuffmanCode literals(lengths, literalCount), distances(lengths + literalCount, distanceCount);
+          if (!skipCodes(in, literals, distances)) return false;
+        } else {
+          return false;
+        }
+        if (final) {
+          finalBit = header;
+          endBit = in.pos();
+          return !in.overrun();
+        }
+      }
+      return false;
+    }
+
+    /** Appends bit strings to a byte vector, least significant bit first. */
+    class BitWriter {
+    public:
+      explicit BitWriter(std::vector<unsigned char> & out) : out_(out), used_(0) { }
+
+      /** Appends the first count bits of data. */
+      void append(const unsigned char * data, size_t count) {
+        size_t whole = count / 8;
+        unsigned rest = (unsigned) (count % 8);
+        if (used_ == 0) {
+          out_.insert(out_.end(), data, data + whole);
+        } else {
+          for (size_t i = 0; i < whole; i++) {
+            out_.back() |= (unsigned char) (data[i] << used_);
+            out_.push_back((unsigned char) (data[i] >> (8 - used_)));
+          }
+        }
+        if (rest == 0) return;
+        unsigned char last = (unsigned char) (data[whole] & ((1u << rest) - 1));
+        if (used_ == 0) {
+          out_.push_back(last);
+        } else {
+          out_.back() |= (unsigned char) (last << used_);
+          if (used_ + rest > 8) out_.push_back((unsigned char) (last >> (8 - used_)));
+        }
+        used_ = (used_ + rest) % 8;
+      }
+
+    private:
+      std::vector<unsigned char> & out_;
+      unsigned used_;     /**< bits of the last byte already written; 0 when aligned */
+    };
+
+    void push32(std::vector<unsigned char> & out, unsigned value) {
+      for (int shift = 24; shift >= 0; shift -= 8) out.push_back((unsigned char) (value >> shift));
+    }
+
+    void addChunk(std::vector<unsigned char> & out, const char * type, const unsigned char * data, size_t size) {
+      push32(out, (unsigned) size);
+      size_t start = out.size();
+      out.insert(out.end(), type, type + 4);
+      out.insert(out.end(), data, data + size);
+      push32(out, lodepng_crc32(&out[start], size + 4));
+    }
+  }
+
+  EncodeOptions::EncodeOptions() : filter(MinSum), level(6), fast(false), parallel(false), threads(0) { }
+
+  /**
+   * Converts and filters each stripe of rows and deflates it on its own,
+   * then joins their streams: the final block of every stripe but the
+   * last is made not final, and each stream starts at the bit the one
+   * before ends, so the whole inflates as one.
+   */
+  bool encodePNG(RowSource const & rows, unsigned width, unsigned height, EncodeOptions const & options,
+                 std::vector<unsigned char> & out) {
+    out.clear();
+    if (width == 0 || height == 0) {
+      cerr << "PNG encoding error: the image has no pixels" << endl;
+      return false;
+    }
+    unsigned threads = !options.parallel ? 1 : options.threads != 0 ? options.threads
+                                                                     : std::max(1u, std::thread::hardware_concurrency());
+
+    Format format;
+    chooseFormat(rows, width, height, threads, format);
+    EncodeOptions::Filter filter = options.filter;
+    if (format.colorType == ColorPalette) {
+      filter = EncodeOptions::None;
+    } else if (options.fast && (filter == EncodeOptions::MinSum || filter == EncodeOptions::Entropy)) {
+      filter = EncodeOptions::Up;
+    }
+
+    LodePNGCompressSettings settings;
+    lodepng_compress_settings_init(&settings);
+    unsigned level = std::min(options.level, 9u);
+    if (level == 0) {
+      settings.btype = 0;
+    } else {
+      settings.windowsize = Levels[level][0];
+      settings.nicematch = Levels[level][1];
+      settings.lazymatching = options.fast ? 0 : Levels[level][2];
+    }
+
+    // lodepng can walk a whole window of hash chain at the start of each
+    // stream, so stripes are longer for the windows of the top levels
+    size_t rowsPerStripe = height;
+    size_t stripeBytes = std::max(StripeBytes, (size_t) 32 * settings.windowsize);
+    if (options.parallel) rowsPerStripe = std::max((size_t) 1, stripeBytes / (format.rowBytes + 1));
+    size_t count = (height + rowsPerStripe - 1) / rowsPerStripe;
+    std::vector<Stripe> stripes(count);
+    parallelFor(count, threads, [&](size_t i, unsigned) {
+      Stripe & stripe = stripes[i];
+      std::vector<unsigned char> filtered;
+      unsigned y0 = (unsigned) (i * rowsPerStripe);
+      filterRows(rows, width, y0, (unsigned) std::min((size_t) height, y0 + rowsPerStripe), format, filter, filtered);
+      stripe.bytes = filtered.size();
+      stripe.adler = adler32(filtered.data(), filtered.size());
+
+      unsigned char * deflated = NULL;
+      size_t size = 0;
+      stripe.error = lodepng_deflate(&deflated, &size, filtered.data(), filtered.size(), &settings);
+      if (deflated != NULL) {
+        stripe.deflated.assign(deflated, deflated + size);
+        free(deflated);
+      }
+      stripe.endBit = 8 * stripe.deflated.size();
+      if (stripe.error == 0 && count > 1 && !findFinalBlock(stripe.deflated, stripe.finalBit, stripe.endBit)) {
+        stripe.error = 1;
+      }
+    }, 1);
+
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    BitWriter writer(zlib);
+    unsigned adler = 0;
+    for (size_t i = 0; i < count; i++) {
+      Stripe & stripe = stripes[i];
+      if (stripe.error != 0) {
+        cerr << "PNG encoding error " << stripe.error << ": " << lodepng_error_text(stripe.error) << endl;
+        return false;
+      }
+      if (i + 1 < count) stripe.deflated[stripe.finalBit / 8] &= (unsigned char) ~(1u << stripe.finalBit % 8);
+      writer.append(stripe.deflated.data(), stripe.endBit);
+      adler = i == 0 ? stripe.adler : adler32Combine(adler, stripe.adler, stripe.bytes);
+      std::vector<unsigned char>().swap(stripe.deflated);
+    }
+    push32(zlib, adler);
+
+    const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out.assign(signature, signature + 8);
+    std::vector<unsigned char> header;
+    push32(header, width);
+    push32(header, height);
+    header.push_back((unsigned char) format.bitDepth);
+    header.push_back((unsigned char) format.colorType);
+    header.insert(header.end(), 3, 0);
+    addChunk(out, "IHDR", header.data(), header.size());
+    if (format.colorType == ColorPalette) {
+      std::vector<unsigned char> palette, alpha;
+      for (uint32_t color : format.palette) {
+        unsigned char bytes[4];
+        std::memcpy(bytes, &color, sizeof(bytes));
+        palette.insert(palette.end(), bytes, bytes + 3);
+        if (bytes[3] != 255) alpha.push_back(bytes[3]);
+      }
+      addChunk(out, "PLTE", palette.data(), palette.size());
+      if (!alpha.empty()) addChunk(out, "tRNS", alpha.data(), alpha.size());
+    }
+    // chunk lengths are limited to 2^31 - 1
+    const size_t maxChunk = (size_t) 1 << 30;
+    for (size_t start = 0; start < zlib.size(); start += maxChunk) {
+      addChunk(out, "IDAT", zlib.data() + start, std::min(maxChunk, zlib.size() - start));
+    }
+    addChunk(out, "IEND", NULL, 0);
+    return true;
+  }
+
+  bool encodePNG(const unsigned char * rgba, unsigned width, unsigned height, EncodeOptions const & options,
+                 std::vector<unsigned char> & out) {
+    return encodePNG(PixelRows(rgba, width), width, height, options, out);
+  }
+
+  bool writePNG(RowSource const & rows, unsigned width, unsigned height, EncodeOptions const & options,
+                string const & fileName) {
+    std::vector<unsigned char> png;
+    if (!encodePNG(rows, width, height, options, png)) return false;
+    unsigned error = lodepng::save_file(png, fileName);
+    if (error) {
+      cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+    }
+    return (error == 0);
+  }
+
+  bool writePNG(const unsigned char * rgba, unsigned width, unsigned height, EncodeOptions const & options,
+                string const & fileName) {
+    return writePNG(PixelRows(rgba, width), width, height, options, fileName);
+  }
+}
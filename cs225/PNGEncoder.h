@@ -0,0 +1,120 @@
+/**
+ * @file PNGEncoder.h
+ * A PNG encoder with tunable filtering and compression, that can deflate
+ * stripes of an image on several threads.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+using std::string;
+
+namespace cs225 {
+  /**
+   * How to encode a PNG. The defaults compress about as well as
+   * lodepng's own defaults, on one thread.
+   */
+  class EncodeOptions {
+  public:
+    /**
+     * The filter applied to each row of a truecolor image before it is
+     * compressed. MinSum and Entropy try the five PNG filters on every row
+     * and keep the one that looks most compressible. Palette images are
+     * never filtered, as the PNG specification recommends.
+     */
+    enum Filter { None, Sub, Up, Average, Paeth, MinSum, Entropy };
+
+    Filter filter;    /**< Default MinSum, the heuristic of the PNG specification. */
+
+    /**
+      * Effort of the LZ77 search, from 0 (store the bytes as they are) to
+      * 9 (an 8 KB window and the longest matches). Default 6, lodepng's
+      * default window and matching.
+      */
+    unsigned level;
+
+    /**
+      * Skips the searches that rarely pay on maps: rows are filtered with
+      * Up instead of trying each filter when filter is MinSum or Entropy,
+      * and LZ77 takes each match it finds without looking one byte ahead
+      * for a longer one. Default false.
+      */
+    bool fast;
+
+    /**
+      * Splits the image into horizontal stripes of 256 KB or more each,
+      * converted, filtered and deflated independently, and stitches their
+      * deflate streams into one IDAT stream, as pigz does. The file is a
+      * standard PNG, slightly larger since matches cannot reach across
+      * stripes. Default false.
+      */
+    bool parallel;
+
+    /**
+      * Threads for a parallel encode; 0 for one per core. The file is the
+      * same for any count.
+      */
+    unsigned threads;
+
+    EncodeOptions();
+  };
+
+  /**
+   * The rows of an image to encode, as 8-bit RGBA pixels. Lets an image
+   * stored in another form be converted a row at a time as it is encoded,
+   * without an RGBA copy of the whole image.
+   */
+  class RowSource {
+  public:
+    virtual ~RowSource() { }
+
+    /**
+     * Gets a row, 4 bytes per pixel. It may be called for any row, more
+     * than once, and from several threads at once.
+     * @param y The row, from 0 at the top.
+     * @param scratch Room for one row of 4 * width bytes to convert into.
+     * @return The row: scratch, or where the row is already stored.
+     */
+    virtual const unsigned char * row(unsigned y, unsigned char * scratch) const = 0;
+  };
+
+  /**
+   * Encodes the rows of an image as a PNG file.
+   * @param rows The pixels.
+   * @param width Width of the image.
+   * @param height Height of the image.
+   * @param options How to encode.
+   * @param out Cleared and filled with the file.
+   * @return true, if the image was encoded.
+   */
+  bool encodePNG(RowSource const & rows, unsigned width, unsigned height, EncodeOptions const & options,
+                 std::vector<unsigned char> & out);
+
+  /**
+   * Same as encodePNG(), writing the file to fileName.
+   * @return true, if the image was encoded and written.
+   */
+  bool writePNG(RowSource const & rows, unsigned width, unsigned height, EncodeOptions const & options,
+                string const & fileName);
+
+  /**
+   * Encodes 8-bit RGBA pixels, stored row after row from the top left
+   * corner, as a PNG file.
+   * @param rgba The pixels, 4 bytes each.
+   * @param width Width of the image.
+   * @param height Height of the image.
+   * @param options How to encode.
+   * @param out Cleared and filled with the file.
+   * @return true, if the image was encoded.
+   */
+  bool encodePNG(const unsigned char * rgba, unsigned width, unsigned height, EncodeOptions const & options,
+                 std::vector<unsigned char> & out);
+
+  /**
+   * Same as encodePNG(), writing the file to fileName.
+   * @return true, if the image was encoded and written.
+   */
+  bool writePNG(const unsigned char * rgba, unsigned width, unsigned height, EncodeOptions const & options,
+                string const & fileName);
+}
@@ -0,0 +1,186 @@
+/**
+ * @file RGBAPNG.cpp
+ * Implementation of a PNG image of packed 8-bit RGBA pixels.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+using std::cerr;
+using std::endl;
+
+#include "lodepng/lodepng.h"
+#include "RGBAPNG.h"
+#include "RGB_HSL.h"
+
+namespace cs225 {
+  namespace {
+    std::atomic<unsigned long> copyCount(0);
+  }
+
+  RGBAPixel::RGBAPixel() : r(255), g(255), b(255), a(255) { }
+
+  RGBAPixel::RGBAPixel(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha)
+    : r(red), g(green), b(blue), a(alpha) { }
+
+  RGBAPixel::RGBAPixel(HSLAPixel const & hsla) {
+    hslaColor hsl = {hsla.h, hsla.s, hsla.l, hsla.a};
+    rgbaColor rgb = hsl2rgb(hsl);
+    r = rgb.r;
+    g = rgb.g;
+    b = rgb.b;
+    a = rgb.a;
+  }
+
+  HSLAPixel RGBAPixel::toHSLA() const {
+    rgbaColor rgb = {r, g, b, a};
+    hslaColor hsl = rgb2hsl(rgb);
+    return HSLAPixel(hsl.h, hsl.s, hsl.l, hsl.a);
+  }
+
+  bool RGBAPixel::operator== (RGBAPixel const & other) const {
+    return r == other.r && g == other.g && b == other.b && a == other.a;
+  }
+
+  bool RGBAPixel::operator!= (RGBAPixel const & other) const {
+    return !(*this == other);
+  }
+
+  RGBAPNG::RGBAPNG() : width_(0), height_(0) { }
+
+  RGBAPNG::RGBAPNG(unsigned int width, unsigned int height)
+    : width_(width), height_(height), pixels_((size_t) width * height) { }
+
+  RGBAPNG::RGBAPNG(RGBAPNG const & other)
+    : width_(other.width_), height_(other.height_), pixels_(other.pixels_) {
+    copyCount++;
+  }
+
+  RGBAPNG & RGBAPNG::operator= (RGBAPNG const & other) {
+    if (this != &other) {
+      width_ = other.width_;
+      height_ = other.height_;
+      pixels_ = other.pixels_;
+      copyCount++;
+    }
+    return *this;
+  }
+
+  RGBAPNG::RGBAPNG(RGBAPNG && other) noexcept
+    : width_(other.width_), height_(other.height_), pixels_(std::move(other.pixels_)) {
+    other.width_ = 0;
+    other.height_ = 0;
+    other.pixels_.clear();
+  }
+
+  RGBAPNG & RGBAPNG::operator= (RGBAPNG && other) noexcept {
+    if (this != &other) {
+      width_ = other.width_;
+      height_ = other.height_;
+      pixels_ = std::move(other.pixels_);
+      other.width_ = 0;
+      other.height_ = 0;
+      other.pixels_.clear();
+    }
+    return *this;
+  }
+
+  unsigned long RGBAPNG::copies() {
+    return copyCount;
+  }
+
+  RGBAPNG::RGBAPNG(PNG const & other)
+    : width_(other.width()), height_(other.height()), pixels_((size_t) other.width() * other.height()) {
+    for (unsigned y = 0; y < height_; y++) {
+      RGBAPixel * pixel = row(y);
+      for (unsigned x = 0; x < width_; x++) {
+        pixel[x] = RGBAPixel(other.getPixel(x, y));
+      }
+    }
+  }
+
+  PNG RGBAPNG::toHSLA() const {
+    PNG png(width_, height_);
+    for (unsigned y = 0; y < height_; y++) {
+      const RGBAPixel * pixel = row(y);
+      for (unsigned x = 0; x < width_; x++) {
+        png.getPixel(x, y) = pixel[x].toHSLA();
+      }
+    }
+    return png;
+  }
+
+  bool RGBAPNG::operator== (RGBAPNG const & other) const {
+    return width_ == other.width_ && height_ == other.height_ && pixels_ == other.pixels_;
+  }
+
+  bool RGBAPNG::operator!= (RGBAPNG const & other) const {
+    return !(*this == other);
+  }
+
+  bool RGBAPNG::readFromFile(string const & fileName) {
+    unsigned char * bytes = NULL;
+    unsigned width, height;
+    unsigned error = lodepng_decode32_file(&bytes, &width, &height, fileName.c_str());
+    if (error) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      free(bytes);
+      return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    pixels_.resize((size_t) width * height);
+    memcpy(pixels_.data(), bytes, pixels_.size() * sizeof(RGBAPixel));
+    free(bytes);
+    return true;
+  }
+
+  // the pixel array is handed to lodepng and the encoder as RGBA bytes
+  static_assert(sizeof(RGBAPixel) == 4, "RGBAPixel must be four bytes with no padding");
+
+  bool RGBAPNG::writeToFile(string const & fileName) const {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(pixels_.data());
+    unsigned error = lodepng::encode(fileName, bytes, width_, height_);
+    if (error) {
+      cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+    }
+    return (error == 0);
+  }
+
+  bool RGBAPNG::writeToFile(string const & fileName, EncodeOptions const & options) const {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(pixels_.data());
+    return writePNG(bytes, width_, height_, options, fileName);
+  }
+
+  RGBAPixel & RGBAPNG::getPixel(unsigned int x, unsigned int y) { return _getPixelHelper(x, y); }
+
+  const RGBAPixel & RGBAPNG::getPixel(unsigned int x, unsigned int y) const { return _getPixelHelper(x, y); }
+
+  RGBAPixel & RGBAPNG::_getPixelHelper(unsigned int x, unsigned int y) const {
+    if (width_ == 0 || height_ == 0) {
+      cerr << "ERROR: Call to cs225::RGBAPNG::getPixel() made on an image with no pixels." << endl;
+      assert(width_ > 0);
+      assert(height_ > 0);
+    }
+
+    if (x >= width_) {
+      cerr << "WARNING: Call to cs225::RGBAPNG::getPixel(" << x << "," << y << ") tries to access x=" << x
+          << ", which is outside of the image (image width: " << width_ << ")." << endl;
+      cerr << "       : Truncating x to " << (width_ - 1) << endl;
+      x = width_ - 1;
+    }
+
+    if (y >= height_) {
+      cerr << "WARNING: Call to cs225::RGBAPNG::getPixel(" << x << "," << y << ") tries to access y=" << y
+          << ", which is outside of the image (image height: " << height_ << ")." << endl;
+      cerr << "       : Truncating y to " << (height_ - 1) << endl;
+      y = height_ - 1;
+    }
+
+    return const_cast<RGBAPixel &>(pixels_[x + (size_t) y * width_]);
+  }
+}
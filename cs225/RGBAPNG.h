@@ -0,0 +1,162 @@
+/**
+ * @file RGBAPNG.h
+ * A PNG image that keeps its pixels as packed 8-bit RGBA.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+using std::string;
+
+#include "HSLAPixel.h"
+#include "PNG.h"
+
+namespace cs225 {
+  /**
+   * One pixel of an RGBAPNG: red, green, blue and alpha in [0, 255], laid
+   * out as in a PNG file.
+   */
+  class RGBAPixel {
+  public:
+    unsigned char r; /**< Red, [0, 255]. */
+    unsigned char g; /**< Green, [0, 255]. */
+    unsigned char b; /**< Blue, [0, 255]. */
+    unsigned char a; /**< Alpha, [0, 255]. */
+
+    /**
+     * Constructs an opaque white pixel, like HSLAPixel().
+     */
+    RGBAPixel();
+
+    /**
+     * Constructs a pixel from its channels.
+     */
+    RGBAPixel(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha = 255);
+
+    /**
+     * Converts an HSLA color the way PNG::writeToFile() does, so colors
+     * given as HSLAPixels draw the same on either kind of image.
+     * @param hsla The color.
+     */
+    RGBAPixel(HSLAPixel const & hsla);
+
+    /**
+     * @return This color converted to HSLA, as PNG::readFromFile() does.
+     */
+    HSLAPixel toHSLA() const;
+
+    bool operator== (RGBAPixel const & other) const;
+    bool operator!= (RGBAPixel const & other) const;
+  };
+
+  /**
+   * A PNG image stored as 4 bytes per pixel instead of the 32 of an
+   * HSLAPixel. Files are decoded into and encoded from the pixel buffer
+   * as it is, with no per-pixel conversion; HSLA is computed only when a
+   * caller asks for it.
+   *
+   * Like PNG, pixels are stored row after row from the top left corner,
+   * so row(y) points at width() consecutive pixels.
+   */
+  class RGBAPNG {
+  public:
+    typedef RGBAPixel Pixel;
+
+    /**
+      * Creates an empty image.
+      */
+    RGBAPNG();
+
+    /**
+      * Creates an image of the given dimensions, every pixel opaque white.
+      * @param width Width of the new image.
+      * @param height Height of the new image.
+      */
+    RGBAPNG(unsigned int width, unsigned int height);
+
+    /**
+      * Copies another image, counted by copies().
+      */
+    RGBAPNG(RGBAPNG const & other);
+    RGBAPNG & operator= (RGBAPNG const & other);
+
+    /**
+      * Takes the pixels of another image without copying them, leaving it
+      * an empty image.
+      */
+    RGBAPNG(RGBAPNG && other) noexcept;
+    RGBAPNG & operator= (RGBAPNG && other) noexcept;
+
+    /**
+      * Converts an HSLA image.
+      * @param other The image to convert.
+      */
+    explicit RGBAPNG(PNG const & other);
+
+    /**
+      * @return This image converted to HSLA pixels.
+      */
+    PNG toHSLA() const;
+
+    /**
+      * Equality operator: checks if two images have the same pixels.
+      */
+    bool operator== (RGBAPNG const & other) const;
+    bool operator!= (RGBAPNG const & other) const;
+
+    /**
+      * Reads in a PNG image from a file, decoding it straight to RGBA8.
+      * Overwrites any current image content.
+      * @param fileName Name of the file to be read from.
+      * @return true, if the image was successfully read and loaded.
+      */
+    bool readFromFile(string const & fileName);
+
+    /**
+      * Writes the image to a file, encoding the pixel buffer as it is.
+      * @param fileName Name of the file to be written.
+      * @return true, if the image was successfully written.
+      */
+    bool writeToFile(string const & fileName) const;
+
+    /**
+      * Writes the image to a file, encoded as options say; see
+      * EncodeOptions for the parallel encoder.
+      * @param fileName Name of the file to be written.
+      * @param options Filtering, compression and threads of the encoder.
+      * @return true, if the image was successfully written.
+      */
+    bool writeToFile(string const & fileName, EncodeOptions const & options) const;
+
+    /**
+      * Gets a reference to the pixel at the given coordinates; (0,0) is
+      * the upper left corner. Coordinates outside the image are truncated
+      * to its last row or column with a warning, as in PNG.
+      */
+    RGBAPixel & getPixel(unsigned int x, unsigned int y);
+    const RGBAPixel & getPixel(unsigned int x, unsigned int y) const;
+
+    /**
+      * @return The first of the width() pixels of row y.
+      */
+    RGBAPixel * row(unsigned int y) { return pixels_.data() + (size_t) y * width_; }
+    const RGBAPixel * row(unsigned int y) const { return pixels_.data() + (size_t) y * width_; }
+
+    unsigned int width() const { return width_; }
+    unsigned int height() const { return height_; }
+
+    /**
+      * @return The number of times the pixels of any RGBAPNG have been
+      *  copied, as PNG::copies() counts them for PNGs.
+      */
+    static unsigned long copies();
+
+  private:
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<RGBAPixel> pixels_;
+
+    RGBAPixel & _getPixelHelper(unsigned int x, unsigned int y) const;
+  };
+}
@@ -0,0 +1,307 @@
+#include "csrgraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "mappedfile.h"
+
+const CsrGraph::VertexId CsrGraph::InvalidId = UINT32_MAX;
+const uint32_t CsrGraph::FileVersion = 1;
+
+namespace {
+
+    /** Heap storage for a snapshot built in memory. */
+    struct Buffers
+    {
+        vector<uint32_t> offsets;
+        vector<CsrGraph::VertexId> targets;
+        vector<double> weights;
+        vector<double> coords;
+        vector<int> indices;
+        vector<int> sortedIndices;
+        vector<CsrGraph::VertexId> sortedIds;
+    };
+
+    const char FileMagic[8] = {'C', 'S', 'R', 'G', 'R', 'A', 'P', 'H'};
+    const uint32_t ByteOrderMark = 0x01020304;
+    const uint32_t WeightedFlag = 1;
+    const uint32_t DirectedFlag = 2;
+
+    /** Order of the arrays in a snapshot file. */
+    enum Section { Offsets, Targets, Weights, Coords, Indices, SortedIndices, SortedIds, NumSections };
+
+    /**
+     * Fixed-size header at the start of a snapshot file. Every section
+     * starts at a multiple of 8 bytes so it can be used in place.
+     */
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t numVertices;
+        uint64_t numArcs;
+        uint64_t fileSize;
+        uint64_t sections[NumSections];
+    };
+
+    /** @return the size in bytes of a section */
+    uint64_t sectionBytes(Section section, uint64_t numVertices, uint64_t numArcs)
+    {
+        switch (section) {
+            case Offsets: return (numVertices + 1) * sizeof(uint32_t);
+            case Targets: return numArcs * sizeof(CsrGraph::VertexId);
+            case Weights: return numArcs * sizeof(double);
+            case Coords: return 2 * numVertices * sizeof(double);
+            case Indices: return numVertices * sizeof(int);
+            case SortedIndices: return numVertices * sizeof(int);
+            case SortedIds: return numVertices * sizeof(CsrGraph::VertexId);
+            default: return 0;
+        }
+    }
+
+    uint64_t alignUp(uint64_t bytes)
+    {
+        return (bytes + 7) & ~(uint64_t) 7;
+    }
+
+    /**
+     * Checks the arrays of a mapped snapshot in one pass, so that a corrupt
+     * file cannot make a search read outside them.
+     * @return whether the offsets rise from 0 to numArcs, every target is a
+     *  vertex, and the sorted indices are ascending and name the vertices
+     *  that hold them
+     */
+    bool validArrays(uint64_t numVertices, uint64_t numArcs, const uint32_t* offsets,
+                     const CsrGraph::VertexId* targets, const int* indices, const int* sortedIndices,
+                     const CsrGraph::VertexId* sortedIds)
+    {
+        if (offsets[0] != 0 || offsets[numVertices] != numArcs)
+            return false;
+        for (uint64_t v = 0; v < numVertices; v++) {
+            if (offsets[v] > offsets[v + 1])
+                return false;
+        }
+        for (uint64_t arc = 0; arc < numArcs; arc++) {
+            if (targets[arc] >= numVertices)
+                return false;
+        }
+        for (uint64_t i = 0; i < numVertices; i++) {
+            if (sortedIds[i] >= numVertices || indices[sortedIds[i]] != sortedIndices[i])
+                return false;
+            if (i > 0 && sortedIndices[i - 1] > sortedIndices[i])
+                return false;
+        }
+        return true;
+    }
+}
+
+CsrGraph::CsrGraph()
+    : CsrGraph(false, false, vector<uint32_t>(1, 0), vector<VertexId>(), vector<double>(),
+               vector<double>(), vector<int>())
+{
+}
+
+CsrGraph::CsrGraph(bool weighted, bool directed, vector<uint32_t> offsets, vector<VertexId> targets,
+                   vector<double> weights, vector<double> coords, vector<int> indices)
+    : weighted_(weighted), directed_(directed)
+{
+    std::shared_ptr<Buffers> buffers = std::make_shared<Buffers>();
+    buffers->offsets = std::move(offsets);
+    buffers->targets = std::move(targets);
+    buffers->weights = std::move(weights);
+    buffers->coords = std::move(coords);
+    buffers->indices = std::move(indices);
+
+    vector<std::pair<int, VertexId>> lookup;
+    lookup.reserve(buffers->indices.size());
+    for (VertexId id = 0; id < buffers->indices.size(); id++)
+        lookup.push_back(std::make_pair(buffers->indices[id], id));
+    std::sort(lookup.begin(), lookup.end());
+    buffers->sortedIndices.reserve(lookup.size());
+    buffers->sortedIds.reserve(lookup.size());
+    for (const std::pair<int, VertexId>& entry : lookup) {
+        buffers->sortedIndices.push_back(entry.first);
+        buffers->sortedIds.push_back(entry.second);
+    }
+
+    numVertices_ = (uint32_t) buffers->indices.size();
+    numArcs_ = buffers->targets.size();
+    offsets_ = buffers->offsets.data();
+    targets_ = buffers->targets.data();
+    weights_ = buffers->weights.data();
+    coords_ = buffers->coords.data();
+    indices_ = buffers->indices.data();
+    sortedIndices_ = buffers->sortedIndices.data();
+    sortedIds_ = buffers->sortedIds.data();
+    storage_ = buffers;
+}
+
+CsrGraph::VertexId CsrGraph::getId(Vertex v) const
+{
+    const int* it = std::lower_bound(sortedIndices_, sortedIndices_ + numVertices_, v.getIndex());
+    if (it == sortedIndices_ + numVertices_ || *it != v.getIndex())
+        return InvalidId;
+    return sortedIds_[it - sortedIndices_];
+}
+
+CsrGraph CsrGraph::reversed() const
+{
+    if (!directed_)
+        return *this;
+
+    vector<uint32_t> offsets(numVertices_ + 1, 0);
+    for (size_t arc = 0; arc < numArcs_; arc++)
+        offsets[targets_[arc] + 1]++;
+    for (uint32_t v = 0; v < numVertices_; v++)
+        offsets[v + 1] += offsets[v];
+
+    vector<VertexId> targets(numArcs_);
+    vector<double> weights(numArcs_);
+    vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (VertexId u = 0; u < numVertices_; u++) {
+        for (uint32_t arc = offsets_[u]; arc < offsets_[u + 1]; arc++) {
+            uint32_t position = next[targets_[arc]]++;
+            targets[position] = u;
+            weights[position] = weights_[arc];
+        }
+    }
+
+    return CsrGraph(weighted_, directed_, std::move(offsets), std::move(targets), std::move(weights),
+                    vector<double>(coords_, coords_ + 2 * numVertices_),
+                    vector<int>(indices_, indices_ + numVertices_));
+}
+
+CsrGraph CsrGraph::permuted(const vector<VertexId>& order) const
+{
+    vector<VertexId> newId(numVertices_);
+    for (VertexId id = 0; id < numVertices_; id++)
+        newId[order[id]] = id;
+
+    vector<uint32_t> offsets(1, 0);
+    vector<VertexId> targets;
+    vector<double> weights;
+    vector<double> coords;
+    vector<int> indices;
+    offsets.reserve(numVertices_ + 1);
+    targets.reserve(numArcs_);
+    weights.reserve(numArcs_);
+    coords.reserve(2 * numVertices_);
+    indices.reserve(numVertices_);
+    for (VertexId id = 0; id < numVertices_; id++) {
+        VertexId old = order[id];
+        for (uint32_t arc = offsets_[old]; arc < offsets_[old + 1]; arc++) {
+            targets.push_back(newId[targets_[arc]]);
+            weights.push_back(weights_[arc]);
+        }
+        offsets.push_back((uint32_t) targets.size());
+        coords.push_back(coords_[2 * old]);
+        coords.push_back(coords_[2 * old + 1]);
+        indices.push_back(indices_[old]);
+    }
+
+    return CsrGraph(weighted_, directed_, std::move(offsets), std::move(targets), std::move(weights),
+                    std::move(coords), std::move(indices));
+}
+
+size_t CsrGraph::memoryUsage() const
+{
+    size_t bytes = 0;
+    for (int section = 0; section < NumSections; section++)
+        bytes += sectionBytes((Section) section, numVertices_, numArcs_);
+    return bytes;
+}
+
+bool CsrGraph::writeToFile(const string& fileName) const
+{
+    const void* data[NumSections] = {offsets_, targets_, weights_, coords_, indices_,
+                                     sortedIndices_, sortedIds_};
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.byteOrder = ByteOrderMark;
+    header.flags = (weighted_ ? WeightedFlag : 0) | (directed_ ? DirectedFlag : 0);
+    header.numVertices = numVertices_;
+    header.numArcs = numArcs_;
+
+    uint64_t position = alignUp(sizeof(FileHeader));
+    for (int section = 0; section < NumSections; section++) {
+        header.sections[section] = position;
+        position = alignUp(position + sectionBytes((Section) section, numVertices_, numArcs_));
+    }
+    header.fileSize = position;
+
+    string tempName;
+    if (!createTempFile(fileName, tempName))
+        return false;
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+
+    const char padding[8] = {0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, alignUp(sizeof(header)) - sizeof(header));
+    for (int section = 0; section < NumSections; section++) {
+        uint64_t bytes = sectionBytes((Section) section, numVertices_, numArcs_);
+        if (bytes > 0)
+            file.write(static_cast<const char*>(data[section]), bytes);
+        file.write(padding, alignUp(bytes) - bytes);
+    }
+    file.close();
+    if (!file || std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CsrGraph::readFromFile(const string& fileName)
+{
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(fileName, false);
+    if (!mapping->isOpen() || mapping->size() < sizeof(FileHeader))
+        return false;
+
+    FileHeader header;
+    memcpy(&header, mapping->begin(), sizeof(header));
+    if (memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0
+        || header.version != FileVersion
+        || header.byteOrder != ByteOrderMark
+        || header.fileSize != mapping->size()
+        || header.numVertices >= InvalidId
+        || header.numArcs > UINT32_MAX)
+        return false;
+
+    const char* base = mapping->begin();
+    for (int section = 0; section < NumSections; section++) {
+        uint64_t start = header.sections[section];
+        uint64_t bytes = sectionBytes((Section) section, header.numVertices, header.numArcs);
+        if (start % 8 != 0 || start > header.fileSize || bytes > header.fileSize - start)
+            return false;
+    }
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(base + header.sections[Offsets]);
+    const VertexId* targets = reinterpret_cast<const VertexId*>(base + header.sections[Targets]);
+    const int* indices = reinterpret_cast<const int*>(base + header.sections[Indices]);
+    const int* sortedIndices = reinterpret_cast<const int*>(base + header.sections[SortedIndices]);
+    const VertexId* sortedIds = reinterpret_cast<const VertexId*>(base + header.sections[SortedIds]);
+    if (!validArrays(header.numVertices, header.numArcs, offsets, targets, indices, sortedIndices, sortedIds))
+        return false;
+
+    weighted_ = (header.flags & WeightedFlag) != 0;
+    directed_ = (header.flags & DirectedFlag) != 0;
+    numVertices_ = (uint32_t) header.numVertices;
+    numArcs_ = header.numArcs;
+    offsets_ = offsets;
+    targets_ = targets;
+    weights_ = reinterpret_cast<const double*>(base + header.sections[Weights]);
+    coords_ = reinterpret_cast<const double*>(base + header.sections[Coords]);
+    indices_ = indices;
+    sortedIndices_ = sortedIndices;
+    sortedIds_ = sortedIds;
+    storage_ = mapping;
+    return true;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file csrgraph.h
+ * Immutable compressed-sparse-row snapshot of a Graph.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vertex.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Read-only snapshot of a Graph stored in compressed-sparse-row form.
+ *
+ * Vertices are renumbered with dense ids 0..numVertices()-1. The arcs
+ * leaving vertex u are the contiguous range [arcBegin(u), arcEnd(u)) of the
+ * target and weight arrays, so scanning the neighbors of a vertex is a
+ * sequential walk instead of a pair of hash lookups. Coordinates and the
+ * original vertex indices are kept in separate arrays indexed by id.
+ *
+ * Snapshots are created with Graph::freeze() or read from a binary file
+ * with readFromFile(), and never change afterwards. Copies share the same
+ * arrays, so copying a snapshot is cheap.
+ */
+class CsrGraph
+{
+  public:
+    typedef uint32_t VertexId;
+
+    /** Id returned when a vertex is not part of the snapshot. */
+    static const VertexId InvalidId;
+
+    /** Version of the binary format written by writeToFile(). */
+    static const uint32_t FileVersion;
+
+    /**
+     * Creates an empty snapshot.
+     */
+    CsrGraph();
+
+    /**
+     * Creates a snapshot from CSR arrays.
+     * @param weighted - whether the weights came from a weighted graph
+     * @param directed - whether each arc is a one-way edge
+     * @param offsets - numVertices + 1 arc offsets
+     * @param targets - target id of each arc
+     * @param weights - weight of each arc
+     * @param coords - interleaved x, y coordinates of each vertex
+     * @param indices - original vertex index of each vertex
+     */
+    CsrGraph(bool weighted, bool directed, vector<uint32_t> offsets, vector<VertexId> targets,
+             vector<double> weights, vector<double> coords, vector<int> indices);
+
+    /**
+     * @return the number of vertices in the snapshot
+     */
+    uint32_t numVertices() const { return numVertices_; }
+
+    /**
+     * @return the number of arcs in the snapshot; an undirected edge is
+     *  stored once in each direction
+     */
+    size_t numArcs() const { return numArcs_; }
+
+    bool isDirected() const { return directed_; }
+    bool isWeighted() const { return weighted_; }
+
+    /**
+     * Finds the dense id of a vertex by its index.
+     * @param v - the vertex to look up
+     * @return the id of v, or InvalidId if v is not in the snapshot
+     */
+    VertexId getId(Vertex v) const;
+
+    /**
+     * Rebuilds the Vertex that was assigned the given id.
+     * @param id - a dense vertex id
+     * @return the vertex with its original index and coordinates
+     */
+    Vertex getVertex(VertexId id) const
+    {
+        return Vertex(indices_[id], coords_[2 * id], coords_[2 * id + 1]);
+    }
+
+    int getIndex(VertexId id) const { return indices_[id]; }
+    double getX(VertexId id) const { return coords_[2 * id]; }
+    double getY(VertexId id) const { return coords_[2 * id + 1]; }
+
+    /** An arc as seen from its source: where it leads and what it costs. */
+    struct Arc
+    {
+        VertexId target;
+        double weight;
+    };
+
+    /**
+     * The arcs leaving one vertex, read in place from the CSR arrays:
+     *   for (CsrGraph::Arc arc : g.neighbors(u)) ...
+     */
+    class ArcRange
+    {
+      public:
+        class iterator
+        {
+          public:
+            iterator(const VertexId* target, const double* weight) : target_(target), weight_(weight) {}
+            Arc operator*() const { return Arc{*target_, *weight_}; }
+            iterator& operator++()
+            {
+                ++target_;
+                ++weight_;
+                return *this;
+            }
+            bool operator!=(const iterator& other) const { return target_ != other.target_; }
+            bool operator==(const iterator& other) const { return target_ == other.target_; }
+
+          private:
+            const VertexId* target_;
+            const double* weight_;
+        };
+
+        ArcRange(const VertexId* targets, const double* weights, uint32_t size)
+            : targets_(targets), weights_(weights), size_(size) {}
+        iterator begin() const { return iterator(targets_, weights_); }
+        iterator end() const { return iterator(targets_ + size_, weights_ + size_); }
+        uint32_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+      private:
+        const VertexId* targets_;
+        const double* weights_;
+        uint32_t size_;
+    };
+
+    /** @return the arcs leaving u, without copying them */
+    ArcRange neighbors(VertexId u) const
+    {
+        return ArcRange(targets_ + offsets_[u], weights_ + offsets_[u], offsets_[u + 1] - offsets_[u]);
+    }
+
+    /** @return the first arc leaving u */
+    uint32_t arcBegin(VertexId u) const { return offsets_[u]; }
+
+    /** @return one past the last arc leaving u */
+    uint32_t arcEnd(VertexId u) const { return offsets_[u + 1]; }
+
+    /** @return the vertex an arc points to */
+    VertexId target(uint32_t arc) const { return targets_[arc]; }
+
+    /** @return the weight of an arc (1 for unweighted graphs) */
+    double weight(uint32_t arc) const { return weights_[arc]; }
+
+    /**
+     * Creates the snapshot with every arc turned around, for searches that
+     * run backward from the target. An undirected snapshot is its own
+     * reverse, so this is a cheap copy unless isDirected().
+     * @return a snapshot with the same ids and an arc v -> u for every
+     *  arc u -> v of this one
+     */
+    CsrGraph reversed() const;
+
+    /**
+     * Creates the snapshot with its vertices renumbered, for example to
+     * put vertices that are close in the graph close in memory. Vertices
+     * keep their original index and coordinates, so getId(Vertex) and
+     * getVertex() still translate between the new ids and the vertices
+     * the rest of the program uses.
+     * @param order - a permutation of the ids: vertex order[i] of this
+     *  snapshot becomes vertex i of the result
+     * @return the renumbered snapshot
+     */
+    CsrGraph permuted(const vector<VertexId>& order) const;
+
+    /**
+     * @return the number of bytes held by the snapshot's arrays
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * Writes the snapshot in the binary snapshot format: a header followed
+     * by the offset, target, weight, coordinate and index arrays, each
+     * aligned so that it can be used in place once mapped. The file is
+     * written under a unique name beside fileName and renamed over it, so
+     * readers that mapped the old file keep a consistent copy, and of
+     * several processes writing fileName at once, one wins whole.
+     * @param fileName - name of the file to write
+     * @return true, if the file was successfully written
+     */
+    bool writeToFile(const string& fileName) const;
+
+    /**
+     * Replaces this snapshot with one mapped read-only from a file written
+     * by writeToFile(). Nothing is parsed or copied: the arrays point into
+     * the mapping, pages are loaded on first touch, and processes mapping
+     * the same file share one copy in the page cache. The arrays are checked
+     * once, so a corrupt file is rejected rather than read out of bounds.
+     * @param fileName - name of the file to read
+     * @return true, if the file was a valid snapshot for this machine
+     */
+    bool readFromFile(const string& fileName);
+
+  private:
+    bool weighted_;
+    bool directed_;
+    uint32_t numVertices_;
+    size_t numArcs_;
+
+    const uint32_t* offsets_;       /**< numVertices + 1 arc offsets */
+    const VertexId* targets_;       /**< arc targets */
+    const double* weights_;         /**< arc weights */
+    const double* coords_;          /**< interleaved x, y per vertex */
+    const int* indices_;            /**< original vertex index per id */
+    const int* sortedIndices_;      /**< indices in ascending order */
+    const VertexId* sortedIds_;     /**< id of each entry in sortedIndices_ */
+
+    /** Owner of the arrays above: heap buffers or a file mapping. */
+    std::shared_ptr<const void> storage_;
+};
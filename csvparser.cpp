@@ -0,0 +1,190 @@
+#include "csvparser.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+namespace csv {
+
+    const char* skipBom(const char* begin, const char* end)
+    {
+        if (end - begin >= 3 && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+            return begin + 3;
+        return begin;
+    }
+
+    size_t countLines(const char* begin, const char* end)
+    {
+        size_t lines = 0;
+        const char* cursor = begin;
+        while (cursor < end) {
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            lines++;
+            if (newline == NULL)
+                break;
+            cursor = newline + 1;
+        }
+        return lines;
+    }
+
+    vector<const char*> splitAtLines(const char* begin, const char* end, unsigned parts)
+    {
+        vector<const char*> bounds(1, begin);
+        size_t size = end - begin;
+        for (unsigned part = 1; part < parts; part++) {
+            const char* cut = begin + size * part / parts;
+            if (cut <= bounds.back())
+                continue;
+            // move the cut to the start of the next line
+            const char* newline = static_cast<const char*>(memchr(cut - 1, '\n', end - cut + 1));
+            if (newline == NULL || newline + 1 >= end)
+                break;
+            if (newline + 1 > bounds.back())
+                bounds.push_back(newline + 1);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    namespace {
+
+        /** Longest numeric field that is parsed; longer fields are malformed. */
+        const size_t MaxFieldLength = 63;
+
+        /**
+         * Finds the end of the line at cursor and moves cursor past it.
+         * @return one past the last character of the line, before "\n" and
+         *  a trailing '\r'
+         */
+        const char* takeLine(const char*& cursor, const char* end)
+        {
+            const char* lineStart = cursor;
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            const char* lineEnd = (newline == NULL) ? end : newline;
+            cursor = (newline == NULL) ? end : newline + 1;
+            if (lineEnd > lineStart && lineEnd[-1] == '\r')
+                lineEnd--;
+            return lineEnd;
+        }
+
+        /**
+         * Moves p to the start of the next field, past empty fields and the
+         * blanks that lead a field, as the original tokenizer and stod did.
+         */
+        void skipToField(const char*& p, const char* lineEnd)
+        {
+            while (p < lineEnd && (*p == ',' || *p == ' ' || *p == '\t'))
+                p++;
+        }
+
+        /**
+         * @return whether p ends a field
+         */
+        bool atFieldEnd(const char* p, const char* lineEnd)
+        {
+            return p == lineEnd || *p == ',';
+        }
+
+        /**
+         * Parses one integer field in place.
+         */
+        bool parseField(const char*& p, const char* lineEnd, int& value)
+        {
+            skipToField(p, lineEnd);
+            std::from_chars_result result = std::from_chars(p, lineEnd, value);
+            if (result.ec != std::errc())
+                return false;
+            p = result.ptr;
+            return atFieldEnd(p, lineEnd);
+        }
+
+        /**
+         * Parses one decimal field through strtod on a NUL-terminated copy of
+         * the field; the mapped file is not terminated, and floating-point
+         * from_chars is missing from libc++.
+         */
+        bool parseField(const char*& p, const char* lineEnd, double& value)
+        {
+            skipToField(p, lineEnd);
+            const char* fieldEnd = p;
+            while (fieldEnd < lineEnd && *fieldEnd != ',')
+                fieldEnd++;
+            size_t length = fieldEnd - p;
+            if (length == 0 || length > MaxFieldLength)
+                return false;
+
+            char field[MaxFieldLength + 1];
+            memcpy(field, p, length);
+            field[length] = '\0';
+            char* parsedEnd = NULL;
+            value = strtod(field, &parsedEnd);
+            if (parsedEnd != field + length)
+                return false;
+            p = fieldEnd;
+            return true;
+        }
+
+        /**
+         * @return whether only empty fields remain before lineEnd
+         */
+        bool atLineEnd(const char* p, const char* lineEnd)
+        {
+            skipToField(p, lineEnd);
+            return p == lineEnd;
+        }
+    }
+
+    RowStatus parseRow(const char*& cursor, const char* end, VertexRecord& out)
+    {
+        const char* p = cursor;
+        const char* lineEnd = takeLine(cursor, end);
+        if (atLineEnd(p, lineEnd))
+            return Blank;
+
+        if (parseField(p, lineEnd, out.index) && parseField(p, lineEnd, out.x)
+            && parseField(p, lineEnd, out.y) && atLineEnd(p, lineEnd))
+            return Parsed;
+        return Malformed;
+    }
+
+    RowStatus parseRow(const char*& cursor, const char* end, ConnectionRecord& out)
+    {
+        const char* p = cursor;
+        const char* lineEnd = takeLine(cursor, end);
+        if (atLineEnd(p, lineEnd))
+            return Blank;
+
+        if (parseField(p, lineEnd, out.index) && parseField(p, lineEnd, out.first)
+            && parseField(p, lineEnd, out.second) && parseField(p, lineEnd, out.weight)
+            && atLineEnd(p, lineEnd))
+            return Parsed;
+        return Malformed;
+    }
+
+    RowStatus parseRow(const char*& cursor, const char* end, QueryRecord& out)
+    {
+        const char* p = cursor;
+        const char* lineEnd = takeLine(cursor, end);
+        if (atLineEnd(p, lineEnd))
+            return Blank;
+
+        if (parseField(p, lineEnd, out.source) && parseField(p, lineEnd, out.target)
+            && atLineEnd(p, lineEnd))
+            return Parsed;
+        return Malformed;
+    }
+
+    RowStatus parseRow(const char*& cursor, const char* end, PointQueryRecord& out)
+    {
+        const char* p = cursor;
+        const char* lineEnd = takeLine(cursor, end);
+        if (atLineEnd(p, lineEnd))
+            return Blank;
+
+        if (parseField(p, lineEnd, out.sourceX) && parseField(p, lineEnd, out.sourceY)
+            && parseField(p, lineEnd, out.targetX) && parseField(p, lineEnd, out.targetY)
+            && atLineEnd(p, lineEnd))
+            return Parsed;
+        return Malformed;
+    }
+}
@@ -0,0 +1,177 @@
+/**
+ * @file csvparser.h
+ * Zero-copy parsing of the vertex and connection CSV files.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mappedfile.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * One line of a vertex file: index, x coordinate, y coordinate.
+ */
+struct VertexRecord
+{
+    int index;
+    double x;
+    double y;
+};
+
+/**
+ * One line of a connections file: index, first vertex, second vertex,
+ * weight.
+ */
+struct ConnectionRecord
+{
+    int index;
+    int first;
+    int second;
+    double weight;
+};
+
+/**
+ * One line of a query file: index of the source vertex, index of the
+ * target vertex.
+ */
+struct QueryRecord
+{
+    int source;
+    int target;
+};
+
+/**
+ * One line of a query file given by coordinates: x and y of the source,
+ * x and y of the target.
+ */
+struct PointQueryRecord
+{
+    double sourceX;
+    double sourceY;
+    double targetX;
+    double targetY;
+};
+
+namespace csv {
+
+    /** Result of parsing one line. */
+    enum RowStatus { Parsed, Blank, Malformed };
+
+    /**
+     * @return begin advanced past a UTF-8 byte order mark, if there is one
+     */
+    const char* skipBom(const char* begin, const char* end);
+
+    /**
+     * @return the number of lines in [begin, end), counting a last line
+     *  without a trailing newline
+     */
+    size_t countLines(const char* begin, const char* end);
+
+    /**
+     * Parses the line starting at cursor in place and advances cursor to
+     * the start of the next line. Fields are separated by commas; a
+     * trailing '\r' is ignored.
+     * @param cursor - start of the line; moved past its newline
+     * @param end - end of the buffer
+     * @param out - record to fill in
+     * @return whether the line held a record, was blank, or was malformed
+     */
+    RowStatus parseRow(const char*& cursor, const char* end, VertexRecord& out);
+    RowStatus parseRow(const char*& cursor, const char* end, ConnectionRecord& out);
+    RowStatus parseRow(const char*& cursor, const char* end, QueryRecord& out);
+    RowStatus parseRow(const char*& cursor, const char* end, PointQueryRecord& out);
+
+    /**
+     * Parses every line in [begin, end) without allocating and passes each
+     * record to visit.
+     * @param begin - start of the first line
+     * @param end - end of the buffer
+     * @param visit - called with each parsed Record
+     * @param malformed - if not NULL, incremented for each malformed line
+     * @return the number of records parsed
+     */
+    template <class Record, class Visitor>
+    size_t forEachRow(const char* begin, const char* end, Visitor visit, size_t* malformed = NULL)
+    {
+        size_t rows = 0;
+        const char* cursor = begin;
+        while (cursor < end) {
+            Record record;
+            RowStatus status = parseRow(cursor, end, record);
+            if (status == Parsed) {
+                visit(record);
+                rows++;
+            } else if (status == Malformed && malformed != NULL) {
+                ++*malformed;
+            }
+        }
+        return rows;
+    }
+
+    /**
+     * Splits [begin, end) into at most parts ranges of similar size that
+     * each start at the beginning of a line.
+     * @return the range boundaries: range i is [bounds[i], bounds[i + 1])
+     */
+    vector<const char*> splitAtLines(const char* begin, const char* end, unsigned parts);
+
+    /**
+     * Parses [begin, end) on several threads. Each thread parses one range
+     * from splitAtLines into its own buffer; the buffers are concatenated
+     * in file order, so the result is the same for any thread count.
+     * @param begin - start of the first line
+     * @param end - end of the buffer
+     * @param threads - number of threads to use (at least 1)
+     * @param convert - maps each Record to the stored value
+     * @param malformed - if not NULL, incremented for each malformed line
+     * @return the converted records in file order
+     */
+    template <class Record, class Convert>
+    auto parseParallel(const char* begin, const char* end, unsigned threads, Convert convert,
+                       size_t* malformed = NULL) -> vector<decltype(convert(Record()))>
+    {
+        typedef decltype(convert(Record())) Value;
+        vector<const char*> bounds = splitAtLines(begin, end, threads == 0 ? 1 : threads);
+        size_t parts = bounds.size() - 1;
+
+        vector<vector<Value>> buffers(parts);
+        vector<size_t> bad(parts, 0);
+        auto work = [&](size_t part) {
+            vector<Value>& buffer = buffers[part];
+            buffer.reserve(countLines(bounds[part], bounds[part + 1]));
+            forEachRow<Record>(bounds[part], bounds[part + 1],
+                               [&](const Record& r) { buffer.push_back(convert(r)); }, &bad[part]);
+        };
+
+        vector<std::thread> workers;
+        for (size_t part = 1; part < parts; part++)
+            workers.push_back(std::thread(work, part));
+        if (parts > 0)
+            work(0);
+        for (std::thread& worker : workers)
+            worker.join();
+
+        size_t total = 0;
+        for (size_t part = 0; part < parts; part++) {
+            total += buffers[part].size();
+            if (malformed != NULL)
+                *malformed += bad[part];
+        }
+        if (parts == 1)
+            return std::move(buffers[0]);
+
+        vector<Value> result;
+        result.reserve(total);
+        for (size_t part = 0; part < parts; part++)
+            result.insert(result.end(), buffers[part].begin(), buffers[part].end());
+        return result;
+    }
+}
@@ -0,0 +1,288 @@
+#include "edgetree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "graph.h"
+
+namespace {
+
+    /**
+     * Sort-Tile-Recursive order of items with the given centers: sorted by
+     * x, cut into slices of whole nodes, each slice sorted by y.
+     */
+    vector<uint32_t> tileOrder(const vector<double>& centerX, const vector<double>& centerY)
+    {
+        size_t n = centerX.size();
+        vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return centerX[a] < centerX[b]; });
+
+        size_t nodes = (n + EdgeTree::Capacity - 1) / EdgeTree::Capacity;
+        size_t slices = (size_t) std::ceil(std::sqrt((double) nodes));
+        size_t sliceSize = std::max<size_t>(1, (nodes + slices - 1) / slices) * EdgeTree::Capacity;
+        for (size_t begin = 0; begin < n; begin += sliceSize) {
+            size_t end = std::min(n, begin + sliceSize);
+            std::sort(order.begin() + begin, order.begin() + end,
+                      [&](uint32_t a, uint32_t b) { return centerY[a] < centerY[b]; });
+        }
+        return order;
+    }
+
+    /** @return whether segment (x0, y0)-(x1, y1) meets the rectangle (Liang-Barsky) */
+    bool meetsRectangle(double x0, double y0, double x1, double y1,
+                        double minX, double minY, double maxX, double maxY)
+    {
+        double dx = x1 - x0, dy = y1 - y0;
+        double p[4] = {-dx, dx, -dy, dy};
+        double q[4] = {x0 - minX, maxX - x0, y0 - minY, maxY - y0};
+        double enter = 0, leave = 1;
+        for (int i = 0; i < 4; i++) {
+            if (p[i] == 0) {
+                if (q[i] < 0)
+                    return false;
+            } else if (p[i] < 0) {
+                enter = std::max(enter, q[i] / p[i]);
+            } else {
+                leave = std::min(leave, q[i] / p[i]);
+            }
+        }
+        return enter <= leave;
+    }
+
+    /** @return the squared distance from (x, y) to segment (x0, y0)-(x1, y1) */
+    double distanceSquared(double x, double y, double x0, double y0, double x1, double y1)
+    {
+        double dx = x1 - x0, dy = y1 - y0;
+        double length = dx * dx + dy * dy;
+        double t = length > 0 ? ((x - x0) * dx + (y - y0) * dy) / length : 0;
+        t = std::min(1.0, std::max(0.0, t));
+        double px = x0 + t * dx - x, py = y0 + t * dy - y;
+        return px * px + py * py;
+    }
+}
+
+EdgeTree::EdgeTree()
+{
+}
+
+EdgeTree::EdgeTree(const Graph& g)
+{
+    for (const Edge& edge : g.edges())
+        segments_.push_back(Segment{edge.source, edge.dest});
+    for (const Vertex& v : g.vertices()) {
+        if (g.neighbors(v).empty())
+            segments_.push_back(Segment{v, v});
+    }
+    build();
+}
+
+EdgeTree::EdgeTree(const CsrGraph& g)
+{
+    vector<char> hasArc(g.numVertices(), 0);
+    for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+        for (CsrGraph::Arc arc : g.neighbors(u)) {
+            hasArc[u] = hasArc[arc.target] = 1;
+            if (g.isDirected() || u <= arc.target)
+                segments_.push_back(Segment{g.getVertex(u), g.getVertex(arc.target)});
+        }
+    }
+    for (CsrGraph::VertexId u = 0; u < g.numVertices(); u++) {
+        if (!hasArc[u])
+            segments_.push_back(Segment{g.getVertex(u), g.getVertex(u)});
+    }
+    build();
+}
+
+EdgeTree::EdgeTree(vector<Segment> segments) : segments_(std::move(segments))
+{
+    build();
+}
+
+void EdgeTree::build()
+{
+    if (segments_.empty())
+        return;
+
+    vector<double> centerX, centerY;
+    for (const Segment& s : segments_) {
+        centerX.push_back((s.first.getExactX() + s.second.getExactX()) / 2);
+        centerY.push_back((s.first.getExactY() + s.second.getExactY()) / 2);
+    }
+    vector<uint32_t> order = tileOrder(centerX, centerY);
+    vector<Segment> sorted;
+    sorted.reserve(segments_.size());
+    for (uint32_t i : order)
+        sorted.push_back(segments_[i]);
+    segments_.swap(sorted);
+
+    vector<Node> level;
+    for (uint32_t first = 0; first < segments_.size(); first += Capacity) {
+        Node node = {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                     -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                     0, first, (uint32_t) std::min<size_t>(Capacity, segments_.size() - first)};
+        for (uint32_t i = first; i < first + node.count; i++) {
+            node.length += std::hypot(segments_[i].second.getExactX() - segments_[i].first.getExactX(),
+                                      segments_[i].second.getExactY() - segments_[i].first.getExactY());
+            for (const Vertex& v : {segments_[i].first, segments_[i].second}) {
+                node.minX = std::min(node.minX, v.getExactX());
+                node.minY = std::min(node.minY, v.getExactY());
+                node.maxX = std::max(node.maxX, v.getExactX());
+                node.maxY = std::max(node.maxY, v.getExactY());
+            }
+        }
+        level.push_back(node);
+    }
+
+    while (level.size() > 1) {
+        centerX.clear();
+        centerY.clear();
+        for (const Node& node : level) {
+            centerX.push_back((node.minX + node.maxX) / 2);
+            centerY.push_back((node.minY + node.maxY) / 2);
+        }
+        order = tileOrder(centerX, centerY);
+        vector<Node> packed;
+        packed.reserve(level.size());
+        for (uint32_t i : order)
+            packed.push_back(level[i]);
+        levels_.push_back(packed);
+
+        level.clear();
+        for (uint32_t first = 0; first < packed.size(); first += Capacity) {
+            Node parent = packed[first];
+            parent.first = first;
+            parent.count = (uint32_t) std::min<size_t>(Capacity, packed.size() - first);
+            for (uint32_t i = first + 1; i < first + parent.count; i++) {
+                parent.minX = std::min(parent.minX, packed[i].minX);
+                parent.minY = std::min(parent.minY, packed[i].minY);
+                parent.maxX = std::max(parent.maxX, packed[i].maxX);
+                parent.maxY = std::max(parent.maxY, packed[i].maxY);
+                parent.length += packed[i].length;
+            }
+            level.push_back(parent);
+        }
+    }
+    levels_.push_back(level);
+}
+
+void EdgeTree::bounds(double& minX, double& minY, double& maxX, double& maxY) const
+{
+    if (levels_.empty()) {
+        minX = minY = maxX = maxY = 0;
+        return;
+    }
+    const Node& root = levels_.back().front();
+    minX = root.minX;
+    minY = root.minY;
+    maxX = root.maxX;
+    maxY = root.maxY;
+}
+
+template <class Accept>
+void EdgeTree::query(double minX, double minY, double maxX, double maxY, Accept accept) const
+{
+    if (levels_.empty())
+        return;
+    // (level, node) pairs still to visit
+    vector<std::pair<size_t, uint32_t>> stack(1, std::make_pair(levels_.size() - 1, 0u));
+    while (!stack.empty()) {
+        size_t depth = stack.back().first;
+        const Node& node = levels_[depth][stack.back().second];
+        stack.pop_back();
+        if (node.maxX < minX || node.minX > maxX || node.maxY < minY || node.minY > maxY)
+            continue;
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (depth > 0)
+                stack.push_back(std::make_pair(depth - 1, i));
+            else
+                accept(segments_[i]);
+        }
+    }
+}
+
+void EdgeTree::inRectangle(double minX, double minY, double maxX, double maxY, vector<Segment>& out) const
+{
+    out.clear();
+    query(minX, minY, maxX, maxY, [&](const Segment& s) {
+        if (meetsRectangle(s.first.getExactX(), s.first.getExactY(), s.second.getExactX(),
+                           s.second.getExactY(), minX, minY, maxX, maxY))
+            out.push_back(s);
+    });
+}
+
+bool EdgeTree::anyInRectangle(double minX, double minY, double maxX, double maxY) const
+{
+    if (levels_.empty())
+        return false;
+    vector<std::pair<size_t, uint32_t>> stack(1, std::make_pair(levels_.size() - 1, 0u));
+    while (!stack.empty()) {
+        size_t depth = stack.back().first;
+        const Node& node = levels_[depth][stack.back().second];
+        stack.pop_back();
+        if (node.maxX < minX || node.minX > maxX || node.maxY < minY || node.minY > maxY)
+            continue;
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (depth > 0) {
+                stack.push_back(std::make_pair(depth - 1, i));
+                continue;
+            }
+            const Segment& s = segments_[i];
+            if (meetsRectangle(s.first.getExactX(), s.first.getExactY(), s.second.getExactX(),
+                               s.second.getExactY(), minX, minY, maxX, maxY))
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Walks the tree like query(), but stops at nodes smaller than the
+ * resolution.
+ */
+void EdgeTree::inRectangle(double minX, double minY, double maxX, double maxY, double resolution,
+                           const std::function<bool(const Cell&)>& whole, vector<Segment>& segments,
+                           vector<Cell>& cells) const
+{
+    segments.clear();
+    cells.clear();
+    if (levels_.empty())
+        return;
+    vector<std::pair<size_t, uint32_t>> stack(1, std::make_pair(levels_.size() - 1, 0u));
+    while (!stack.empty()) {
+        size_t depth = stack.back().first;
+        const Node& node = levels_[depth][stack.back().second];
+        stack.pop_back();
+        if (node.maxX < minX || node.minX > maxX || node.maxY < minY || node.minY > maxY)
+            continue;
+        if (node.maxX - node.minX < resolution && node.maxY - node.minY < resolution) {
+            Cell cell = {node.minX, node.minY, node.maxX, node.maxY, node.length};
+            if (whole(cell)) {
+                cells.push_back(cell);
+                continue;
+            }
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (depth > 0) {
+                stack.push_back(std::make_pair(depth - 1, i));
+            } else {
+                const Segment& s = segments_[i];
+                if (meetsRectangle(s.first.getExactX(), s.first.getExactY(), s.second.getExactX(),
+                                   s.second.getExactY(), minX, minY, maxX, maxY))
+                    segments.push_back(s);
+            }
+        }
+    }
+}
+
+void EdgeTree::inRadius(double x, double y, double radius, vector<Segment>& out) const
+{
+    out.clear();
+    query(x - radius, y - radius, x + radius, y + radius, [&](const Segment& s) {
+        if (distanceSquared(x, y, s.first.getExactX(), s.first.getExactY(), s.second.getExactX(),
+                            s.second.getExactY()) <= radius * radius)
+            out.push_back(s);
+    });
+}
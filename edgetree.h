@@ -0,0 +1,142 @@
+/**
+ * @file edgetree.h
+ * R-tree over the road segments of a graph, for range queries.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "csrgraph.h"
+#include "vertex.h"
+
+class Graph;
+
+using std::vector;
+
+/**
+ * A static R-tree over the segments of a graph's edges.
+ *
+ * The tree is bulk-loaded with Sort-Tile-Recursive packing: the segments
+ * are sorted by the x of their centers, cut into vertical slices, each
+ * slice sorted by y and cut into leaves of Capacity segments; the leaves
+ * are then packed the same way into the next level, up to a single root.
+ * Every node is full but the last of its level, and nodes of one level
+ * overlap little, so a query visits O(log n + k) nodes for k results.
+ *
+ * Each undirected edge is stored once. Vertices without edges are stored
+ * as segments of zero length, so a rectangle query also finds them.
+ *
+ * A tree never changes once built, so any number of threads may query it
+ * at the same time.
+ */
+class EdgeTree
+{
+  public:
+    /** Segments per node. */
+    static const unsigned Capacity = 16;
+
+    /** One edge, or one vertex without edges (first == second). */
+    struct Segment {
+        Vertex first;
+        Vertex second;
+    };
+
+    /** A node of the tree seen as a whole. */
+    struct Cell {
+        double minX, minY, maxX, maxY;  /**< bounds of its segments */
+        double length;                  /**< summed length of its segments */
+    };
+
+    /**
+     * Creates a tree of no segments.
+     */
+    EdgeTree();
+
+    /**
+     * Indexes the edges of a graph, from Graph::edges().
+     * @param g - the graph
+     */
+    explicit EdgeTree(const Graph& g);
+
+    /**
+     * Indexes the arcs of a snapshot; in an undirected one, each edge once.
+     * @param g - the snapshot
+     */
+    explicit EdgeTree(const CsrGraph& g);
+
+    /**
+     * Indexes the given segments.
+     * @param segments - the segments
+     */
+    explicit EdgeTree(vector<Segment> segments);
+
+    /** @return the number of segments indexed */
+    size_t size() const { return segments_.size(); }
+
+    /** @return every segment indexed, in no particular order */
+    const vector<Segment>& segments() const { return segments_; }
+
+    /** @return the bounds of every segment: min x, min y, max x, max y */
+    void bounds(double& minX, double& minY, double& maxX, double& maxY) const;
+
+    /**
+     * Finds the segments that intersect a rectangle, edges included.
+     * @param out - cleared and filled with the segments, in no particular
+     *  order
+     */
+    void inRectangle(double minX, double minY, double maxX, double maxY, vector<Segment>& out) const;
+
+    /**
+     * @return true, if any segment intersects a rectangle, edges
+     *  included; stops at the first one found
+     */
+    bool anyInRectangle(double minX, double minY, double maxX, double maxY) const;
+
+    /**
+     * Finds the segments that intersect a rectangle, as seen at a given
+     * resolution: a node of the tree narrower and shorter than resolution
+     * that whole() accepts is reported as one cell instead of its
+     * segments. A query over a dense network seen from afar then visits
+     * only the nodes above the cells, not every segment.
+     * @param resolution - the largest side of a cell; 0 for no cells
+     * @param whole - decides whether a small node is taken as a cell
+     * @param segments - cleared and filled with the segments outside cells
+     * @param cells - cleared and filled with the cells
+     */
+    void inRectangle(double minX, double minY, double maxX, double maxY, double resolution,
+                     const std::function<bool(const Cell&)>& whole, vector<Segment>& segments,
+                     vector<Cell>& cells) const;
+
+    /**
+     * Finds the segments that pass within radius of (x, y).
+     * @param out - cleared and filled with the segments, in no particular
+     *  order
+     */
+    void inRadius(double x, double y, double radius, vector<Segment>& out) const;
+
+  private:
+    /** A node: its bounding box and the range of its children. */
+    struct Node {
+        double minX, minY, maxX, maxY;
+        double length;      /**< summed length of the segments below */
+        uint32_t first;     /**< first child in the level below, or first segment */
+        uint32_t count;     /**< number of children */
+    };
+
+    vector<Segment> segments_;      /**< segments in leaf order */
+    vector<vector<Node>> levels_;   /**< levels_[0] are the leaves, the last is the root */
+
+    /** Packs segments_ and builds every level. */
+    void build();
+
+    /**
+     * Visits every segment whose box meets a query box and passes it to
+     * accept, which appends it to out if it really matches.
+     */
+    template <class Accept>
+    void query(double minX, double minY, double maxX, double maxY, Accept accept) const;
+};
@@ -1,128 +1,123 @@
 #include "graph.h"
 
+#include <cmath>
+
+#include "parallel.h"
+
 const Vertex Graph::InvalidVertex = Vertex(-1);
-const int Graph::InvalidWeight = INT_MIN;
+const double Graph::InvalidWeight = INT_MIN;
 const string Graph:: InvalidLabel = "_CS225INVALIDLABEL";
 const Edge Graph::InvalidEdge = Edge(Graph::InvalidVertex, Graph::InvalidVertex, Graph::InvalidWeight, Graph::InvalidLabel);
+const Graph::EdgeMap Graph::NoNeighbors;
+
+Graph::Graph(string connections_file, string vertices_file, bool weighted, unsigned threads) 
+    : weighted(weighted), directed(false), random(Random(0)), version(0) {
 
-Graph::Graph(string connections_file, string vertices_file, bool weighted) 
-    : weighted(weighted), directed(false), random(Random(0)) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
 
-    vector<Vertex> vertex_v = readVertexCSV(vertices_file);
+    // Files are parsed in parallel into per-thread buffers; the graph itself
+    // is only touched from this thread, in file order.
+    vector<Vertex> vertex_v = readVertexCSV(vertices_file, threads);
+    adjacency_list.reserve(vertex_v.size());
     for (Vertex v : vertex_v) {
         insertVertex(v);
     }
 
-    vector<Edge> edge_v = readConnectionsCSV(connections_file, vertex_v);
+    vector<Edge> edge_v = readConnectionsCSV(connections_file, vertex_v, threads);
     for (Edge e : edge_v) {
         insertEdge(e.source, e.dest);
         if (weighted) setEdgeWeight(e.source, e.dest, e.getWeight());
     }
 }
 
-vector<Vertex> Graph::readVertexCSV(string filename) {
-    string line;
-    vector<Vertex> result;
+vector<Vertex> Graph::readVertexCSV(string filename, unsigned threads) {
+    MappedFile file(filename);
 
-    ifstream file(filename);
-
-    if (!file) {
+    if (!file.isOpen()) {
         error("Vertex file does not exist at that address.");
         exit(1);
     }
 
-    while (getline(file, line)) {
-        size_t start;
-        size_t end = 0;
-        
-        int idx, x, y;
-        vector<string> out;
-        while ((start = line.find_first_not_of(',', end)) != std::string::npos) {
-            end = line.find(',', start);
-            out.push_back(line.substr(start, end - start));
-        }
+    size_t malformed = 0;
+    vector<Vertex> result = csv::parseParallel<VertexRecord>(
+        csv::skipBom(file.begin(), file.end()), file.end(), threads,
+        [](const VertexRecord& r) { return Vertex(r.index, r.x, r.y); }, &malformed);
 
-        if (out.size() != 3) cout << "no";
-
-        std::stringstream index(out[0]);
-        std::stringstream x_str(out[1]);
-        std::stringstream y_str(out[2]);
-
-        index >> idx;
-        y_str >> y;
-        x_str >> x;
-
-        Vertex v(idx, x, y);
-        result.push_back(v);
-    }
+    if (malformed != 0)
+        error("Skipped " + to_string(malformed) + " malformed lines in " + filename);
     return result;
 }
 
-vector<Edge> Graph::readConnectionsCSV(string filename, vector<Vertex> vertices) {
-    string line;
-    vector<Edge> result;
-
-    ifstream file(filename);
+vector<Edge> Graph::readConnectionsCSV(string filename, const vector<Vertex>& vertices, unsigned threads) {
+    MappedFile file(filename);
 
-    if (!file) {
+    if (!file.isOpen()) {
         error("Connections file does not exist at that address.");
         exit(1);
     }
 
-    while (getline(file, line)) {
-        size_t start;
-        size_t end = 0;
-        
-        int idx, v1, v2, w;
-        vector<string> out;
-        while ((start = line.find_first_not_of(',', end)) != std::string::npos) {
-            end = line.find(',', start);
-            out.push_back(line.substr(start, end - start));
+    // Resolve endpoints through an index -> slot table instead of scanning
+    // every vertex per edge. Dense indices (the usual case) use a flat
+    // vector; sparse ones fall back to a hash map.
+    int maxIndex = -1;
+    bool dense = true;
+    for (const Vertex& v : vertices) {
+        if (v.getIndex() < 0) dense = false;
+        maxIndex = std::max(maxIndex, v.getIndex());
+    }
+    dense = dense && (size_t) maxIndex < 2 * vertices.size() + 16;
+
+    vector<int> denseSlots;
+    unordered_map<int, size_t> sparseSlots;
+    if (dense) {
+        denseSlots.assign(maxIndex + 1, -1);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            denseSlots[vertices[i].getIndex()] = (int) i;
         }
-
-        if (out.size() != 4) cout << "no";
-
-        std::stringstream index(out[0]);
-        std::stringstream v1_str(out[1]);
-        std::stringstream v2_str(out[2]);
-        std::stringstream weight(out[3]);
-
-        index >> idx;
-        v1_str >> v1;
-        v2_str >> v2;
-        weight >> w;
-
-        Vertex one(-1);
-        Vertex two(-1);
-
-        for (Vertex v : vertices) {
-            if (v.getIndex() == v1) {
-                one = v;
-            } else if (v.getIndex() == v2) {
-                two = v;
-            }
-
-            if (one.getIndex() != -1 && two.getIndex() != -1) break;
+    } else {
+        sparseSlots.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            sparseSlots[vertices[i].getIndex()] = i;
         }
-
-        Edge e(one, two, w, "");
-        result.push_back(e);
     }
+
+    auto lookup = [&](int index) -> Vertex {
+        if (dense) {
+            if (index >= 0 && index <= maxIndex && denseSlots[index] != -1)
+                return vertices[denseSlots[index]];
+        } else {
+            auto it = sparseSlots.find(index);
+            if (it != sparseSlots.end())
+                return vertices[it->second];
+        }
+        return Vertex(-1);
+    };
+
+    // lookup only reads the index tables, so the threads can share it
+    size_t malformed = 0;
+    vector<Edge> result = csv::parseParallel<ConnectionRecord>(
+        csv::skipBom(file.begin(), file.end()), file.end(), threads,
+        [&](const ConnectionRecord& r) { return Edge(lookup(r.first), lookup(r.second), r.weight, ""); },
+        &malformed);
+
+    if (malformed != 0)
+        error("Skipped " + to_string(malformed) + " malformed lines in " + filename);
     return result;
 }
 
-Graph::Graph(bool weighted) : weighted(weighted),directed(false),random(Random(0))
+Graph::Graph(bool weighted) : weighted(weighted),directed(false),random(Random(0)),version(0)
 {
 }
 
-Graph::Graph(bool weighted, bool directed) : weighted(weighted),directed(directed),random(Random(0))
+Graph::Graph(bool weighted, bool directed) : weighted(weighted),directed(directed),random(Random(0)),version(0)
 {
 }
 
 Graph::Graph(bool weighted, int numVertices, unsigned long seed)
     :weighted(weighted),
       directed(false),
-     random(Random(seed)) 
+     random(Random(seed)),
+     version(0)
 {
     if (numVertices < 2)
     {
@@ -181,47 +176,44 @@ Graph::Graph(bool weighted, int numVertices, unsigned long seed)
 
 vector<Vertex> Graph::getAdjacent(Vertex source) const 
 {
-    auto lookup = adjacency_list.find(source);
-
-    if(lookup == adjacency_list.end())
-        return vector<Vertex>();
-	
-     else
+    vector<Vertex> vertex_list;
+    for (const auto& neighbor : neighbors(source))
     {
-        vector<Vertex> vertex_list;
-        const unordered_map <Vertex, Edge> & map = adjacency_list[source];
-        for (auto it = map.begin(); it != map.end(); it++)
-        {
-            vertex_list.push_back(it->first);
-        }
-        return vertex_list;
+        vertex_list.push_back(neighbor.first);
     }
+    return vertex_list;
 }
 
+Graph::Range<Graph::EdgeMap::const_iterator> Graph::neighbors(Vertex source) const
+{
+    auto lookup = adjacency_list.find(source);
+    const EdgeMap& map = lookup == adjacency_list.end() ? NoNeighbors : lookup->second;
+    return Range<EdgeMap::const_iterator>(map.begin(), map.end());
+}
 
 Vertex Graph::getStartingVertex() const
 {
+    if (adjacency_list.empty())
+        return InvalidVertex;
     return adjacency_list.begin()->first;
 }
 
 vector<Vertex> Graph::getVertices() const
 {
-    vector<Vertex> ret;
-
-    for(auto it = adjacency_list.begin(); it != adjacency_list.end(); it++)
-    {
-        ret.push_back(it->first);
-    }
+    Range<VertexIterator> range = vertices();
+    return vector<Vertex>(range.begin(), range.end());
+}
 
-    return ret;
+Graph::Range<Graph::VertexIterator> Graph::vertices() const
+{
+    return Range<VertexIterator>(adjacency_list.begin(), adjacency_list.end());
 }
 
 Edge Graph::getEdge(Vertex source , Vertex destination) const
 {
     if(assertEdgeExists(source, destination, __func__) == false)
         return Edge();
-    Edge ret = adjacency_list[source][destination];
-    return ret;
+    return *findEdge(source, destination);
 }
 
 vector<Edge> Graph::getEdges() const
@@ -235,7 +227,7 @@ vector<Edge> Graph::getEdges() const
     for (auto it = adjacency_list.begin(); it != adjacency_list.end(); it++)
     {
         Vertex source = it->first;
-        for (auto its = adjacency_list[source].begin(); its != adjacency_list[source].end(); its++)
+        for (auto its = it->second.begin(); its != it->second.end(); its++)
         {
             Vertex destination = its->first;
             if(seen.find(make_pair(source, destination)) == seen.end())
@@ -254,6 +246,56 @@ vector<Edge> Graph::getEdges() const
     return ret;
 }
 
+Graph::Range<Graph::EdgeIterator> Graph::edges() const
+{
+    return Range<EdgeIterator>(EdgeIterator(adjacency_list.begin(), adjacency_list.end(), directed),
+                               EdgeIterator(adjacency_list.end(), adjacency_list.end(), directed));
+}
+
+Graph::EdgeIterator::EdgeIterator(unordered_map<Vertex, EdgeMap>::const_iterator vertex,
+                                  unordered_map<Vertex, EdgeMap>::const_iterator last, bool directed)
+    : vertex(vertex), last(last), directed(directed)
+{
+    if (vertex != last)
+        edge = vertex->second.begin();
+    skip();
+}
+
+Graph::EdgeIterator& Graph::EdgeIterator::operator++()
+{
+    ++edge;
+    skip();
+    return *this;
+}
+
+bool Graph::EdgeIterator::operator==(const EdgeIterator& other) const
+{
+    if (vertex == last || other.vertex == other.last)
+        return vertex == last && other.vertex == other.last;
+    return vertex == other.vertex && edge == other.edge;
+}
+
+void Graph::EdgeIterator::skip()
+{
+    while (vertex != last)
+    {
+        if (edge == vertex->second.end())
+        {
+            if (++vertex != last)
+                edge = vertex->second.begin();
+        }
+        else if (!directed && edge->first < vertex->first)
+        {
+            // visited from the other end
+            ++edge;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
 bool Graph::vertexExists(Vertex v) const
 {
     return assertVertexExists(v, "");
@@ -271,6 +313,7 @@ Edge Graph::setEdgeLabel(Vertex source, Vertex destination, string label)
     Edge e = adjacency_list[source][destination];
     Edge new_edge(source, destination, e.getWeight(), label);
     adjacency_list[source][destination] = new_edge;
+    version++;
 
     if(!directed)
     {
@@ -285,17 +328,17 @@ string Graph::getEdgeLabel(Vertex source, Vertex destination) const
 {
     if(assertEdgeExists(source, destination, __func__) == false)
         return InvalidLabel;
-    return adjacency_list[source][destination].getLabel();
+    return findEdge(source, destination)->getLabel();
 }
 
-int Graph::getEdgeWeight(Vertex source, Vertex destination) const
+double Graph::getEdgeWeight(Vertex source, Vertex destination) const
 {
     if (!weighted)
         error("can't get edge weights on non-weighted graphs!");
 
     if(assertEdgeExists(source, destination, __func__) == false)
         return InvalidWeight;
-    return adjacency_list[source][destination].getWeight();
+    return findEdge(source, destination)->getWeight();
 }
 
 void Graph::insertVertex(Vertex v)
@@ -304,6 +347,7 @@ void Graph::insertVertex(Vertex v)
     removeVertex(v);
     // make it empty again
     adjacency_list[v] = unordered_map<Vertex, Edge>();
+    version++;
 }
 
 
@@ -312,6 +356,7 @@ Vertex Graph::removeVertex(Vertex v)
 
     if (adjacency_list.find(v) != adjacency_list.end())
     {
+        version++;
         if(!directed){
             for (auto it = adjacency_list[v].begin(); it != adjacency_list[v].end(); it++)
             {
@@ -352,6 +397,7 @@ bool Graph::insertEdge(Vertex source, Vertex destination)
     }
         //source vertex exists
     adjacency_list[source][destination] = Edge(source, destination);
+    version++;
     if(!directed)
     {
         if(adjacency_list.find(destination)== adjacency_list.end())
@@ -370,6 +416,7 @@ Edge Graph::removeEdge(Vertex source, Vertex destination)
         return InvalidEdge;
     Edge e = adjacency_list[source][destination];
     adjacency_list[source].erase(destination);
+    version++;
     // if undirected, remove the corresponding edge
     if(!directed)
     {
@@ -387,6 +434,7 @@ Edge Graph::setEdgeWeight(Vertex source, Vertex destination, double weight)
     //std::cout << "setting weight: " << weight << std::endl;
     Edge new_edge(source, destination, weight, e.getLabel());
     adjacency_list[source][destination] = new_edge;
+    version++;
 
     if(!directed)
         {
@@ -412,7 +460,7 @@ bool Graph::assertEdgeExists(Vertex source, Vertex destination, string functionN
 {
     if(assertVertexExists(source,functionName) == false)
         return false;
-    if(adjacency_list[source].find(destination)== adjacency_list[source].end())
+    if(findEdge(source, destination) == NULL)
     {
         if (functionName != "")
             error(functionName + " called on nonexistent edge " + to_string(source.getIndex()) + " -> " + to_string(destination.getIndex()));
@@ -423,7 +471,7 @@ bool Graph::assertEdgeExists(Vertex source, Vertex destination, string functionN
     {
         if (assertVertexExists(destination,functionName) == false)
             return false;
-        if(adjacency_list[destination].find(source)== adjacency_list[destination].end())
+        if(findEdge(destination, source) == NULL)
         {
             if (functionName != "")
                 error(functionName + " called on nonexistent edge " + to_string(destination.getIndex()) + " -> " + to_string(source.getIndex()));
@@ -433,6 +481,17 @@ bool Graph::assertEdgeExists(Vertex source, Vertex destination, string functionN
     return true;
 }
 
+const Edge* Graph::findEdge(Vertex source, Vertex destination) const
+{
+    auto lookup = adjacency_list.find(source);
+    if (lookup == adjacency_list.end())
+        return NULL;
+    auto edge = lookup->second.find(destination);
+    if (edge == lookup->second.end())
+        return NULL;
+    return &edge->second;
+}
+
 bool Graph::isDirected() const
 {
     return directed;
@@ -441,6 +500,12 @@ bool Graph::isDirected() const
 void Graph::clear()
 {
     adjacency_list.clear();
+    version++;
+}
+
+unsigned long Graph::getVersion() const
+{
+    return version;
 }
 
 
@@ -454,6 +519,49 @@ void Graph::error(string message) const
     cerr << "\033[1;31m[Graph Error]\033[0m " + message << endl;
 }
 
+CsrGraph Graph::freeze() const
+{
+    vector<uint32_t> offsets(1, 0);
+    vector<CsrGraph::VertexId> targets;
+    vector<double> weights;
+    vector<double> coords;
+    vector<int> indices;
+
+    unordered_map<Vertex, CsrGraph::VertexId> ids;
+    ids.reserve(adjacency_list.size());
+    indices.reserve(adjacency_list.size());
+    coords.reserve(2 * adjacency_list.size());
+    offsets.reserve(adjacency_list.size() + 1);
+
+    auto addVertex = [&](const Vertex& v) {
+        ids[v] = (CsrGraph::VertexId) indices.size();
+        indices.push_back(v.getIndex());
+        coords.push_back(v.getExactX());
+        coords.push_back(v.getExactY());
+    };
+
+    for (auto it = adjacency_list.begin(); it != adjacency_list.end(); ++it)
+        addVertex(it->first);
+
+    for (auto it = adjacency_list.begin(); it != adjacency_list.end(); ++it)
+    {
+        for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+        {
+            // in a directed graph the destination may have no entry of its own
+            if (ids.find(it2->first) == ids.end())
+                addVertex(it2->first);
+            targets.push_back(ids[it2->first]);
+            weights.push_back(weighted ? it2->second.getWeight() : 1);
+        }
+        offsets.push_back((uint32_t) targets.size());
+    }
+    while (offsets.size() < indices.size() + 1)
+        offsets.push_back((uint32_t) targets.size());
+
+    return CsrGraph(weighted, directed, std::move(offsets), std::move(targets), std::move(weights),
+                    std::move(coords), std::move(indices));
+}
+
 /**
  * Creates a name for snapshots of the graph.
  * @param title - the name to save the snapshots as
@@ -489,125 +597,365 @@ void Graph::print() const
     }
 }
 
-/** 
- * Render graph onto png of map
- */
-cs225::PNG Graph::render(Graph g, cs225::PNG png) const {
-
-    vector<Vertex> vertices = g.getVertices();
+namespace {
 
-    cs225::HSLAPixel black = cs225::HSLAPixel(226, 1, 0, 1);
-    cs225::HSLAPixel pink = cs225::HSLAPixel(328, 1, 0.76, 1);
-    
-    for (Vertex v : vertices) {
-        // get the x and y
-        vector<Vertex> adjacent = g.getAdjacent(v);
-        for (Vertex a : adjacent) {
-            // compute slope
+    /** @return floor(a / b) for b > 0 */
+    long floorDiv(long a, long b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
 
-            drawPathHelper(png, black, v, a, 10);
+    /**
+     * Draws a line size pixels thick: a size x size square stamped at
+     * every step along the major axis, with its top left corner on the
+     * line.
+     *
+     * Each pixel is written once. For every column (or row, if the line
+     * is steep) the stamps that cover it form one span, because the corner
+     * moves monotonically and by at most one pixel per step, so the span
+     * runs from the corner of the first stamp over it to the corner of the
+     * last plus size. Corners are found with integer arithmetic and the
+     * spans are clipped against [clipX0, clipX1) x [clipY0, clipY1), which
+     * must lie inside the image, before any pixel is touched.
+     */
+    template <class Image>
+    void drawSpans(Image& png, const typename Image::Pixel& color, Vertex first, Vertex second, double size,
+                   long clipX0, long clipY0, long clipX1, long clipY1) {
+        long pen = (long) std::ceil(size);
+        if (pen <= 0 || clipX0 >= clipX1 || clipY0 >= clipY1) return;
+
+        long x0 = first.getX(), y0 = first.getY(), x1 = second.getX(), y1 = second.getY();
+        bool xMajor = std::abs(x1 - x0) > std::abs(y1 - y0);
+        long major0 = xMajor ? x0 : y0, minor0 = xMajor ? y0 : x0;
+        long major1 = xMajor ? x1 : y1, minor1 = xMajor ? y1 : x1;
+        if (major1 < major0) {
+            std::swap(major0, major1);
+            std::swap(minor0, minor1);
+        }
+        long length = major1 - major0;
+        long rise = minor1 - minor0;
+
+        // corner of the stamp k steps from the start, on the minor axis
+        auto corner = [&](long k) {
+            return length == 0 ? minor0 : minor0 + floorDiv(rise * k, length);
+        };
+
+        long width = png.width();
+        long majorFirst = xMajor ? clipX0 : clipY0, majorLimit = xMajor ? clipX1 : clipY1;
+        long minorFirst = xMajor ? clipY0 : clipX0, minorLimit = xMajor ? clipY1 : clipX1;
+        long begin = std::max(major0, majorFirst), end = std::min(major1 + pen, majorLimit);
+        for (long m = begin; m < end; m++) {
+            long a = corner(std::max(0L, m - pen + 1 - major0));
+            long b = corner(std::min(length, m - major0));
+            long lo = std::max(std::min(a, b), minorFirst), hi = std::min(std::max(a, b) + pen, minorLimit);
+            if (lo >= hi) continue;
+            if (xMajor) {
+                typename Image::Pixel* pixel = &png.getPixel(m, lo);
+                for (long r = lo; r < hi; r++, pixel += width) *pixel = color;
+            } else {
+                typename Image::Pixel* row = &png.getPixel(lo, m);
+                std::fill(row, row + (hi - lo), color);
+            }
         }
     }
-    for (Vertex v : vertices) {
-        double x_coor = v.getX();
-        double y_coor = v.getY();
-        // set the color of the correlating pixel (of the png) to pink
-        for (int i = 0; i <= 10; i++) {
-            for (int j = 0; j <= 10; j++) {
-                cs225::HSLAPixel& pixel = png.getPixel(x_coor + i, y_coor + j);
-                pixel = pink;
+
+    /** Pixels on a side of the tiles a render is split into. */
+    const long TileSize = 256;
+
+    /**
+     * Renders the part of a map that options put on png, drawing only the
+     * segments of the tree near the image.
+     *
+     * Segments are mapped to pixels first. Those shorter than
+     * options.minLength become dots, nodes of the tree smaller than
+     * options.cellSize that their edges cover become filled boxes, and
+     * dots and vertex markers are kept once per pixel, so many tiny edges
+     * cost one dot.
+     *
+     * The image is then cut into tiles, and every line, box, dot and marker
+     * is binned into the tiles its pixels fall in. Each thread draws whole
+     * tiles, clipped to the tile, so no two threads write the same pixel
+     * and none need a lock; on one thread, the tile being drawn stays in
+     * cache. A pixel ends up pink if a marker covers it, else black if a
+     * line, box or dot does, whatever order the tiles run in, so the image
+     * is the same for any number of threads.
+     */
+    template <class Image>
+    void renderView(const EdgeTree& tree, Image& png, const Graph::RenderOptions& options) {
+        typename Image::Pixel black = cs225::HSLAPixel(226, 1, 0, 1);
+        typename Image::Pixel pink = cs225::HSLAPixel(328, 1, 0.76, 1);
+        const long pen = std::max(1L, std::lround(options.pen));
+        const long marker = std::max(0L, std::lround(options.marker));
+        const double scale = options.scale;
+        long width = png.width(), height = png.height();
+        if (width == 0 || height == 0 || !(scale > 0)) return;
+
+        // lines, dots and markers extend right of and below their points
+        const long reach = std::max(pen, marker);
+        // a small node is drawn whole if its edges are long enough to cover
+        // the pixels of its box with the pen
+        auto covered = [&](const EdgeTree::Cell& cell) {
+            double pixelsX = (cell.maxX - cell.minX) * scale + 1, pixelsY = (cell.maxY - cell.minY) * scale + 1;
+            return cell.length * scale * pen >= pixelsX * pixelsY;
+        };
+        vector<EdgeTree::Segment> visible;
+        vector<EdgeTree::Cell> cells;
+        tree.inRectangle(options.originX - reach / scale, options.originY - reach / scale,
+                         options.originX + width / scale, options.originY + height / scale,
+                         options.cellSize / scale, covered, visible, cells);
+
+        auto toPixel = [&](const Vertex& v) {
+            return Vertex(v.getIndex(), std::floor((v.getExactX() - options.originX) * scale),
+                          std::floor((v.getExactY() - options.originY) * scale));
+        };
+        // dots and markers, once per pixel they start at
+        long spanX = width + reach, spanY = height + reach;
+        vector<bool> dotted(spanX * spanY), marked(marker > 0 ? spanX * spanY : 0);
+        auto once = [&](vector<bool>& seen, vector<Vertex>& out, const Vertex& p) {
+            long x = p.getX() + reach, y = p.getY() + reach;
+            if (x < 0 || y < 0 || x >= spanX || y >= spanY || seen[y * spanX + x]) return;
+            seen[y * spanX + x] = true;
+            out.push_back(p);
+        };
+        vector<EdgeTree::Segment> lines, boxes;
+        vector<Vertex> dots, ends;
+        for (const EdgeTree::Cell& cell : cells) {
+            boxes.push_back(EdgeTree::Segment{toPixel(Vertex(-1, cell.minX, cell.minY)),
+                                              toPixel(Vertex(-1, cell.maxX, cell.maxY))});
+        }
+        for (const EdgeTree::Segment& segment : visible) {
+            Vertex a = toPixel(segment.first), b = toPixel(segment.second);
+            long dx = b.getX() - a.getX(), dy = b.getY() - a.getY();
+            if ((dx == 0 && dy == 0) || std::hypot((double) dx, (double) dy) < options.minLength) {
+                once(dotted, dots, a);
+            } else {
+                lines.push_back(EdgeTree::Segment{a, b});
             }
+            if (marker > 0) {
+                once(marked, ends, a);
+                once(marked, ends, b);
+            }
+        }
+
+        unsigned threads = options.threads;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        long tilesX = (width + TileSize - 1) / TileSize, tilesY = (height + TileSize - 1) / TileSize;
+
+        // what is drawn on each tile, as indices into lines, boxes, dots and ends
+        struct Bin {
+            vector<uint32_t> lines, boxes, dots, ends;
+        };
+        vector<Bin> bins(tilesX * tilesY);
+        auto bin = [&](long x0, long y0, long x1, long y1, vector<uint32_t> Bin::*list, size_t item) {
+            x0 = std::max(x0, 0L);
+            y0 = std::max(y0, 0L);
+            x1 = std::min(x1, width - 1);
+            y1 = std::min(y1, height - 1);
+            if (x0 > x1 || y0 > y1) return;
+            for (long ty = y0 / TileSize; ty <= y1 / TileSize; ty++) {
+                for (long tx = x0 / TileSize; tx <= x1 / TileSize; tx++) {
+                    (bins[ty * tilesX + tx].*list).push_back((uint32_t) item);
+                }
+            }
+        };
+        for (size_t i = 0; i < lines.size(); i++) {
+            const Vertex& a = lines[i].first;
+            const Vertex& b = lines[i].second;
+            bin(std::min(a.getX(), b.getX()), std::min(a.getY(), b.getY()),
+                std::max(a.getX(), b.getX()) + pen - 1, std::max(a.getY(), b.getY()) + pen - 1, &Bin::lines, i);
+        }
+        for (size_t i = 0; i < boxes.size(); i++) {
+            bin(boxes[i].first.getX(), boxes[i].first.getY(), boxes[i].second.getX() + pen - 1,
+                boxes[i].second.getY() + pen - 1, &Bin::boxes, i);
+        }
+        for (size_t i = 0; i < dots.size(); i++) {
+            bin(dots[i].getX(), dots[i].getY(), dots[i].getX() + pen - 1, dots[i].getY() + pen - 1, &Bin::dots, i);
+        }
+        for (size_t i = 0; i < ends.size(); i++) {
+            bin(ends[i].getX(), ends[i].getY(), ends[i].getX() + marker - 1, ends[i].getY() + marker - 1,
+                &Bin::ends, i);
         }
+
+        parallelFor(bins.size(), threads, [&](size_t t, unsigned) {
+            long clipX0 = (t % tilesX) * TileSize, clipY0 = (t / tilesX) * TileSize;
+            long clipX1 = std::min(clipX0 + TileSize, width), clipY1 = std::min(clipY0 + TileSize, height);
+            // fills [x0, x1) x [y0, y1), clipped to the tile
+            auto fill = [&](long x0, long y0, long x1, long y1, const typename Image::Pixel& color) {
+                x0 = std::max(x0, clipX0);
+                x1 = std::min(x1, clipX1);
+                y1 = std::min(y1, clipY1);
+                for (long y = std::max(y0, clipY0); x0 < x1 && y < y1; y++) {
+                    typename Image::Pixel* row = &png.getPixel(x0, y);
+                    std::fill(row, row + (x1 - x0), color);
+                }
+            };
+            const Bin& tile = bins[t];
+            for (uint32_t i : tile.lines) {
+                drawSpans(png, black, lines[i].first, lines[i].second, pen, clipX0, clipY0, clipX1, clipY1);
+            }
+            for (uint32_t i : tile.boxes) {
+                const EdgeTree::Segment& box = boxes[i];
+                fill(box.first.getX(), box.first.getY(), box.second.getX() + pen, box.second.getY() + pen, black);
+            }
+            for (uint32_t i : tile.dots) {
+                fill(dots[i].getX(), dots[i].getY(), dots[i].getX() + pen, dots[i].getY() + pen, black);
+            }
+            // markers on top of every line
+            for (uint32_t i : tile.ends) {
+                fill(ends[i].getX(), ends[i].getY(), ends[i].getX() + marker, ends[i].getY() + marker, pink);
+            }
+        }, 1);
     }
+}
+
+/** 
+ * Render graph onto png of map
+ */
+cs225::PNG Graph::render(const Graph& g, cs225::PNG png) const {
+    renderInto(g, png);
+    return png;
+}
+
+cs225::RGBAPNG Graph::render(const Graph& g, cs225::RGBAPNG png) const {
+    renderInto(g, png);
+    return png;
+}
+
+/** 
+ * Render a graph snapshot onto png of map
+ */
+cs225::PNG Graph::render(const CsrGraph& g, cs225::PNG png) {
+    renderInto(g, png);
+    return png;
+}
+
+cs225::RGBAPNG Graph::render(const CsrGraph& g, cs225::RGBAPNG png) {
+    renderInto(g, png);
+    return png;
+}
+
+/**
+ * Renders the part of a map that falls on png, drawing only the segments
+ * of the tree near the image.
+ */
+cs225::PNG Graph::render(const EdgeTree& tree, cs225::PNG png, int originX, int originY, unsigned threads) {
+    RenderOptions options;
+    options.originX = originX;
+    options.originY = originY;
+    options.threads = threads;
+    renderView(tree, png, options);
+    return png;
+}
+
+cs225::RGBAPNG Graph::render(const EdgeTree& tree, cs225::RGBAPNG png, int originX, int originY,
+                              unsigned threads) {
+    RenderOptions options;
+    options.originX = originX;
+    options.originY = originY;
+    options.threads = threads;
+    renderView(tree, png, options);
     return png;
 }
 
+/**
+ * Renders the part of a map that options put on png, at any scale.
+ */
+cs225::PNG Graph::render(const EdgeTree& tree, cs225::PNG png, const RenderOptions& options) {
+    renderView(tree, png, options);
+    return png;
+}
+
+cs225::RGBAPNG Graph::render(const EdgeTree& tree, cs225::RGBAPNG png, const RenderOptions& options) {
+    renderView(tree, png, options);
+    return png;
+}
+
+/**
+ * Renders a map onto png itself.
+ */
+void Graph::renderInto(const Graph& g, cs225::PNG& png) {
+    renderView(EdgeTree(g), png, RenderOptions());
+}
+
+void Graph::renderInto(const Graph& g, cs225::RGBAPNG& png) {
+    renderView(EdgeTree(g), png, RenderOptions());
+}
+
+void Graph::renderInto(const CsrGraph& g, cs225::PNG& png) {
+    renderView(EdgeTree(g), png, RenderOptions());
+}
+
+void Graph::renderInto(const CsrGraph& g, cs225::RGBAPNG& png) {
+    renderView(EdgeTree(g), png, RenderOptions());
+}
+
+void Graph::renderInto(const EdgeTree& tree, cs225::PNG& png, const RenderOptions& options) {
+    renderView(tree, png, options);
+}
+
+void Graph::renderInto(const EdgeTree& tree, cs225::RGBAPNG& png, const RenderOptions& options) {
+    renderView(tree, png, options);
+}
+
+/**
+ * The markers are squares one pixel wider than the lines, as the map
+ * has always been drawn.
+ */
+Graph::RenderOptions::RenderOptions()
+    : scale(1), originX(0), originY(0), pen(10), marker(11), minLength(0), cellSize(0), threads(0)
+{
+}
+
+/**
+ * Picks the scale that fits the larger side of the network's bounds,
+ * leaving room for the pen at the right and bottom.
+ */
+Graph::RenderOptions Graph::RenderOptions::fit(const EdgeTree& tree, unsigned width, unsigned height) {
+    RenderOptions options;
+    options.pen = 1;
+    options.marker = 0;
+    options.minLength = 1;
+    options.cellSize = 64;
+    double minX, minY, maxX, maxY;
+    tree.bounds(minX, minY, maxX, maxY);
+    double usableX = std::max(1.0, width - options.pen), usableY = std::max(1.0, height - options.pen);
+    double spanX = maxX - minX, spanY = maxY - minY;
+    if (spanX > 0 || spanY > 0) {
+        options.scale = std::min(spanX > 0 ? usableX / spanX : INFINITY, spanY > 0 ? usableY / spanY : INFINITY);
+    }
+    options.originX = minX - (usableX / options.scale - spanX) / 2;
+    options.originY = minY - (usableY / options.scale - spanY) / 2;
+    return options;
+}
+
+/**
+ * Draws a line size pixels thick, one span per column or row.
+ */
 void Graph::drawPathHelper(cs225::PNG& png, cs225::HSLAPixel color, Vertex first, Vertex second, double size) {
-	double dx, dy, startX, endX, startY, endY;
-		
-	if (std::abs(first.getX() - second.getX()) > std::abs(first.getY() - second.getY())) {
-		if (second.getY() > first.getY()) {
-			dy = second.getY() - first.getY();
-		} else {
-			dy = first.getY() - second.getY();
-		}
-
-		if (second.getX() > first.getX()) {
-			dx = second.getX() - first.getX();
-			startX = first.getX();
-			startY = first.getY();
-			endX = second.getX();
-			endY = second.getY();
-		} else {
-			dx = first.getX() - second.getX();
-			startX = second.getX();
-			startY = second.getY();
-			endX = first.getX();
-			endY = first.getY();
-		}
-	} else {
-		if (second.getX() > first.getX()) {
-			dx = second.getX() - first.getX();
-		} else {
-			dx = first.getX() - second.getX();
-		}
-
-		if (second.getY() > first.getY()) {
-			dy = second.getY() - first.getY();
-			startX = first.getX();
-			startY = first.getY();
-			endX = second.getX();
-			endY = second.getY();
-		} else {
-			dy = first.getY() - second.getY();
-			startX = second.getX();
-			startY = second.getY();
-			endX = first.getX();
-			endY = first.getY();
-		}
-	}
-
-	if (dx > dy) {
-		for (double x = startX; x <= endX; x++) {
-			double y;
-			if (startY < endY) {
-				y = startY + dy * (x - startX) / dx;
-			} else {
-				y = startY - dy * (x - startX) / dx;
-			}
-		
-			for (double i = 0; i < size; i++) {
-				for (double j = 0; j < size; j++) {
-					if (x + i >= png.width()) break;
-					if (y + j >= png.height()) break;
-
-					// access every y associated with every x to get every pixel
-					cs225::HSLAPixel& pixel = png.getPixel(x + i, y + j);
-					// change color
-					pixel = color;
-				}
-			}
-		}
-	} else {
-		for (double y = startY; y <= endY; y++) {
-			double x;
-			if (startX < endX) {
-				x = startX + dx * (y - startY) / dy;
-			} else {
-				x = startX - dx * (y - startY) / dy;
-			}
-	
-			for (double i = 0; i < size; i++) {
-				for (double j = 0; j < size; j++) {
-					if (x + i >= png.width()) break;
-					if (y + j >= png.height()) break;
-
-					// access every y associated with every x to get every pixel
-					cs225::HSLAPixel& pixel = png.getPixel(x + i, y + j);
-					// change color
-					pixel = color;
-				}
-			}
-		}
-	}
+    drawSpans(png, color, first, second, size, 0, 0, png.width(), png.height());
+}
+
+void Graph::drawPathHelper(cs225::RGBAPNG& png, cs225::RGBAPixel color, Vertex first, Vertex second, double size) {
+    drawSpans(png, color, first, second, size, 0, 0, png.width(), png.height());
+}
+
+void Graph::drawPathStamped(cs225::PNG& png, cs225::HSLAPixel color, Vertex first, Vertex second, double size) {
+    double dx = std::abs(first.getX() - second.getX()), dy = std::abs(first.getY() - second.getY());
+    bool xMajor = dx > dy;
+    bool forward = xMajor ? second.getX() > first.getX() : second.getY() > first.getY();
+    double startX = forward ? first.getX() : second.getX(), startY = forward ? first.getY() : second.getY();
+    double endX = forward ? second.getX() : first.getX(), endY = forward ? second.getY() : first.getY();
+    double from = xMajor ? startX : startY, to = xMajor ? endX : endY;
+    for (double m = from; m <= to; m++) {
+        double x = m, y = m;
+        if (xMajor) y = startY < endY ? startY + dy * (m - startX) / dx : startY - dy * (m - startX) / dx;
+        else x = startX < endX ? startX + dx * (m - startY) / dy : startX - dx * (m - startY) / dy;
+        for (double i = 0; i < size; i++) {
+            for (double j = 0; j < size; j++) {
+                if (x + i >= png.width()) break;
+                if (y + j >= png.height()) break;
+                if (x + i < 0 || y + j < 0) continue;
+                png.getPixel(x + i, y + j) = color;
+            }
+        }
+    }
 }
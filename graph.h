@@ -30,10 +30,15 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "csrgraph.h"
+#include "csvparser.h"
+#include "edgetree.h"
 #include "edge.h"
 #include "random.h"
 #include "vertex.h"
@@ -53,17 +58,126 @@ using std::unordered_map;
 using std::ifstream;
 
 #include "cs225/PNG.h"
+#include "cs225/RGBAPNG.h"
 #include "cs225/HSLAPixel.h"
 
 
 /**
  * Represents a graph; used by the GraphTools class.
  *
+ * Const methods never modify the graph, so any number of threads may call
+ * them at the same time, for example from separate Search instances. A
+ * thread that modifies the graph must not run alongside any other user of
+ * it; to keep answering queries while one thread edits, give the readers
+ * a snapshot from freeze() and hand them a new one after the edits.
  */
 class Graph
 {
 public:
 
+    /** Edges leaving one vertex, keyed by the vertex they lead to. */
+    typedef unordered_map<Vertex, Edge> EdgeMap;
+
+    /**
+     * A pair of iterators that a range-based for loop can walk. The graph
+     * must not be modified while one is in use.
+     */
+    template <class Iterator>
+    class Range
+    {
+    public:
+        Range(Iterator first, Iterator last) : first(first), last(last) {}
+        Iterator begin() const { return first; }
+        Iterator end() const { return last; }
+        bool empty() const { return !(first != last); }
+        size_t size() const { return std::distance(first, last); }
+
+    private:
+        Iterator first;
+        Iterator last;
+    };
+
+    /** Walks the vertices of the graph in place. */
+    class VertexIterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Vertex value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Vertex* pointer;
+        typedef const Vertex& reference;
+
+        VertexIterator(unordered_map<Vertex, EdgeMap>::const_iterator it) : it(it) {}
+        const Vertex& operator*() const { return it->first; }
+        const Vertex* operator->() const { return &it->first; }
+        VertexIterator& operator++() { ++it; return *this; }
+        bool operator==(const VertexIterator& other) const { return it == other.it; }
+        bool operator!=(const VertexIterator& other) const { return it != other.it; }
+
+    private:
+        unordered_map<Vertex, EdgeMap>::const_iterator it;
+    };
+
+    /**
+     * Walks the edges of the graph in place. An undirected edge is stored
+     * at both of its ends and is visited once, from the end that is not
+     * greater than the other.
+     */
+    class EdgeIterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Edge value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Edge* pointer;
+        typedef const Edge& reference;
+
+        EdgeIterator(unordered_map<Vertex, EdgeMap>::const_iterator vertex,
+                     unordered_map<Vertex, EdgeMap>::const_iterator last, bool directed);
+        const Edge& operator*() const { return edge->second; }
+        const Edge* operator->() const { return &edge->second; }
+        EdgeIterator& operator++();
+        bool operator==(const EdgeIterator& other) const;
+        bool operator!=(const EdgeIterator& other) const { return !(*this == other); }
+
+    private:
+        unordered_map<Vertex, EdgeMap>::const_iterator vertex;
+        unordered_map<Vertex, EdgeMap>::const_iterator last;
+        EdgeMap::const_iterator edge;
+        bool directed;
+
+        /** Moves forward until edge is one to visit or the walk is over. */
+        void skip();
+    };
+
+    /**
+     * How render() maps the map onto an image. The defaults draw one map
+     * unit per pixel with 10 pixel lines, as render(tree, png) does.
+     */
+    struct RenderOptions
+    {
+        double scale;       /**< pixels per map unit */
+        double originX;     /**< map x at the left edge of the image */
+        double originY;     /**< map y at the top edge of the image */
+        double pen;         /**< width of lines, in pixels */
+        double marker;      /**< side of the square on each vertex, in pixels; 0 for none */
+        double minLength;   /**< edges shorter than this many pixels are drawn as a dot */
+        double cellSize;    /**< dense parts of the network smaller than this many pixels are filled */
+        unsigned threads;   /**< threads drawing tiles of the image; 0 for one per core */
+
+        RenderOptions();
+
+        /**
+         * Fits a whole network into an image, centered, with 1 pixel lines,
+         * no markers, edges shorter than a pixel merged into dots, and
+         * dense parts smaller than 64 pixels filled.
+         * @param tree - the edges of the network
+         * @param width - width of the image
+         * @param height - height of the image
+         */
+        static RenderOptions fit(const EdgeTree& tree, unsigned width, unsigned height);
+    };
+
     /**
      * Constructor to create a graph from a CSV file of vertices 
      * (index, x coordinate, y coordinate), and a CSV file of connections
@@ -71,8 +185,10 @@ public:
      * @param connections_file - path of connections CSV file
      * @param vertices_files - path of vertices CSV file
      * @param weighted - specifies whether the graph is weighted
+     * @param threads - number of threads used to parse the files; 0 uses
+     *  one per hardware thread. The graph is the same for any count.
      */
-    Graph(string connections_file, string vertices_file, bool weighted);
+    Graph(string connections_file, string vertices_file, bool weighted, unsigned threads = 0);
 
     /**
      * Constructor to create an empty graph.
@@ -105,10 +221,20 @@ public:
      */
     vector<Vertex> getAdjacent(Vertex source) const;
 
+    /**
+     * Gets the neighbors of a vertex without copying them. Each element is
+     * a pair of the neighbor and the edge leading to it, so its weight
+     * comes without a second lookup.
+     * @param source - vertex to get neighbors from
+     * @return the neighbors, or an empty range if source is not in the
+     *  graph
+     */
+    Range<EdgeMap::const_iterator> neighbors(Vertex source) const;
+
     /**
      * Returns one vertex in the graph. This function can be used
      *  to find a random vertex with which to start a traversal.
-     * @return a vertex from the graph
+     * @return a vertex from the graph, or InvalidVertex if it is empty
      */
     Vertex getStartingVertex() const;
 
@@ -119,6 +245,12 @@ public:
     vector<Vertex> getVertices() const;
     
 
+    /**
+     * Gets all vertices in the graph without copying them, in the order
+     * of getVertices().
+     */
+    Range<VertexIterator> vertices() const;
+
     /**
      * Gets an edge between two vertices.
      * @param source - one vertex the edge is connected to
@@ -134,6 +266,12 @@ public:
      */
     vector<Edge> getEdges() const;
 
+    /**
+     * Gets all the edges in the graph without copying them, each
+     * undirected edge once.
+     */
+    Range<EdgeIterator> edges() const;
+
     /**
      * Checks if the given vertex exists.
      * @return - if Vertex exists, true
@@ -173,7 +311,7 @@ public:
      * @return - if edge exists, return edge wright
      *         - if doesn't, return InvalidWeight
      */
-    int getEdgeWeight(Vertex source, Vertex destination) const;
+    double getEdgeWeight(Vertex source, Vertex destination) const;
 
     /**
      * Inserts a new vertex into the graph and initializes its label as "".
@@ -218,6 +356,15 @@ public:
      */
     Edge setEdgeWeight(Vertex source, Vertex destination, double weight);
 
+    /**
+     * Builds an immutable compressed-sparse-row snapshot of the graph.
+     * Vertex ids follow the order of getVertices(), and each vertex's arcs
+     * follow the order of getAdjacent(), so searches over the snapshot
+     * visit vertices in the same order as searches over the graph.
+     * @return a snapshot of the current graph
+     */
+    CsrGraph freeze() const;
+
     /**
      * Creates a name for snapshots of the graph.
      * @param title - the name to save the snapshots as
@@ -231,32 +378,107 @@ public:
     void print() const;
     
     /** 
-    * Render graph onto png of map
+    * Render graph onto png of map. Every render and drawPathHelper also
+    * takes a cs225::RGBAPNG, which it draws the same pixels into, packed.
     */
-    cs225::PNG render(Graph g, cs225::PNG png) const;
+    cs225::PNG render(const Graph& g, cs225::PNG png) const;
+    cs225::RGBAPNG render(const Graph& g, cs225::RGBAPNG png) const;
+
+    /**
+     * Render a graph snapshot onto png of map
+     */
+    static cs225::PNG render(const CsrGraph& g, cs225::PNG png);
+    static cs225::RGBAPNG render(const CsrGraph& g, cs225::RGBAPNG png);
+
+    /**
+     * Renders the part of a map that falls on png, whose top left pixel
+     * shows the point (originX, originY). Only the segments of the tree
+     * near the image are drawn, so a crop of a large network costs time
+     * in proportion to what is visible; build the tree once per graph.
+     * @param tree - the edges of the graph
+     * @param png - the image to draw on
+     * @param originX - x of the map at the left edge of png
+     * @param originY - y of the map at the top edge of png
+     * @param threads - number of threads drawing tiles of the image; 0 for
+     *  one per core. The image is the same for any count.
+     */
+    static cs225::PNG render(const EdgeTree& tree, cs225::PNG png, int originX = 0, int originY = 0,
+                             unsigned threads = 0);
+    static cs225::RGBAPNG render(const EdgeTree& tree, cs225::RGBAPNG png, int originX = 0, int originY = 0,
+                                 unsigned threads = 0);
+
+    /**
+     * Renders the part of a map that options put on png, at any scale.
+     * Edges that map to less than options.minLength pixels are drawn as a
+     * dot at their first end. A node of the tree that maps to less than
+     * options.cellSize pixels on each side, and whose edges are long
+     * enough to cover its box with the pen, is drawn as its filled box.
+     * An overview of a dense network then costs time in proportion to the
+     * pixels it covers, not to its edges.
+     * @param tree - the edges of the graph
+     * @param png - the image to draw on
+     * @param options - the transform, pen and level of detail
+     */
+    static cs225::PNG render(const EdgeTree& tree, cs225::PNG png, const RenderOptions& options);
+    static cs225::RGBAPNG render(const EdgeTree& tree, cs225::RGBAPNG png, const RenderOptions& options);
+
+    /**
+     * Same as the render overloads, drawing onto png itself. The render
+     * overloads take png by value and return it, so they copy nothing when
+     * given a temporary or std::move(png); these suit a caller that keeps
+     * one canvas, like main drawing the map and then the routes on it.
+     * @param png - the image to draw on
+     */
+    static void renderInto(const Graph& g, cs225::PNG& png);
+    static void renderInto(const Graph& g, cs225::RGBAPNG& png);
+    static void renderInto(const CsrGraph& g, cs225::PNG& png);
+    static void renderInto(const CsrGraph& g, cs225::RGBAPNG& png);
+    static void renderInto(const EdgeTree& tree, cs225::PNG& png, const RenderOptions& options = RenderOptions());
+    static void renderInto(const EdgeTree& tree, cs225::RGBAPNG& png,
+                           const RenderOptions& options = RenderOptions());
 
     /**
      * Helper function for drawPath.
      */ 
     static void drawPathHelper(cs225::PNG& png, cs225::HSLAPixel color, Vertex first, Vertex second, double size);
+    static void drawPathHelper(cs225::RGBAPNG& png, cs225::RGBAPixel color, Vertex first, Vertex second, double size);
+
+    /**
+     * Draws a line the way drawPathHelper did before it filled spans: a
+     * size x size square stamped through getPixel at every step of a
+     * double-precision walk. Kept as the reference drawPathHelper must
+     * match pixel for pixel, and as the baseline of "./bench raster".
+     */
+    static void drawPathStamped(cs225::PNG& png, cs225::HSLAPixel color, Vertex first, Vertex second, double size);
 
     bool isDirected() const;
 
+    /**
+     * Gets a counter that changes every time the graph is modified, so
+     * callers can tell whether a snapshot taken earlier is still current.
+     * @return the current version of the graph
+     */
+    unsigned long getVersion() const;
+
     void clear();
 
 
     const static Vertex InvalidVertex;
     const static Edge InvalidEdge;
-    const static int InvalidWeight;
+    const static double InvalidWeight;
     const static string InvalidLabel;
 
 private:
 
-    mutable unordered_map<Vertex, unordered_map<Vertex, Edge>> adjacency_list;
+    unordered_map<Vertex, EdgeMap> adjacency_list;
+
+    /** Neighbors of a vertex that is not in the graph. */
+    const static EdgeMap NoNeighbors;
 
     bool weighted;
     bool directed;
     Random random;
+    unsigned long version;
     int picNum;
     string picName;
 
@@ -279,6 +501,14 @@ private:
     bool assertEdgeExists(Vertex source, Vertex destination, string functionName) const;
 
 
+    /**
+     * Looks up an edge without modifying the graph.
+     * @param source - one vertex the edge is connected to
+     * @param destination - the other vertex the edge is connected to
+     * @return the stored edge, or NULL if there is none
+     */
+    const Edge* findEdge(Vertex source, Vertex destination) const;
+
     /**
      * Prints a graph error and quits the program.
      * The program is exited with a segfault to provide a stack trace.
@@ -286,6 +516,6 @@ private:
      */
     void error(string message) const;
 
-    vector<Vertex> readVertexCSV(string filename);
-    vector<Edge> readConnectionsCSV(string filename, vector<Vertex> vertices);
+    vector<Vertex> readVertexCSV(string filename, unsigned threads);
+    vector<Edge> readConnectionsCSV(string filename, const vector<Vertex>& vertices, unsigned threads);
 };
\ No newline at end of file
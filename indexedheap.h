@@ -0,0 +1,142 @@
+/**
+ * @file indexedheap.h
+ * Addressable d-ary min-heap keyed by dense vertex id.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+/**
+ * Min-heap of vertex ids with a position index, so the key of a vertex
+ * already in the heap can be lowered in place (decrease-key) instead of
+ * pushing a duplicate entry.
+ *
+ * Each node has Arity children. A wider node makes the heap shallower, so
+ * decreaseKey() (which only sifts up) does fewer steps, at the price of
+ * more comparisons per level in pop(); 4 is a good fit for road graphs.
+ *
+ * The position index is never cleared: a vertex is in the heap only if its
+ * recorded position holds that vertex, so clear() is O(1) and a stale
+ * position from an earlier query is harmless.
+ */
+template <unsigned Arity = 4>
+class IndexedHeap
+{
+  public:
+    typedef uint32_t VertexId;
+
+    struct Entry
+    {
+        double key;
+        VertexId vertex;
+    };
+
+    /**
+     * Makes room for vertex ids below numVertices.
+     */
+    void resize(uint32_t numVertices)
+    {
+        if (position_.size() < numVertices)
+            position_.resize(numVertices, 0);
+    }
+
+    /** Removes every entry; keeps the storage. */
+    void clear() { heap_.clear(); }
+
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+
+    /** @return whether v is in the heap */
+    bool contains(VertexId v) const
+    {
+        uint32_t i = position_[v];
+        return i < heap_.size() && heap_[i].vertex == v;
+    }
+
+    /** @return the entry with the smallest key */
+    const Entry& top() const { return heap_[0]; }
+
+    /**
+     * Adds a vertex that is not in the heap.
+     */
+    void push(VertexId v, double key)
+    {
+        Entry entry = {key, v};
+        heap_.push_back(entry);
+        siftUp((uint32_t) heap_.size() - 1);
+    }
+
+    /**
+     * Lowers the key of a vertex in the heap.
+     * @param key - the new key, no larger than the current one
+     */
+    void decreaseKey(VertexId v, double key)
+    {
+        uint32_t i = position_[v];
+        heap_[i].key = key;
+        siftUp(i);
+    }
+
+    /**
+     * Removes and returns the entry with the smallest key.
+     */
+    Entry pop()
+    {
+        Entry top = heap_[0];
+        Entry last = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) {
+            heap_[0] = last;
+            siftDown(0);
+        }
+        return top;
+    }
+
+  private:
+    vector<Entry> heap_;
+    vector<uint32_t> position_;     /**< index in heap_ of each vertex */
+
+    void siftUp(uint32_t i)
+    {
+        Entry entry = heap_[i];
+        while (i > 0) {
+            uint32_t parent = (i - 1) / Arity;
+            if (!(entry.key < heap_[parent].key))
+                break;
+            heap_[i] = heap_[parent];
+            position_[heap_[i].vertex] = i;
+            i = parent;
+        }
+        heap_[i] = entry;
+        position_[entry.vertex] = i;
+    }
+
+    void siftDown(uint32_t i)
+    {
+        Entry entry = heap_[i];
+        uint32_t size = (uint32_t) heap_.size();
+        while (true) {
+            uint32_t first = i * Arity + 1;
+            if (first >= size)
+                break;
+            uint32_t last = first + Arity < size ? first + Arity : size;
+            uint32_t best = first;
+            for (uint32_t child = first + 1; child < last; child++) {
+                if (heap_[child].key < heap_[best].key)
+                    best = child;
+            }
+            if (!(heap_[best].key < entry.key))
+                break;
+            heap_[i] = heap_[best];
+            position_[heap_[i].vertex] = i;
+            i = best;
+        }
+        heap_[i] = entry;
+        position_[entry.vertex] = i;
+    }
+};
@@ -0,0 +1,209 @@
+#include "landmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "indexedheap.h"
+#include "searchworkspace.h"
+
+namespace {
+
+    typedef CsrGraph::VertexId VertexId;
+
+    const double Infinity = std::numeric_limits<double>::infinity();
+
+    /**
+     * Runs Dijkstra from source over every reachable vertex. Distances
+     * and parents are left in workspace, and workspace.queue() lists the
+     * vertices in the order they were settled.
+     */
+    void shortestPathTree(const CsrGraph& g, VertexId source, SearchWorkspace& workspace)
+    {
+        workspace.reset(g.numVertices());
+        IndexedHeap<>& heap = workspace.indexedHeap();
+        vector<VertexId>& order = workspace.queue();
+        workspace.reach(source, CsrGraph::InvalidId, 0);
+        heap.push(source, 0);
+
+        while (!heap.empty()) {
+            IndexedHeap<>::Entry top = heap.pop();
+            workspace.settle(top.vertex);
+            order.push_back(top.vertex);
+
+            for (uint32_t arc = g.arcBegin(top.vertex); arc < g.arcEnd(top.vertex); arc++) {
+                VertexId next = g.target(arc);
+                if (workspace.isSettled(next))
+                    continue;
+                double distance = top.key + g.weight(arc);
+                if (!workspace.isReached(next)) {
+                    workspace.reach(next, top.vertex, distance);
+                    heap.push(next, distance);
+                } else if (distance < workspace.distance(next)) {
+                    workspace.reach(next, top.vertex, distance);
+                    heap.decreaseKey(next, distance);
+                }
+            }
+        }
+    }
+
+    /** Copies the distances of a finished search into column k of a table. */
+    void storeColumn(const SearchWorkspace& workspace, uint32_t numVertices, unsigned count, unsigned k,
+                     vector<double>& table)
+    {
+        for (VertexId v = 0; v < numVertices; v++)
+            table[(size_t) v * count + k] = workspace.isReached(v) ? workspace.distance(v) : Infinity;
+    }
+
+    /**
+     * Lower bound on dist(from, to) from the first used landmarks.
+     *
+     * Each difference of two distances is consistent: it never drops by
+     * more than an arc's weight along that arc, so astar settles each vertex
+     * once. Sums rounded in another order can still put it an ulp above the
+     * true distance, so slack, the same for every vertex, is taken off; a
+     * constant shift keeps the bound consistent.
+     */
+    double bound(const double* fromLandmark, const double* toLandmark, unsigned count, unsigned used,
+                 VertexId from, VertexId to, double slack)
+    {
+        const double* fromRow = fromLandmark + (size_t) from * count;
+        const double* toRow = fromLandmark + (size_t) to * count;
+        double best = 0;
+        for (unsigned k = 0; k < used; k++) {
+            // dist(from, to) >= dist(L, to) - dist(L, from)
+            double a = toRow[k], b = fromRow[k];
+            if (std::isfinite(a) && std::isfinite(b))
+                best = std::max(best, a - b);
+        }
+
+        // dist(from, to) >= dist(from, L) - dist(to, L); for undirected
+        // graphs this is the same bound with the roles swapped
+        const double* fromBack = (toLandmark != NULL ? toLandmark : fromLandmark) + (size_t) from * count;
+        const double* toBack = (toLandmark != NULL ? toLandmark : fromLandmark) + (size_t) to * count;
+        for (unsigned k = 0; k < used; k++) {
+            double a = fromBack[k], b = toBack[k];
+            if (std::isfinite(a) && std::isfinite(b))
+                best = std::max(best, a - b);
+        }
+        return std::max(0.0, best - slack);
+    }
+}
+
+Landmarks::Landmarks() : count_(0), directed_(false), slack_(0)
+{
+}
+
+Landmarks::Landmarks(const CsrGraph& graph, unsigned count, Strategy strategy, unsigned seed)
+    : count_(0), directed_(graph.isDirected()), slack_(0)
+{
+    uint32_t n = graph.numVertices();
+    if (n == 0 || count == 0)
+        return;
+    count = std::min(count, n);
+
+    CsrGraph reverse = graph.reversed();
+    fromLandmark_.assign((size_t) n * count, Infinity);
+    if (directed_)
+        toLandmark_.assign((size_t) n * count, Infinity);
+
+    std::mt19937 rng(seed);
+    SearchWorkspace workspace;
+    vector<double> nearest(n, Infinity);    /**< distance to the closest landmark */
+    vector<double> size(n);
+    vector<char> covered(n);
+    vector<VertexId> heaviestChild(n);
+
+    // the first landmark is the vertex farthest from a random one
+    shortestPathTree(graph, rng() % n, workspace);
+    VertexId next = workspace.queue().back();
+
+    for (unsigned k = 0; k < count; k++) {
+        landmarks_.push_back(next);
+        shortestPathTree(graph, next, workspace);
+        storeColumn(workspace, n, count, k, fromLandmark_);
+        for (VertexId v = 0; v < n; v++) {
+            if (workspace.isReached(v))
+                nearest[v] = std::min(nearest[v], workspace.distance(v));
+        }
+        if (directed_) {
+            shortestPathTree(reverse, next, workspace);
+            storeColumn(workspace, n, count, k, toLandmark_);
+        }
+        if (k + 1 == count)
+            break;
+
+        // Farthest, and the fallback of Avoid: the vertex farthest from
+        // every landmark so far (vertices no landmark reaches are skipped)
+        next = CsrGraph::InvalidId;
+        double farthest = -1;
+        for (VertexId v = 0; v < n; v++) {
+            if (std::isfinite(nearest[v]) && nearest[v] > farthest) {
+                farthest = nearest[v];
+                next = v;
+            }
+        }
+        if (strategy != Avoid)
+            continue;
+
+        // Avoid: grow a shortest path tree from a random root and weigh
+        // every vertex by how far its current bound from the root falls
+        // short. Subtrees holding a landmark are left out; walking down
+        // from the heaviest remaining subtree into its heaviest child ends
+        // at a leaf in the worst covered region.
+        VertexId root = rng() % n;
+        shortestPathTree(graph, root, workspace);
+        const vector<VertexId>& order = workspace.queue();
+        for (VertexId v : order) {
+            size[v] = workspace.distance(v) - bound(fromLandmark_.data(), directed_ ? toLandmark_.data() : NULL,
+                                                    count, k + 1, root, v, 0);
+            covered[v] = std::find(landmarks_.begin(), landmarks_.end(), v) != landmarks_.end();
+            heaviestChild[v] = CsrGraph::InvalidId;
+        }
+        for (size_t i = order.size(); i-- > 1;) {
+            VertexId v = order[i];
+            VertexId parent = workspace.parent(v);
+            if (covered[v]) {
+                covered[parent] = 1;
+                continue;
+            }
+            size[parent] += size[v];
+            if (heaviestChild[parent] == CsrGraph::InvalidId || size[v] > size[heaviestChild[parent]])
+                heaviestChild[parent] = v;
+        }
+
+        VertexId leaf = CsrGraph::InvalidId;
+        for (VertexId v : order) {
+            if (!covered[v] && (leaf == CsrGraph::InvalidId || size[v] > size[leaf]))
+                leaf = v;
+        }
+        if (leaf == CsrGraph::InvalidId || size[leaf] <= 0)
+            continue;
+        while (heaviestChild[leaf] != CsrGraph::InvalidId)
+            leaf = heaviestChild[leaf];
+        next = leaf;
+    }
+    count_ = (unsigned) landmarks_.size();
+
+    double longest = 0;
+    for (const vector<double>* table : {&fromLandmark_, &toLandmark_}) {
+        for (double distance : *table) {
+            if (std::isfinite(distance))
+                longest = std::max(longest, distance);
+        }
+    }
+    slack_ = std::ldexp(longest, -32);
+}
+
+double Landmarks::lowerBound(VertexId from, VertexId to) const
+{
+    if (count_ == 0)
+        return 0;
+    return bound(fromLandmark_.data(), directed_ ? toLandmark_.data() : NULL, count_, count_, from, to, slack_);
+}
+
+size_t Landmarks::memoryUsage() const
+{
+    return (fromLandmark_.size() + toLandmark_.size()) * sizeof(double);
+}
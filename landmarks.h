@@ -0,0 +1,81 @@
+/**
+ * @file landmarks.h
+ * Landmark distance tables for ALT (A*, landmarks, triangle inequality).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "csrgraph.h"
+
+using std::vector;
+
+/**
+ * Distances between every vertex and a few landmark vertices, used as
+ * lower bounds for astar.
+ *
+ * For a landmark L the triangle inequality gives, for any u and t,
+ *   dist(u, t) >= dist(L, t) - dist(L, u)  and
+ *   dist(u, t) >= dist(u, L) - dist(t, L),
+ * and the bound is the largest of these over all landmarks. Unlike the
+ * straight-line distance it follows the road network, so it is much
+ * tighter when roads wind, and it stays admissible whatever the weights
+ * mean.
+ *
+ * The distances of one vertex to all landmarks are stored next to each
+ * other, so a bound reads one short run of memory per vertex. They are
+ * kept as doubles: rounding them down to float would need a safety margin
+ * that grows with each vertex's distances and makes the bound
+ * inconsistent, and astar never reopens a vertex.
+ */
+class Landmarks
+{
+  public:
+    typedef CsrGraph::VertexId VertexId;
+
+    /** How landmarks are picked. */
+    enum Strategy {
+        Farthest,   /**< each one as far as possible from those before */
+        Avoid       /**< where the current bounds are weakest */
+    };
+
+    /**
+     * Creates an empty set of landmarks, whose bounds are all 0.
+     */
+    Landmarks();
+
+    /**
+     * Picks landmarks and computes their distance tables.
+     * @param graph - the snapshot astar will search
+     * @param count - number of landmarks
+     * @param strategy - how to pick them
+     * @param seed - seed of the random choices the strategy makes
+     */
+    Landmarks(const CsrGraph& graph, unsigned count, Strategy strategy = Avoid, unsigned seed = 0);
+
+    /** @return the number of landmarks */
+    unsigned count() const { return count_; }
+
+    /** @return the id of the k-th landmark */
+    VertexId landmark(unsigned k) const { return landmarks_[k]; }
+
+    /**
+     * @return a lower bound on the length of the shortest path from one
+     *  vertex to another
+     */
+    double lowerBound(VertexId from, VertexId to) const;
+
+    /** @return the number of bytes held by the distance tables */
+    size_t memoryUsage() const;
+
+  private:
+    unsigned count_;
+    bool directed_;
+    double slack_;                  /**< taken off every bound for rounding */
+    vector<VertexId> landmarks_;
+    vector<double> fromLandmark_;   /**< dist(L_k, v) at [v * count_ + k] */
+    vector<double> toLandmark_;     /**< dist(v, L_k); empty if undirected */
+};
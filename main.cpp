@@ -1,31 +1,398 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <thread>
+#include <utility>
 #include <vector>
+#include <sys/stat.h>
 
 #include "vertex.h"
+#include "basemap.h"
 #include "graph.h"
-#include "cs225/PNG.h"
+#include "csrgraph.h"
+#include "contractionhierarchy.h"
+#include "csvparser.h"
+#include "mappedfile.h"
+#include "cs225/RGBAPNG.h"
 #include "search.h"
+#include "spatialindex.h"
+#include "tilepyramid.h"
+#include "vertexorder.h"
 
 using namespace std;
 
-int main() {
+/**
+ * @return how output images are encoded: they are large and mostly a few
+ *  colors, so in stripes on every core
+ */
+cs225::EncodeOptions outputEncoding() {
+	cs225::EncodeOptions options;
+	options.parallel = true;
+	return options;
+}
+
+/**
+ * Prints the command line usage.
+ * @return the exit status of a bad command line
+ */
+int usage(const char* program) {
+	cerr << "usage: " << program << " [--convert <connections.csv> <vertices.csv> <snapshot> [ordering]"
+	     << " | --snapshot <snapshot> | --contract <snapshot> <hierarchy>"
+	     << " | --batch <queries.csv> [snapshot] | --route <x1> <y1> <x2> <y2> [snapshot]"
+	     << " | --routes <queries.csv> <prefix> [snapshot [cache]] | --tiles <directory> [snapshot]"
+	     << " | --update-tiles <directory> <old snapshot> <new snapshot>"
+	     << " | --overview <width> <height> [snapshot]]" << endl;
+	return 1;
+}
+
+/**
+ * Parses a whole command line argument as a number.
+ * @return false, if arg is not a number
+ */
+bool parseNumber(const string& arg, double& value) {
+	try {
+		size_t used = 0;
+		value = stod(arg, &used);
+		return used == arg.size();
+	} catch (const exception&) {
+		return false;
+	}
+}
+
+/** Widest and tallest image --overview draws: 1 GB of pixels at 16384x16384. */
+const unsigned MaxImageSide = 16384;
+
+/**
+ * Parses a whole command line argument as an image side.
+ * @return false, if arg is not a whole number from 1 to MaxImageSide
+ */
+bool parseSize(const string& arg, unsigned& value) {
+	double number;
+	if (!parseNumber(arg, number) || !(number >= 1 && number <= MaxImageSide) || number != (unsigned) number)
+		return false;
+	value = (unsigned) number;
+	return true;
+}
+
+/**
+ * Reads a query file. Lines are either "source,target" vertex indices or
+ * "x1,y1,x2,y2" coordinates; the first kind fills queries and the second
+ * points, whichever the file holds.
+ * @return false, if the file could not be read
+ */
+bool readQueries(const CsrGraph& snapshot, const string& queries_file, vector<Search::PointQuery>& points,
+                 vector<Search::Query>& queries, size_t& malformed) {
+	MappedFile file(queries_file);
+	if (!file.isOpen()) {
+		cerr << "Could not read queries " << queries_file << endl;
+		return false;
+	}
+	const char* begin = csv::skipBom(file.begin(), file.end());
+	malformed = 0;
+	csv::forEachRow<PointQueryRecord>(begin, file.end(), [&](const PointQueryRecord& r) {
+		Search::PointQuery query = {r.sourceX, r.sourceY, r.targetX, r.targetY};
+		points.push_back(query);
+	}, &malformed);
+
+	if (points.empty()) {
+		malformed = 0;
+		csv::forEachRow<QueryRecord>(begin, file.end(), [&](const QueryRecord& r) {
+			Search::Query query = {snapshot.getId(Vertex(r.source)), snapshot.getId(Vertex(r.target))};
+			queries.push_back(query);
+		}, &malformed);
+	}
+	return true;
+}
+
+/**
+ * Answers every query of a query file with Search::batch on all cores and
+ * reports throughput and latency. Coordinates are snapped to the nearest
+ * vertices.
+ */
+int runBatch(const CsrGraph& snapshot, const string& queries_file) {
+	vector<Search::PointQuery> points;
+	vector<Search::Query> queries;
+	size_t malformed;
+	if (!readQueries(snapshot, queries_file, points, queries, malformed)) return 1;
+
+	Search search(snapshot);
+	SpatialIndex index;
+	if (!points.empty()) index = SpatialIndex(snapshot);
+	vector<Search::QueryResult> results;
+	unsigned threads = max(1u, thread::hardware_concurrency());
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (points.empty()) {
+		search.batch(queries, results, threads);
+	} else {
+		search.batch(points, index, results, threads);
+	}
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	vector<double> latencies;
+	size_t unreachable = 0;
+	for (const Search::QueryResult& result : results) {
+		latencies.push_back(result.seconds);
+		if (result.path.empty()) unreachable++;
+	}
+	sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) {
+		return latencies.empty() ? 0.0 : latencies[(size_t) (p * (latencies.size() - 1))] * 1e6;
+	};
+
+	cout << results.size() << " queries (" << unreachable << " unreachable, " << malformed
+	     << " malformed lines) on " << threads << " threads in " << wall << " s" << endl;
+	cout << results.size() / wall << " queries/s, latency p50 " << percentile(0.5)
+	     << " us, p99 " << percentile(0.99) << " us" << endl;
+	return 0;
+}
+
+/**
+ * Renders the paths of every query of a query file to its own image,
+ * prefix0.png, prefix1.png and so on, drawing the road network once for
+ * all of them. Queries are read as by runBatch. With a cache directory,
+ * the rendered network is saved there and read back by later runs.
+ */
+int runRoutes(const CsrGraph& snapshot, const string& queries_file, const string& prefix,
+              const string& cacheDirectory) {
+	vector<Search::PointQuery> points;
+	vector<Search::Query> queries;
+	size_t malformed;
+	if (!readQueries(snapshot, queries_file, points, queries, malformed)) return 1;
+	if (!points.empty()) {
+		SpatialIndex index(snapshot);
+		if (index.size() == 0) {
+			cerr << "The graph has no vertices" << endl;
+			return 1;
+		}
+		for (const Search::PointQuery& point : points) {
+			Search::Query query = {index.nearest(point.sourceX, point.sourceY),
+			                       index.nearest(point.targetX, point.targetY)};
+			queries.push_back(query);
+		}
+	}
+
+	cs225::RGBAPNG png;
+	if (!png.readFromFile("background.png")) return 1;
+	Search search(snapshot);
+	BaseMap map(snapshot, std::move(png), cacheDirectory);
+	size_t written = 0;
+	for (size_t i = 0; i < queries.size(); i++) {
+		if (queries[i].source == CsrGraph::InvalidId || queries[i].target == CsrGraph::InvalidId) {
+			malformed++;
+			continue;
+		}
+		const cs225::RGBAPNG& image = map.route(search, snapshot.getVertex(queries[i].source),
+		                                        snapshot.getVertex(queries[i].target));
+		if (!image.writeToFile(prefix + to_string(i) + ".png", outputEncoding())) return 1;
+		written++;
+	}
+	cout << written << " images (" << malformed << " skipped lines)" << endl;
+	return 0;
+}
+
+/**
+ * Usage:
+ *   ./finalproj
+ *       render the sample data and both paths to outputMap.png
+ *   ./finalproj --convert <connections.csv> <vertices.csv> <snapshot> [ordering]
+ *       load a CSV graph once and save it as a binary snapshot, with its
+ *       vertices renumbered by an ordering: hilbert, bfs, rcm or original
+ *   ./finalproj --snapshot <snapshot>
+ *       same as the default, reading the graph from a binary snapshot
+ *   ./finalproj --contract <snapshot> <hierarchy>
+ *       build the contraction hierarchy of a snapshot and save it
+ *   ./finalproj --batch <queries.csv> [snapshot]
+ *       answer the queries in a file on all cores and report queries/s
+ *       and latency, on the sample data or a snapshot; queries are
+ *       vertex indices or coordinates
+ *   ./finalproj --route <x1> <y1> <x2> <y2> [snapshot]
+ *       snap both points to the nearest vertices and render the paths
+ *       between them to outputMap.png
+ *   ./finalproj --routes <queries.csv> <prefix> [snapshot [cache]]
+ *       render the paths of every query in a file to prefix0.png,
+ *       prefix1.png, ..., drawing the road network only once; with a
+ *       cache directory, the rendered network is kept there and reused by
+ *       later runs over the same snapshot and background
+ *   ./finalproj --tiles <directory> [snapshot]
+ *       render the graph into a z/x/y pyramid of 256x256 map tiles
+ *   ./finalproj --update-tiles <directory> <old snapshot> <new snapshot>
+ *       redraw only the tiles of a pyramid built from the old snapshot
+ *       that the edges changed in the new one fall on
+ *   ./finalproj --overview <width> <height> [snapshot]
+ *       fit the whole graph into a white image of the given size, 1 to
+ *       16384 pixels a side, and save it to outputMap.png
+ */
+int main(int argc, char* argv[]) {
 
 	// set up for sample data
 	string connections_file = "sampledata/oldenburg_road_network.csv";
 	string vertices_file = "sampledata/OL_road_coords.csv";
-	
-	Graph g(connections_file, vertices_file, true);
-	
-	cs225::PNG png;
-	png.readFromFile("background.png");
-
-	Search search(g);
-
-	cs225::PNG toReturn = g.render(g, png);
-	toReturn = search.drawPath(toReturn);
-	toReturn.writeToFile("outputMap.png");
-	
+
+	vector<string> args(argv + 1, argv + argc);
+
+	if ((args.size() == 4 || args.size() == 5) && args[0] == "--convert") {
+		vertexorder::Ordering ordering = vertexorder::Original;
+		if (args.size() == 5 && !vertexorder::parse(args[4], ordering)) {
+			cerr << "Unknown ordering " << args[4] << endl;
+			return 1;
+		}
+		CsrGraph snapshot = Graph(args[1], args[2], true).freeze();
+		if (ordering != vertexorder::Original) {
+			snapshot = snapshot.permuted(vertexorder::compute(snapshot, ordering));
+		}
+		if (!snapshot.writeToFile(args[3])) {
+			cerr << "Could not write snapshot " << args[3] << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (args.size() == 3 && args[0] == "--contract") {
+		CsrGraph snapshot;
+		if (!snapshot.readFromFile(args[1])) {
+			cerr << "Could not read snapshot " << args[1] << endl;
+			return 1;
+		}
+		ContractionHierarchy hierarchy(snapshot);
+		if (!hierarchy.writeToFile(args[2])) {
+			cerr << "Could not write hierarchy " << args[2] << endl;
+			return 1;
+		}
+		cout << hierarchy.numShortcuts() << " shortcuts" << endl;
+		return 0;
+	}
+
+	if ((args.size() == 2 || args.size() == 3) && args[0] == "--batch") {
+		if (args.size() == 2) {
+			return runBatch(Graph(connections_file, vertices_file, true).freeze(), args[1]);
+		}
+		CsrGraph snapshot;
+		if (!snapshot.readFromFile(args[2])) {
+			cerr << "Could not read snapshot " << args[2] << endl;
+			return 1;
+		}
+		return runBatch(snapshot, args[1]);
+	}
+
+	if (args.size() >= 3 && args.size() <= 5 && args[0] == "--routes") {
+		if (args.size() == 3) {
+			return runRoutes(Graph(connections_file, vertices_file, true).freeze(), args[1], args[2], "");
+		}
+		CsrGraph snapshot;
+		if (!snapshot.readFromFile(args[3])) {
+			cerr << "Could not read snapshot " << args[3] << endl;
+			return 1;
+		}
+		string cacheDirectory = args.size() == 5 ? args[4] : "";
+		if (!cacheDirectory.empty()) mkdir(cacheDirectory.c_str(), 0755);
+		return runRoutes(snapshot, args[1], args[2], cacheDirectory);
+	}
+
+	if ((args.size() == 2 || args.size() == 3) && args[0] == "--tiles") {
+		CsrGraph snapshot;
+		if (args.size() == 3 && !snapshot.readFromFile(args[2])) {
+			cerr << "Could not read snapshot " << args[2] << endl;
+			return 1;
+		}
+		if (args.size() == 2) snapshot = Graph(connections_file, vertices_file, true).freeze();
+		TilePyramid pyramid(args[1]);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t tiles = pyramid.build(EdgeTree(snapshot));
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << tiles << " tiles, zoom 0 to " << pyramid.maxZoom() << ", in " << wall << " s" << endl;
+		return 0;
+	}
+
+	if (args.size() == 4 && args[0] == "--update-tiles") {
+		CsrGraph before, after;
+		if (!before.readFromFile(args[2]) || !after.readFromFile(args[3])) {
+			cerr << "Could not read snapshots " << args[2] << " and " << args[3] << endl;
+			return 1;
+		}
+		EdgeTree beforeTree(before), afterTree(after);
+		vector<EdgeTree::Segment> changed;
+		TilePyramid::changedSegments(beforeTree, afterTree, changed);
+		TilePyramid pyramid(args[1]);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t tiles = pyramid.update(afterTree, changed);
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << changed.size() << " changed segments, " << tiles << " tiles, zoom 0 to " << pyramid.maxZoom()
+		     << ", in " << wall << " s" << endl;
+		return 0;
+	}
+
+	if ((args.size() == 3 || args.size() == 4) && args[0] == "--overview") {
+		unsigned width, height;
+		if (!parseSize(args[1], width) || !parseSize(args[2], height)) return usage(argv[0]);
+		CsrGraph snapshot;
+		if (args.size() == 4 && !snapshot.readFromFile(args[3])) {
+			cerr << "Could not read snapshot " << args[3] << endl;
+			return 1;
+		}
+		if (args.size() == 3) snapshot = Graph(connections_file, vertices_file, true).freeze();
+		EdgeTree tree(snapshot);
+		Graph::RenderOptions options = Graph::RenderOptions::fit(tree, width, height);
+		cs225::RGBAPNG png(width, height);
+		Graph::renderInto(tree, png, options);
+		return png.writeToFile("outputMap.png", outputEncoding()) ? 0 : 1;
+	}
+
+	// the map and the paths are drawn onto this one image, never copied
+	cs225::RGBAPNG png;
+
+	if ((args.size() == 5 || args.size() == 6) && args[0] == "--route") {
+		double x1, y1, x2, y2;
+		if (!parseNumber(args[1], x1) || !parseNumber(args[2], y1) || !parseNumber(args[3], x2)
+		    || !parseNumber(args[4], y2)) {
+			return usage(argv[0]);
+		}
+		CsrGraph snapshot;
+		if (args.size() == 6 && !snapshot.readFromFile(args[5])) {
+			cerr << "Could not read snapshot " << args[5] << endl;
+			return 1;
+		}
+		if (args.size() == 5) snapshot = Graph(connections_file, vertices_file, true).freeze();
+		SpatialIndex index(snapshot);
+		if (index.size() == 0) {
+			cerr << "The graph has no vertices" << endl;
+			return 1;
+		}
+		Vertex start = snapshot.getVertex(index.nearest(x1, y1));
+		Vertex end = snapshot.getVertex(index.nearest(x2, y2));
+		cout << "from vertex " << start.getIndex() << " to vertex " << end.getIndex() << endl;
+
+		png.readFromFile("background.png");
+		Search search(snapshot);
+		Graph::renderInto(snapshot, png);
+		search.drawPathInto(png, start, end);
+	} else if (args.size() == 2 && args[0] == "--snapshot") {
+		CsrGraph snapshot;
+		if (!snapshot.readFromFile(args[1])) {
+			cerr << "Could not read snapshot " << args[1] << endl;
+			return 1;
+		}
+		png.readFromFile("background.png");
+
+		Search search(snapshot);
+
+		Graph::renderInto(snapshot, png);
+		search.drawPathInto(png);
+	} else if (args.empty()) {
+		Graph g(connections_file, vertices_file, true);
+
+		png.readFromFile("background.png");
+
+		Search search(g);
+
+		Graph::renderInto(g, png);
+		search.drawPathInto(png);
+	} else {
+		return usage(argv[0]);
+	}
+	png.writeToFile("outputMap.png", outputEncoding());
+
 	return 0;
-}
\ No newline at end of file
+}
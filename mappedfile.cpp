@@ -0,0 +1,56 @@
+#include "mappedfile.h"
+
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const string& filename, bool sequential) : open_(false), data_(NULL), size_(0)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+        if (info.st_size == 0) {
+            open_ = true;
+        } else {
+            // a shared read-only mapping is backed directly by the page
+            // cache, so every process mapping the file uses the same pages
+            void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                if (sequential)
+                    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(mapping);
+                size_ = info.st_size;
+                open_ = true;
+            }
+        }
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != NULL)
+        munmap(const_cast<char*>(data_), size_);
+}
+
+bool createTempFile(const string& fileName, string& tempName)
+{
+    string pattern = fileName + ".XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if (fd < 0)
+        return false;
+    // mkstemp makes the file private to its owner; snapshots are shared
+    fchmod(fd, 0644);
+    ::close(fd);
+    tempName = name.data();
+    return true;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file mappedfile.h
+ * Read-only memory mapping of a file, and the temporary files that
+ * mapped files are replaced through.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+using std::string;
+
+/**
+ * Read-only memory mapping of a whole file. The mapping is released when
+ * the object is destroyed.
+ */
+class MappedFile
+{
+  public:
+    /**
+     * Maps a file into memory.
+     * @param filename - path of the file to map
+     * @param sequential - whether the file will be read front to back, so
+     *  the kernel can read ahead aggressively
+     */
+    MappedFile(const string& filename, bool sequential = true);
+
+    /**
+     * Unmaps the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    /**
+     * @return whether the file could be opened and mapped
+     */
+    bool isOpen() const { return open_; }
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+  private:
+    bool open_;
+    const char* data_;
+    size_t size_;
+};
+
+/**
+ * Creates an empty file with a unique name in the directory of another,
+ * to be written in full and renamed over it. Processes that have the old
+ * file mapped keep their pages, and several writers of one file never
+ * share a temporary file.
+ * @param fileName - the file to be replaced
+ * @param tempName - set to the name of the new file
+ * @return false, if the file could not be created
+ */
+bool createTempFile(const string& fileName, string& tempName);
@@ -0,0 +1,47 @@
+/**
+ * @file parallel.h
+ * A parallel loop over an index range.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs work(i, thread) for every i in [0, count) on several threads.
+ * Indices are handed out in chunks, so threads that get cheap items take
+ * more of them. thread is in [0, threads) and tells which per-thread state
+ * work may use. A range of one chunk runs on the caller alone.
+ * @param count - number of items
+ * @param threads - number of threads to use, counting the caller
+ * @param work - called once for each item
+ * @param chunk - items handed out at once; 1 for a few long items
+ */
+template <typename Work>
+void parallelFor(size_t count, unsigned threads, Work work, size_t chunk = 16)
+{
+    if (threads <= 1 || count <= chunk) {
+        for (size_t i = 0; i < count; i++)
+            work(i, 0);
+        return;
+    }
+    threads = (unsigned) std::min((size_t) threads, (count + chunk - 1) / chunk);
+
+    std::atomic<size_t> next(0);
+    auto run = [&](unsigned thread) {
+        for (size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk)) {
+            for (size_t i = begin; i < std::min(count, begin + chunk); i++)
+                work(i, thread);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned thread = 1; thread < threads; thread++)
+        workers.push_back(std::thread(run, thread));
+    run(0);
+    for (std::thread& worker : workers)
+        worker.join();
+}
@@ -1,140 +1,507 @@
 #include "search.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "parallel.h"
+
+namespace {
+    /** Heap order of astar: lowest priority on top, like a priority_queue. */
+    bool lowerPriority(const SearchWorkspace::HeapEntry& lhs, const SearchWorkspace::HeapEntry& rhs) {
+        return lhs.priority > rhs.priority;
+    }
+}
+
+Search::Search(Graph& g)
+    : graph(&g), frozenVersion(0), hasFrozen(false), heuristicScale(0),
+      landmarks(NULL) {}
+
+Search::Search(const CsrGraph& g)
+    : graph(NULL), frozen(g), frozenVersion(0), hasFrozen(true), backwardGraph(g.reversed()),
+      heuristicScale(admissibleScale(g)), landmarks(NULL) {}
+
 /**
  * Finds the shortest path between two vertices using BFS.
  * @return - the shortest path
  */
 vector<Vertex> Search::BFS(Vertex start, Vertex end) const {
-    vector<Vertex> visited;
-    std::queue<Node*> queue;
+    const CsrGraph& g = snapshot();
+    VertexId source = g.getId(start);
+    VertexId target = g.getId(end);
+    if (source == CsrGraph::InvalidId || target == CsrGraph::InvalidId
+        || !BFS(source, target, workspace, idPath)) {
+        return vector<Vertex>();
+    }
+    return toVertices(idPath);
+}
+
+/**
+ * Finds the shortest path between two vertices using astar.
+ * @return - the shortest path
+ */
+vector<Vertex> Search::astar(Vertex start, Vertex end) const {
+    const CsrGraph& g = snapshot();
+    VertexId source = g.getId(start);
+    VertexId target = g.getId(end);
+    if (source == CsrGraph::InvalidId || target == CsrGraph::InvalidId
+        || !astar(source, target, workspace, idPath)) {
+        return vector<Vertex>();
+    }
+    return toVertices(idPath);
+}
+
+vector<Vertex> Search::bidirectionalDijkstra(Vertex start, Vertex end) const {
+    return bidirectionalPath(start, end, false);
+}
+
+vector<Vertex> Search::bidirectionalAstar(Vertex start, Vertex end) const {
+    return bidirectionalPath(start, end, true);
+}
+
+vector<Vertex> Search::bidirectionalPath(Vertex start, Vertex end, bool useHeuristic) const {
+    const CsrGraph& g = snapshot();
+    VertexId source = g.getId(start);
+    VertexId target = g.getId(end);
+    if (source == CsrGraph::InvalidId || target == CsrGraph::InvalidId
+        || !bidirectional(source, target, workspace, backwardWorkspace, idPath, useHeuristic)) {
+        return vector<Vertex>();
+    }
+    return toVertices(idPath);
+}
 
-    Node* startNode = new Node(start, NULL);
+/** BFS over the snapshot's dense ids. */
+bool Search::BFS(VertexId start, VertexId end, SearchWorkspace& workspace,
+                 vector<VertexId>& path) const {
+    const CsrGraph& g = snapshot();
+    workspace.reset(g.numVertices());
+    path.clear();
 
-    queue.push(startNode);
-    visited.push_back(start);
+    // the queue is a plain vector read from the front, so it never shrinks
+    // and keeps its capacity for the next query
+    vector<VertexId>& queue = workspace.queue();
+    queue.push_back(start);
+    workspace.reach(start, CsrGraph::InvalidId, 0);
 
-    Node* current;
-    while(!queue.empty()) {
-        current = queue.front();
+    for (size_t head = 0; head < queue.size(); head++) {
+        VertexId current = queue[head];
+        workspace.settle(current);
 
-        if (current->current == end) {
-            break;
+        if (current == end) {
+            workspace.tracePath(end, path);
+            return true;
         }
 
-        for (Vertex neighbor : graph.getAdjacent(current->current)) {
-            if (std::find(visited.begin(), visited.end(), neighbor) == visited.end()) {
-                queue.push(new Node(neighbor, current));
-                visited.push_back(neighbor);
+        for (CsrGraph::Arc arc : g.neighbors(current)) {
+            VertexId neighbor = arc.target;
+            if (!workspace.isReached(neighbor)) {
+                workspace.reach(neighbor, current, workspace.distance(current) + 1);
+                queue.push_back(neighbor);
             }
         }
+    }
+
+    return false;
+}
+
+/** astar over the snapshot's dense ids. */
+bool Search::astar(VertexId start, VertexId end, SearchWorkspace& workspace,
+                   vector<VertexId>& path, QueueStrategy queue) const {
+    const CsrGraph& g = snapshot();
+    workspace.reset(g.numVertices());
+    path.clear();
 
-        queue.pop();
+    IndexedHeap<>& indexed = workspace.indexedHeap();
+    vector<SearchWorkspace::HeapEntry>& lazy = workspace.heap();
+
+    workspace.reach(start, CsrGraph::InvalidId, 0);
+    if (queue == DecreaseKey) {
+        indexed.push(start, heuristic(g, start, end));
+    } else {
+        SearchWorkspace::HeapEntry first = {heuristic(g, start, end), 0.0, start};
+        lazy.push_back(first);
     }
 
-    vector<Vertex> path;
-    while(current != NULL) {
-        path.push_back(current->current);
-        current = current->previous;
-    } 
-    std::reverse(path.begin(), path.end());
+    while (queue == DecreaseKey ? !indexed.empty() : !lazy.empty()) {
+        VertexId current;
+        if (queue == DecreaseKey) {
+            current = indexed.pop().vertex;
+        } else {
+            std::pop_heap(lazy.begin(), lazy.end(), lowerPriority);
+            current = lazy.back().vertex;
+            lazy.pop_back();
+            // a stale entry left behind by a shorter path
+            if (workspace.isSettled(current)) continue;
+        }
+        workspace.settle(current);
+
+        if (current == end) {
+            workspace.tracePath(end, path);
+            return true;
+        }
 
-    return path;
+        double cost = workspace.distance(current);
+        for (CsrGraph::Arc arc : g.neighbors(current)) {
+            VertexId neighbor = arc.target;
+            if (workspace.isSettled(neighbor)) continue;
+
+            double nextCost = cost + arc.weight;
+            bool seen = workspace.isReached(neighbor);
+            if (seen && nextCost >= workspace.distance(neighbor)) continue;
+
+            workspace.reach(neighbor, current, nextCost);
+            double priority = nextCost + heuristic(g, neighbor, end);
+            if (queue == LazyDeletion) {
+                SearchWorkspace::HeapEntry next = {priority, nextCost, neighbor};
+                lazy.push_back(next);
+                std::push_heap(lazy.begin(), lazy.end(), lowerPriority);
+            } else if (seen) {
+                indexed.decreaseKey(neighbor, priority);
+            } else {
+                indexed.push(neighbor, priority);
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Search::bidirectionalDijkstra(VertexId start, VertexId end, SearchWorkspace& forward,
+                                   SearchWorkspace& backward, vector<VertexId>& path) const {
+    return bidirectional(start, end, forward, backward, path, false);
+}
+
+bool Search::bidirectionalAstar(VertexId start, VertexId end, SearchWorkspace& forward,
+                                SearchWorkspace& backward, vector<VertexId>& path) const {
+    return bidirectional(start, end, forward, backward, path, true);
 }
 
 /**
- * Finds the shortest path between two vertices using astar.
- * @return - the shortest path
+ * Bidirectional search over the snapshot's dense ids.
+ *
+ * The forward search uses the potential p(v) = (h_end(v) - h_start(v)) / 2
+ * and the backward search -p(v). Both are consistent, so each side is a
+ * Dijkstra search on nonnegative reduced costs, and the search can stop as
+ * soon as the smallest keys of the two queues add up to at least the
+ * shortest path found so far (mu).
  */
-vector<Vertex> Search::astar(Vertex start, Vertex end) const {
-    vector<Vertex> visited;
-    std::priority_queue<Node*, std::vector<Node*>, NodeComparison> queue;
+bool Search::bidirectional(VertexId start, VertexId end, SearchWorkspace& forward,
+                           SearchWorkspace& backward, vector<VertexId>& path, bool useHeuristic) const {
+    const CsrGraph& g = snapshot();
+    forward.reset(g.numVertices());
+    backward.reset(g.numVertices());
+    path.clear();
+
+    auto potential = [&](VertexId v) {
+        if (!useHeuristic) return 0.0;
+        return (heuristic(g, v, end) - heuristic(g, start, v)) / 2;
+    };
 
-    Node* startNode = new Node(start, NULL, 0, heuristic(start, end));
+    IndexedHeap<>& forwardHeap = forward.indexedHeap();
+    IndexedHeap<>& backwardHeap = backward.indexedHeap();
+    forward.reach(start, CsrGraph::InvalidId, 0);
+    forwardHeap.push(start, potential(start));
+    backward.reach(end, CsrGraph::InvalidId, 0);
+    backwardHeap.push(end, -potential(end));
 
-    queue.push(startNode);
-    visited.push_back(start);
+    double mu = std::numeric_limits<double>::infinity();
+    VertexId meeting = CsrGraph::InvalidId;
+    if (start == end) {
+        mu = 0;
+        meeting = start;
+    }
 
-    Node* current;
-    while(!queue.empty()) {
-        current = queue.top();
-        queue.pop();
+    while (!forwardHeap.empty() && !backwardHeap.empty()) {
+        if (forwardHeap.top().key + backwardHeap.top().key >= mu) break;
 
-        if (current->current == end) {
-            break;
-        }
+        // expand the side whose next vertex is closer
+        bool isForward = forwardHeap.top().key <= backwardHeap.top().key;
+        const CsrGraph& arcs = isForward ? g : backwardGraph;
+        SearchWorkspace& self = isForward ? forward : backward;
+        SearchWorkspace& other = isForward ? backward : forward;
+        IndexedHeap<>& heap = isForward ? forwardHeap : backwardHeap;
+        double sign = isForward ? 1 : -1;
 
-        for (Vertex neighbor : graph.getAdjacent(current->current)) {
-            if (std::find(visited.begin(), visited.end(), neighbor) == visited.end()) {
-                double cost = current->cost + graph.getEdgeWeight(current->current, neighbor);
-                double priority = cost + heuristic(neighbor, end);
+        VertexId current = heap.pop().vertex;
+        self.settle(current);
+        double cost = self.distance(current);
 
-                queue.push(new Node(neighbor, current, cost, priority));
-                visited.push_back(neighbor);
+        for (CsrGraph::Arc arc : arcs.neighbors(current)) {
+            VertexId neighbor = arc.target;
+            if (self.isSettled(neighbor)) continue;
+
+            double nextCost = cost + arc.weight;
+            bool seen = self.isReached(neighbor);
+            if (seen && nextCost >= self.distance(neighbor)) continue;
+
+            self.reach(neighbor, current, nextCost);
+            double key = nextCost + sign * potential(neighbor);
+            if (seen) {
+                heap.decreaseKey(neighbor, key);
+            } else {
+                heap.push(neighbor, key);
+            }
+
+            if (other.isReached(neighbor) && nextCost + other.distance(neighbor) < mu) {
+                mu = nextCost + other.distance(neighbor);
+                meeting = neighbor;
             }
         }
     }
 
-    vector<Vertex> path;
-    while(current != NULL) {
-        path.push_back(current->current);
-        current = current->previous;
-    } 
-    std::reverse(path.begin(), path.end());
+    if (meeting == CsrGraph::InvalidId) return false;
 
-    return path;
+    // start .. meeting from the forward parents, then meeting .. end
+    // from the backward ones
+    forward.tracePath(meeting, path);
+    for (VertexId v = backward.parent(meeting); v != CsrGraph::InvalidId; v = backward.parent(v)) {
+        path.push_back(v);
+    }
+    return true;
 }
 
-/** Helper function to compute the heuristic for astar. */
-double Search::heuristic(Vertex current, Vertex end) const {
-    double x = end.getX() - current.getX();
-    double y = end.getY() - current.getY();
+/**
+ * Returns the snapshot searched, taking a new one from the graph if it has
+ * changed since the last query.
+ */
+const CsrGraph& Search::snapshot() const {
+    if (graph == NULL) return frozen;
+    if (!hasFrozen || frozenVersion != graph->getVersion()) {
+        frozen = graph->freeze();
+        frozenVersion = graph->getVersion();
+        backwardGraph = frozen.reversed();
+        heuristicScale = admissibleScale(frozen);
+        hasFrozen = true;
+    }
+    return frozen;
+}
+
+/**
+ * Answers many astar queries on several threads.
+ */
+void Search::batch(const vector<Query>& queries, vector<QueryResult>& results,
+                   unsigned threads) const {
+    typedef std::chrono::steady_clock Clock;
 
-    double distance = sqrt(pow(x, 2) + pow(y, 2));
-    return distance;
+    snapshot();     // taken here, before the threads only read it
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (batchWorkspaces.size() < threads) batchWorkspaces.resize(threads);
+    results.resize(queries.size());
+
+    parallelFor(queries.size(), threads, [&](size_t i, unsigned thread) {
+        Clock::time_point begin = Clock::now();
+        answer(queries[i].source, queries[i].target, batchWorkspaces[thread], results[i]);
+        results[i].seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    });
+}
+
+void Search::batch(const vector<PointQuery>& queries, const SpatialIndex& index,
+                   vector<QueryResult>& results, unsigned threads) const {
+    typedef std::chrono::steady_clock Clock;
+
+    snapshot();     // taken here, before the threads only read it
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (batchWorkspaces.size() < threads) batchWorkspaces.resize(threads);
+    results.resize(queries.size());
+
+    parallelFor(queries.size(), threads, [&](size_t i, unsigned thread) {
+        const PointQuery& query = queries[i];
+        Clock::time_point begin = Clock::now();
+        answer(index.nearest(query.sourceX, query.sourceY), index.nearest(query.targetX, query.targetY),
+               batchWorkspaces[thread], results[i]);
+        results[i].seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    });
+}
+
+/** Answers one query of a batch with the workspace of its thread. */
+void Search::answer(VertexId source, VertexId target, SearchWorkspace& space, QueryResult& result) const {
+    const CsrGraph& g = snapshot();
+    bool found = source < g.numVertices() && target < g.numVertices()
+                 && astar(source, target, space, result.path);
+    if (!found) result.path.clear();
+    result.cost = found ? space.distance(target) : std::numeric_limits<double>::infinity();
 }
 
 /**
- * Draws astar and bfs paths to arbitrary points in graph.
- */ 
-cs225::PNG Search::drawPath(cs225::PNG png) const {
-	Vertex start = graph.getVertices().at(0);
-    Vertex end = graph.getVertices().at(516);
+ * Makes astar use landmark bounds instead of straight-line distance.
+ */
+void Search::setLandmarks(const Landmarks* landmarks) {
+    this->landmarks = landmarks;
+}
 
-	cs225::HSLAPixel green = cs225::HSLAPixel(151, 1, 0.45, 1);
-    cs225::HSLAPixel blue = cs225::HSLAPixel(223, 1, 0.50, 1);
-	cs225::HSLAPixel red = cs225::HSLAPixel(5, 1, 0.50, 1);
+/** Converts a path of snapshot ids to vertices. */
+vector<Vertex> Search::toVertices(const vector<VertexId>& path) const {
+    const CsrGraph& g = snapshot();
+    vector<Vertex> vertices;
+    vertices.reserve(path.size());
+    for (VertexId v : path) {
+        vertices.push_back(g.getVertex(v));
+    }
+    return vertices;
+}
 
-    vector<Vertex> bfs = BFS(start, end);
-    auto first_it = bfs.begin(); 
-    auto second_it = ++bfs.begin();
-    while (second_it != bfs.end()) {
-        Vertex first = *first_it++;
-        Vertex second = *second_it++;
+/** Gets the i-th vertex in the order of getVertices(). */
+Vertex Search::vertexAt(size_t i) const {
+    const CsrGraph& g = snapshot();
+    if (i >= g.numVertices()) throw std::out_of_range("Search::vertexAt");
+    return g.getVertex((VertexId) i);
+}
 
-        Graph::drawPathHelper(png, green, first, second, 15);
+/**
+ * Finds the smallest ratio of arc weight to straight-line length. Scaling
+ * the heuristic by it keeps astar exact even where the weights are not
+ * distances (on the Oldenburg data it is within 1e-6 of 1).
+ */
+double Search::admissibleScale(const CsrGraph& g) {
+    double scale = std::numeric_limits<double>::infinity();
+    for (VertexId u = 0; u < g.numVertices(); u++) {
+        for (uint32_t arc = g.arcBegin(u); arc < g.arcEnd(u); arc++) {
+            VertexId v = g.target(arc);
+            double length = std::hypot(g.getX(v) - g.getX(u), g.getY(v) - g.getY(u));
+            if (length > 0) scale = std::min(scale, g.weight(arc) / length);
+        }
     }
+    if (std::isinf(scale) || scale < 0) return 0;
+    return scale;
+}
 
+/**
+ * Helper function to compute the heuristic for astar: the landmark bound if
+ * there are landmarks, else the straight-line distance to end, scaled so it
+ * never overestimates.
+ */
+double Search::heuristic(const CsrGraph& g, VertexId current, VertexId end) const {
+    if (landmarks != NULL) return landmarks->lowerBound(current, end);
 
-    vector<Vertex> a = astar(start, end);
-    first_it = a.begin(); 
-    second_it = ++a.begin();
-    while (second_it != a.end()) {
-        Vertex first = *first_it++;
-        Vertex second = *second_it++;
+    double x = g.getX(end) - g.getX(current);
+    double y = g.getY(end) - g.getY(current);
 
-        Graph::drawPathHelper(png, blue, first, second, 15);
-    }
+    return heuristicScale * std::sqrt(x * x + y * y);
+}
 
+namespace {
 
-	for (double i = 0; i < 30; i++) {
-        for (double j = 0; j < 30; j++) {
-            cs225::HSLAPixel& s = png.getPixel(start.getX() + i, start.getY() + j);
-            cs225::HSLAPixel& e = png.getPixel(end.getX() + i, end.getY() + j);
+    /** Pixels on a side of the square that marks each end of a route. */
+    const long MarkerSize = 30;
 
-            s = red;
-            e = red;
+    /**
+     * Fills the marker square whose top left corner is at v, clipped to
+     * the image, so markers near an edge draw only their visible part.
+     */
+    template <class Image>
+    void fillMarker(Image& png, const typename Image::Pixel& color, Vertex v) {
+        long x0 = (long) std::floor(v.getX()), y0 = (long) std::floor(v.getY());
+        long x1 = std::min(x0 + MarkerSize, (long) png.width()), y1 = std::min(y0 + MarkerSize, (long) png.height());
+        x0 = std::max(x0, 0L);
+        y0 = std::max(y0, 0L);
+        if (x0 >= x1) return;
+        for (long y = y0; y < y1; y++) {
+            typename Image::Pixel* row = &png.getPixel(x0, y);
+            std::fill(row, row + (x1 - x0), color);
         }
-	}
+    }
+
+    /** Draws a bfs and an astar path and marks their ends. */
+    template <class Image>
+    void drawRoutes(Image& png, const vector<Vertex>& bfs, const vector<Vertex>& a, Vertex start, Vertex end) {
+        typename Image::Pixel green = cs225::HSLAPixel(151, 1, 0.45, 1);
+        typename Image::Pixel blue = cs225::HSLAPixel(223, 1, 0.50, 1);
+        typename Image::Pixel red = cs225::HSLAPixel(5, 1, 0.50, 1);
+
+        for (size_t i = 0; i + 1 < bfs.size(); i++) {
+            Graph::drawPathHelper(png, green, bfs[i], bfs[i + 1], 15);
+        }
+        for (size_t i = 0; i + 1 < a.size(); i++) {
+            Graph::drawPathHelper(png, blue, a[i], a[i + 1], 15);
+        }
+
+        fillMarker(png, red, start);
+        fillMarker(png, red, end);
+    }
+
+    /**
+     * Sets lo and hi to pixels [lo, hi) of a side of size pixels that hold
+     * the pixels drawn from coordinates [min, max + pen), clipped to the
+     * side as lines and markers are.
+     */
+    void coverSide(long min, long max, long pen, long size, unsigned& lo, unsigned& hi) {
+        lo = (unsigned) std::min(std::max(min, 0L), size);
+        hi = (unsigned) std::min(std::max(max + pen, (long) lo), size);
+    }
+
+    /** @return a region of png holding the pixels drawn from (x0, y0) to (x1, y1), pen pixels wide */
+    template <class Image>
+    Search::Region boxRegion(const Image& png, Vertex first, Vertex second, long pen) {
+        Search::Region region;
+        coverSide(std::min(first.getX(), second.getX()), std::max(first.getX(), second.getX()), pen,
+                  png.width(), region.x0, region.x1);
+        coverSide(std::min(first.getY(), second.getY()), std::max(first.getY(), second.getY()), pen,
+                  png.height(), region.y0, region.y1);
+        return region;
+    }
+
+    /**
+     * Fills regions with boxes holding every pixel drawRoutes draws: one
+     * per line and one per marker. Together they cover little more than
+     * the paths themselves, unlike the box around a whole path.
+     */
+    template <class Image>
+    void routeRegions(const Image& png, const vector<Vertex>& bfs, const vector<Vertex>& a, Vertex start,
+                      Vertex end, vector<Search::Region>& regions) {
+        regions.clear();
+        for (size_t i = 0; i + 1 < bfs.size(); i++) regions.push_back(boxRegion(png, bfs[i], bfs[i + 1], 15));
+        for (size_t i = 0; i + 1 < a.size(); i++) regions.push_back(boxRegion(png, a[i], a[i + 1], 15));
+        regions.push_back(boxRegion(png, start, start, MarkerSize));
+        regions.push_back(boxRegion(png, end, end, MarkerSize));
+    }
+}
+
+/**
+ * Draws astar and bfs paths to arbitrary points in graph.
+ */
+cs225::PNG Search::drawPath(cs225::PNG png) const {
+    drawPathInto(png);
+    return png;
+}
+
+cs225::RGBAPNG Search::drawPath(cs225::RGBAPNG png) const {
+    drawPathInto(png);
+    return png;
+}
 
+/**
+ * Draws the bfs and astar paths between two vertices.
+ */
+cs225::PNG Search::drawPath(cs225::PNG png, Vertex start, Vertex end) const {
+    drawPathInto(png, start, end);
     return png;
 }
+
+cs225::RGBAPNG Search::drawPath(cs225::RGBAPNG png, Vertex start, Vertex end) const {
+    drawPathInto(png, start, end);
+    return png;
+}
+
+/**
+ * Draws the bfs and astar paths between two vertices onto png itself, and
+ * reports the regions drawn on.
+ */
+void Search::drawPathInto(cs225::RGBAPNG& png, Vertex start, Vertex end, vector<Region>* drawn) const {
+    vector<Vertex> bfs = BFS(start, end);
+    vector<Vertex> a = astar(start, end);
+    drawRoutes(png, bfs, a, start, end);
+    if (drawn != NULL) routeRegions(png, bfs, a, start, end, *drawn);
+}
+
+void Search::drawPathInto(cs225::PNG& png, Vertex start, Vertex end) const {
+    drawRoutes(png, BFS(start, end), astar(start, end), start, end);
+}
+
+void Search::drawPathInto(cs225::PNG& png) const {
+    drawPathInto(png, vertexAt(0), vertexAt(516));
+}
+
+void Search::drawPathInto(cs225::RGBAPNG& png) const {
+    drawPathInto(png, vertexAt(0), vertexAt(516));
+}
@@ -6,57 +6,286 @@
 #pragma once
 
 #include <vector>
-#include <queue>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 #include "vertex.h"
 #include "graph.h"
+#include "csrgraph.h"
+#include "landmarks.h"
+#include "searchworkspace.h"
+#include "spatialindex.h"
 
 using std::vector;
 
+/**
+ * BFS and astar over a CsrGraph.
+ *
+ * A Search built from a Graph queries a snapshot of it, taken on the first
+ * query and taken again whenever the graph has changed since.
+ *
+ * The Vertex overloads keep their state in a workspace owned by the Search,
+ * so after the first query they allocate nothing but the returned path, and
+ * one Search must not be used by several threads at once. The id overloads
+ * take the workspace and path from the caller: any number of threads may
+ * query one snapshot at the same time, each with its own workspace.
+ */
 class Search {
     public:
-        Search(Graph& g) : graph(g) {}
+        typedef CsrGraph::VertexId VertexId;
+
+        /** How astar handles a shorter path to a vertex already queued. */
+        enum QueueStrategy {
+            DecreaseKey,    /**< lower its key in an indexed 4-ary heap */
+            LazyDeletion    /**< push it again and skip stale entries */
+        };
+
+        /** One query of a batch: snapshot ids of its ends. */
+        struct Query {
+            VertexId source;
+            VertexId target;
+        };
+
+        /** One query of a batch given by coordinates, snapped to the nearest vertices. */
+        struct PointQuery {
+            double sourceX;
+            double sourceY;
+            double targetX;
+            double targetY;
+        };
+
+        /** Answer to one query of a batch. */
+        struct QueryResult {
+            double cost;            /**< length of the path; infinity if unreachable */
+            vector<VertexId> path;  /**< ids on the path; empty if unreachable */
+            double seconds;         /**< time the query took */
+        };
+
+        /** The pixels [x0, x1) x [y0, y1) of an image. */
+        struct Region {
+            unsigned x0, y0;
+            unsigned x1, y1;
+        };
+
+        Search(Graph& g);
+
+        /**
+         * Creates a search over an immutable graph snapshot. The search
+         * keeps its own copy, which shares the snapshot's storage, so g
+         * may be a temporary.
+         * @param g - snapshot created by Graph::freeze()
+         */
+        Search(const CsrGraph& g);
 
         /**
          * Finds the shortest path between two vertices using BFS.
-         * @return - the shortest path
+         * @return - the shortest path, or an empty path if end cannot be
+         *  reached
          */
         vector<Vertex> BFS(Vertex start, Vertex end) const;
 
         /**
          * Finds the shortest path between two vertices using astar.
-         * @return - the shortest path
+         * @return - the shortest path, or an empty path if end cannot be
+         *  reached
          */
         vector<Vertex> astar(Vertex start, Vertex end) const;
 
+        /**
+         * Finds the shortest path between two vertices with a Dijkstra
+         * search from each end.
+         * @return - the shortest path, or an empty path if end cannot be
+         *  reached
+         */
+        vector<Vertex> bidirectionalDijkstra(Vertex start, Vertex end) const;
+
+        /**
+         * Finds the shortest path between two vertices with an astar
+         * search from each end.
+         * @return - the shortest path, or an empty path if end cannot be
+         *  reached
+         */
+        vector<Vertex> bidirectionalAstar(Vertex start, Vertex end) const;
+
+        /**
+         * Finds the path with the fewest edges between two snapshot ids.
+         * @param start - id of the first vertex
+         * @param end - id of the last vertex
+         * @param workspace - scratch state, reset by the query
+         * @param path - cleared and filled with the ids on the path
+         * @return true, if end was reached
+         */
+        bool BFS(VertexId start, VertexId end, SearchWorkspace& workspace,
+                 vector<VertexId>& path) const;
+
+        /**
+         * Finds the shortest path between two snapshot ids using astar.
+         * Every vertex is expanded at most once, after its distance is
+         * final; workspace.settledCount() tells how many were.
+         * @param start - id of the first vertex
+         * @param end - id of the last vertex
+         * @param workspace - scratch state, reset by the query
+         * @param path - cleared and filled with the ids on the path
+         * @param queue - how to update vertices already queued
+         * @return true, if end was reached
+         */
+        bool astar(VertexId start, VertexId end, SearchWorkspace& workspace,
+                   vector<VertexId>& path, QueueStrategy queue = DecreaseKey) const;
+
+        /**
+         * Finds the shortest path between two snapshot ids by growing a
+         * Dijkstra search from start and one from end (over the reversed
+         * arcs) until no path through their frontiers can be shorter than
+         * the best meeting found. On a road network the two half-size
+         * searches settle far fewer vertices than one full-size search.
+         * @param start - id of the first vertex
+         * @param end - id of the last vertex
+         * @param forward - scratch state of the search from start
+         * @param backward - scratch state of the search from end
+         * @param path - cleared and filled with the ids on the path
+         * @return true, if end was reached
+         */
+        bool bidirectionalDijkstra(VertexId start, VertexId end, SearchWorkspace& forward,
+                                   SearchWorkspace& backward, vector<VertexId>& path) const;
+
+        /**
+         * Same as bidirectionalDijkstra(), with both searches guided by the
+         * average of the forward and backward astar heuristics, which keeps
+         * the two searches consistent so the same stopping rule applies.
+         */
+        bool bidirectionalAstar(VertexId start, VertexId end, SearchWorkspace& forward,
+                                SearchWorkspace& backward, vector<VertexId>& path) const;
+
+        /**
+         * Answers many astar queries on several threads, each with its own
+         * workspace. The snapshot is taken once before the threads start,
+         * and they only read it. Workspaces are kept for the next batch,
+         * and results reuses the paths it already holds, so a repeated
+         * batch allocates little more than the thread stacks.
+         *
+         * Like the Vertex overloads, one Search must not run several
+         * batches at once.
+         * @param queries - the queries; an end that is InvalidId is
+         *  unreachable
+         * @param results - resized to queries.size() and filled in input
+         *  order
+         * @param threads - number of threads; 0 for one per core
+         */
+        void batch(const vector<Query>& queries, vector<QueryResult>& results,
+                   unsigned threads = 0) const;
+
+        /**
+         * Same as the batch of ids, with the ends of every query snapped to
+         * their nearest vertices on the batch's threads.
+         * @param index - an index of snapshot()
+         */
+        void batch(const vector<PointQuery>& queries, const SpatialIndex& index,
+                   vector<QueryResult>& results, unsigned threads = 0) const;
+
+        /**
+         * @return the snapshot searched, refreshed first if the graph has
+         *  changed since it was taken
+         */
+        const CsrGraph& snapshot() const;
+
+        /**
+         * Makes astar and bidirectionalAstar use landmark bounds (ALT)
+         * instead of straight-line distance. The landmarks must have been
+         * built from snapshot() and must outlive their use; they go stale
+         * if a Graph search takes a new snapshot.
+         * @param landmarks - the landmarks, or NULL for straight-line distance
+         */
+        void setLandmarks(const Landmarks* landmarks);
+
         /**
          * Draws astar and bfs paths to arbitrary points in graph.
          */
         cs225::PNG drawPath(cs225::PNG png) const;
+        cs225::RGBAPNG drawPath(cs225::RGBAPNG png) const;
+
+        /**
+         * Draws the bfs and astar paths between two vertices.
+         * @param start - the first vertex, e.g. one found by a SpatialIndex
+         * @param end - the last vertex
+         */
+        cs225::PNG drawPath(cs225::PNG png, Vertex start, Vertex end) const;
+        cs225::RGBAPNG drawPath(cs225::RGBAPNG png, Vertex start, Vertex end) const;
+
+        /**
+         * Draws the bfs and astar paths between two vertices onto png
+         * itself rather than a copy.
+         * @param drawn - if not NULL, filled with regions that together
+         *  hold every pixel drawn, so the caller can undo the paths by
+         *  restoring just them
+         */
+        void drawPathInto(cs225::RGBAPNG& png, Vertex start, Vertex end, vector<Region>* drawn = NULL) const;
+        void drawPathInto(cs225::PNG& png, Vertex start, Vertex end) const;
+
+        /**
+         * Draws astar and bfs paths to arbitrary points in graph onto png
+         * itself, as drawPath(png) does.
+         */
+        void drawPathInto(cs225::PNG& png) const;
+        void drawPathInto(cs225::RGBAPNG& png) const;
 
     private:
-        Graph& graph;
+        Graph* graph;
 
-        /** Helper function to compute the heuristic for astar. */
-        double heuristic(Vertex current, Vertex end) const;
+        /**
+         * Snapshot of graph and the graph version it was taken at, or the
+         * snapshot given if graph is NULL.
+         */
+        mutable CsrGraph frozen;
+        mutable unsigned long frozenVersion;
+        mutable bool hasFrozen;
 
-        struct Node {
-            Node() {}
-            Node(Vertex curr, Node* prev) : current(curr), previous(prev) {}
-            Node(Vertex curr, Node* prev, double c, double p) : current(curr), previous(prev),
-             cost(c), priority(p) {}
+        /** The snapshot searched, with its arcs reversed. */
+        mutable CsrGraph backwardGraph;
 
-            Vertex current;
-            Node* previous;
-            double cost;
-            double priority;
-        };
+        /**
+         * Largest factor by which straight-line distance can be scaled and
+         * stay a lower bound on every arc weight of the snapshot.
+         */
+        mutable double heuristicScale;
 
-        /** Predicate for priority queue */
-        struct NodeComparison {
-            bool operator()(const Node* lhs, const Node* rhs) const {
-                return lhs->priority > rhs->priority;
-            }
-        };
-};
\ No newline at end of file
+        /** Landmarks used as the heuristic instead, if not NULL. */
+        const Landmarks* landmarks;
+
+        /** State of the Vertex overloads, reused across queries. */
+        mutable SearchWorkspace workspace;
+        mutable SearchWorkspace backwardWorkspace;
+        mutable vector<VertexId> idPath;
+
+        /** One workspace per thread of batch(), reused across batches. */
+        mutable vector<SearchWorkspace> batchWorkspaces;
+
+        /**
+         * Bidirectional search; with useHeuristic false the potentials
+         * are zero and it is plain bidirectional Dijkstra.
+         */
+        bool bidirectional(VertexId start, VertexId end, SearchWorkspace& forward,
+                           SearchWorkspace& backward, vector<VertexId>& path, bool useHeuristic) const;
+
+        /** Finds both ids, runs a bidirectional search and converts the path. */
+        vector<Vertex> bidirectionalPath(Vertex start, Vertex end, bool useHeuristic) const;
+
+        /** Answers one query of a batch with the workspace of its thread. */
+        void answer(VertexId source, VertexId target, SearchWorkspace& space, QueryResult& result) const;
+
+        /** Converts a path of snapshot ids to vertices. */
+        vector<Vertex> toVertices(const vector<VertexId>& path) const;
+
+        /** Gets the i-th vertex in the order of getVertices(). */
+        Vertex vertexAt(size_t i) const;
+
+        /** Computes heuristicScale for a snapshot. */
+        static double admissibleScale(const CsrGraph& g);
+
+        /**
+         * Helper function to compute the heuristic for astar: a lower bound
+         * on the length of the shortest path from current to end.
+         */
+        double heuristic(const CsrGraph& g, VertexId current, VertexId end) const;
+};
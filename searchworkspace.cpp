@@ -0,0 +1,39 @@
+#include "searchworkspace.h"
+
+#include <algorithm>
+
+SearchWorkspace::SearchWorkspace() : generation_(0), reached_(0), settledCount_(0)
+{
+}
+
+void SearchWorkspace::reset(uint32_t numVertices)
+{
+    if (stamp_.size() < numVertices) {
+        stamp_.resize(numVertices, 0);
+        settled_.resize(numVertices, 0);
+        parent_.resize(numVertices);
+        distance_.resize(numVertices);
+    }
+
+    generation_++;
+    if (generation_ == 0) {
+        // the stamps wrapped around: clear them once every 2^32 queries
+        std::fill(stamp_.begin(), stamp_.end(), 0);
+        std::fill(settled_.begin(), settled_.end(), 0);
+        generation_ = 1;
+    }
+    reached_ = 0;
+    settledCount_ = 0;
+    queue_.clear();
+    heap_.clear();
+    indexedHeap_.resize(numVertices);
+    indexedHeap_.clear();
+}
+
+void SearchWorkspace::tracePath(VertexId end, vector<VertexId>& path) const
+{
+    path.clear();
+    for (VertexId v = end; v != CsrGraph::InvalidId; v = parent_[v])
+        path.push_back(v);
+    std::reverse(path.begin(), path.end());
+}
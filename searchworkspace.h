@@ -0,0 +1,128 @@
+/**
+ * @file searchworkspace.h
+ * Reusable per-query state for searches over a CsrGraph.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "csrgraph.h"
+#include "indexedheap.h"
+
+using std::vector;
+
+/**
+ * Distance, parent, reached and settled arrays indexed by dense vertex id,
+ * plus the queue storage a search needs.
+ *
+ * Starting a query does not clear the arrays. Instead every entry carries
+ * the generation it was written in, and an entry from an older generation
+ * reads as unreached, so reset() is O(1) and a query only touches the
+ * vertices it explores. Once the arrays have grown to the graph's size, a
+ * workspace makes no allocations.
+ *
+ * A workspace holds the state of one query at a time; give each thread
+ * its own.
+ */
+class SearchWorkspace
+{
+  public:
+    typedef CsrGraph::VertexId VertexId;
+
+    /** Entry of the lazy-deletion priority queue used by astar. */
+    struct HeapEntry
+    {
+        double priority;
+        double cost;
+        VertexId vertex;
+    };
+
+    /**
+     * Creates an empty workspace.
+     */
+    SearchWorkspace();
+
+    /**
+     * Starts a new query on a graph with the given number of vertices.
+     * Grows the arrays if needed; otherwise O(1).
+     * @param numVertices - number of vertices in the graph searched
+     */
+    void reset(uint32_t numVertices);
+
+    /**
+     * @return whether v has been reached in the current query
+     */
+    bool isReached(VertexId v) const { return stamp_[v] == generation_; }
+
+    /**
+     * Marks v as reached in the current query.
+     * @param v - the vertex reached
+     * @param parent - vertex it was reached from (InvalidId for the source)
+     * @param distance - cost of the path found to v
+     */
+    void reach(VertexId v, VertexId parent, double distance)
+    {
+        if (stamp_[v] != generation_)
+            reached_++;
+        stamp_[v] = generation_;
+        parent_[v] = parent;
+        distance_[v] = distance;
+    }
+
+    /** @return whether v has been settled in the current query */
+    bool isSettled(VertexId v) const { return settled_[v] == generation_; }
+
+    /**
+     * Marks v as settled: its distance is final and it is not expanded
+     * again. v must be reached.
+     */
+    void settle(VertexId v)
+    {
+        settled_[v] = generation_;
+        settledCount_++;
+    }
+
+    /** @return the vertex v was reached from; v must be reached */
+    VertexId parent(VertexId v) const { return parent_[v]; }
+
+    /** @return the cost of the path found to v; v must be reached */
+    double distance(VertexId v) const { return distance_[v]; }
+
+    /** @return the number of vertices reached in the current query */
+    size_t reachedCount() const { return reached_; }
+
+    /** @return the number of vertices settled in the current query */
+    size_t settledCount() const { return settledCount_; }
+
+    /**
+     * Writes the path ending at end, following parent links back to the
+     * source, into path (source first).
+     * @param end - a reached vertex
+     * @param path - cleared and filled with the path
+     */
+    void tracePath(VertexId end, vector<VertexId>& path) const;
+
+    /** Queue storage for BFS; empty after reset(). */
+    vector<VertexId>& queue() { return queue_; }
+
+    /** Heap for astar with lazy deletion; empty after reset(). */
+    vector<HeapEntry>& heap() { return heap_; }
+
+    /** Heap for astar with decrease-key; empty after reset(). */
+    IndexedHeap<>& indexedHeap() { return indexedHeap_; }
+
+  private:
+    uint32_t generation_;
+    size_t reached_;
+    size_t settledCount_;
+    vector<uint32_t> stamp_;        /**< generation each entry was written in */
+    vector<uint32_t> settled_;      /**< generation each vertex was settled in */
+    vector<VertexId> parent_;
+    vector<double> distance_;
+    vector<VertexId> queue_;
+    vector<HeapEntry> heap_;
+    IndexedHeap<> indexedHeap_;
+};
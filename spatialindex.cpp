@@ -0,0 +1,169 @@
+#include "spatialindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+    /** @return the middle of [lo, hi), where its subtree's root is kept */
+    size_t middle(size_t lo, size_t hi)
+    {
+        return lo + (hi - lo) / 2;
+    }
+}
+
+SpatialIndex::SpatialIndex() : graph_(NULL)
+{
+}
+
+SpatialIndex::SpatialIndex(const CsrGraph& g) : graph_(&g), ids_(g.numVertices()), boxes_(g.numVertices())
+{
+    std::iota(ids_.begin(), ids_.end(), 0);
+    build(0, ids_.size(), 0);
+    coords_.reserve(2 * ids_.size());
+    for (VertexId id : ids_) {
+        coords_.push_back(g.getX(id));
+        coords_.push_back(g.getY(id));
+    }
+}
+
+void SpatialIndex::build(size_t lo, size_t hi, unsigned axis)
+{
+    if (lo >= hi)
+        return;
+    const CsrGraph& g = *graph_;
+    size_t mid = middle(lo, hi);
+    std::nth_element(ids_.begin() + lo, ids_.begin() + mid, ids_.begin() + hi, [&](VertexId a, VertexId b) {
+        return axis == 0 ? g.getX(a) < g.getX(b) : g.getY(a) < g.getY(b);
+    });
+    build(lo, mid, axis ^ 1);
+    build(mid + 1, hi, axis ^ 1);
+
+    VertexId v = ids_[mid];
+    Box box = {g.getX(v), g.getY(v), g.getX(v), g.getY(v)};
+    for (CsrGraph::Arc arc : g.neighbors(v)) {
+        box.minX = std::min(box.minX, g.getX(arc.target));
+        box.minY = std::min(box.minY, g.getY(arc.target));
+        box.maxX = std::max(box.maxX, g.getX(arc.target));
+        box.maxY = std::max(box.maxY, g.getY(arc.target));
+    }
+    for (size_t child : {middle(lo, mid), middle(mid + 1, hi)}) {
+        if (child == mid || child >= hi)
+            continue;
+        box.minX = std::min(box.minX, boxes_[child].minX);
+        box.minY = std::min(box.minY, boxes_[child].minY);
+        box.maxX = std::max(box.maxX, boxes_[child].maxX);
+        box.maxY = std::max(box.maxY, boxes_[child].maxY);
+    }
+    boxes_[mid] = box;
+}
+
+SpatialIndex::VertexId SpatialIndex::nearest(double x, double y) const
+{
+    vector<std::pair<double, size_t>> best;
+    search(0, ids_.size(), 0, x, y, 1, best);
+    return best.empty() ? CsrGraph::InvalidId : ids_[best.front().second];
+}
+
+void SpatialIndex::nearest(double x, double y, size_t k, vector<VertexId>& out) const
+{
+    out.clear();
+    if (k == 0)
+        return;
+    vector<std::pair<double, size_t>> best;
+    best.reserve(std::min(k, ids_.size()) + 1);
+    search(0, ids_.size(), 0, x, y, k, best);
+    std::sort_heap(best.begin(), best.end());
+    for (const std::pair<double, size_t>& entry : best)
+        out.push_back(ids_[entry.second]);
+}
+
+void SpatialIndex::search(size_t lo, size_t hi, unsigned axis, double x, double y, size_t k,
+                          vector<std::pair<double, size_t>>& best) const
+{
+    if (lo >= hi)
+        return;
+    size_t mid = middle(lo, hi);
+    double dx = x - coords_[2 * mid], dy = y - coords_[2 * mid + 1];
+    double d = dx * dx + dy * dy;
+    if (best.size() < k || d < best.front().first) {
+        best.push_back(std::make_pair(d, mid));
+        std::push_heap(best.begin(), best.end());
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end());
+            best.pop_back();
+        }
+    }
+
+    // the side of the split the point is on first; the other only if the
+    // splitting line is closer than the k-th best vertex
+    double split = axis == 0 ? dx : dy;
+    bool left = split < 0;
+    search(left ? lo : mid + 1, left ? mid : hi, axis ^ 1, x, y, k, best);
+    if (best.size() < k || split * split < best.front().first)
+        search(left ? mid + 1 : lo, left ? hi : mid, axis ^ 1, x, y, k, best);
+}
+
+bool SpatialIndex::nearestEdge(double x, double y, EdgeSnap& snap) const
+{
+    EdgeSnap found;
+    found.from = CsrGraph::InvalidId;
+    found.distance = std::numeric_limits<double>::infinity();
+    searchEdges(0, ids_.size(), x, y, found);
+    if (found.from == CsrGraph::InvalidId)
+        return false;
+    found.distance = std::sqrt(found.distance);
+    snap = found;
+    return true;
+}
+
+void SpatialIndex::searchEdges(size_t lo, size_t hi, double x, double y, EdgeSnap& snap) const
+{
+    // snap.distance holds the squared distance until nearestEdge returns
+    size_t mid = middle(lo, hi);
+    if (lo >= hi || distanceSquared(boxes_[mid], x, y) >= snap.distance)
+        return;
+
+    const CsrGraph& g = *graph_;
+    VertexId v = ids_[mid];
+    double ax = coords_[2 * mid], ay = coords_[2 * mid + 1];
+    for (CsrGraph::Arc arc : g.neighbors(v)) {
+        double bx = g.getX(arc.target), by = g.getY(arc.target);
+        double ex = bx - ax, ey = by - ay;
+        double length = ex * ex + ey * ey;
+        double t = length > 0 ? ((x - ax) * ex + (y - ay) * ey) / length : 0;
+        t = std::min(1.0, std::max(0.0, t));
+        double px = ax + t * ex, py = ay + t * ey;
+        double d = (x - px) * (x - px) + (y - py) * (y - py);
+        if (d < snap.distance) {
+            snap.from = v;
+            snap.to = arc.target;
+            snap.x = px;
+            snap.y = py;
+            snap.fraction = t;
+            snap.distance = d;
+        }
+    }
+
+    // the child whose arcs are closer first, which tightens the bound for
+    // the other
+    size_t leftMid = middle(lo, mid), rightMid = middle(mid + 1, hi);
+    double left = lo < mid ? distanceSquared(boxes_[leftMid], x, y) : snap.distance;
+    double right = mid + 1 < hi ? distanceSquared(boxes_[rightMid], x, y) : snap.distance;
+    if (left <= right) {
+        searchEdges(lo, mid, x, y, snap);
+        searchEdges(mid + 1, hi, x, y, snap);
+    } else {
+        searchEdges(mid + 1, hi, x, y, snap);
+        searchEdges(lo, mid, x, y, snap);
+    }
+}
+
+double SpatialIndex::distanceSquared(const Box& box, double x, double y)
+{
+    double dx = std::max(0.0, std::max(box.minX - x, x - box.maxX));
+    double dy = std::max(0.0, std::max(box.minY - y, y - box.maxY));
+    return dx * dx + dy * dy;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file spatialindex.h
+ * Nearest-vertex and nearest-edge lookups by coordinates.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "csrgraph.h"
+
+using std::vector;
+
+/**
+ * A 2-d tree over the vertices of a CsrGraph, for turning coordinates
+ * into vertex ids.
+ *
+ * The tree is implicit: the vertices are stored in tree order, and the
+ * root of every range is its middle element, split on x at even depths
+ * and on y at odd ones. Building it takes O(n log n) time; a lookup
+ * visits O(log n) vertices on road networks.
+ *
+ * Every node also keeps the bounding box of the arcs leaving the vertices
+ * below it, so nearestEdge() can skip subtrees whose arcs are all farther
+ * than the best segment found so far.
+ *
+ * The index keeps a pointer to the graph, which must outlive it. It never
+ * changes once built, so any number of threads may query it at once.
+ */
+class SpatialIndex
+{
+  public:
+    typedef CsrGraph::VertexId VertexId;
+
+    /** The point of an arc closest to a query point. */
+    struct EdgeSnap {
+        VertexId from;      /**< source of the arc */
+        VertexId to;        /**< target of the arc */
+        double x;           /**< the closest point of the segment */
+        double y;
+        double fraction;    /**< where it lies: 0 at from, 1 at to */
+        double distance;    /**< from the query point */
+    };
+
+    /**
+     * Creates an index of no vertices.
+     */
+    SpatialIndex();
+
+    /**
+     * Indexes the vertices and arcs of a snapshot.
+     * @param g - the snapshot; it must outlive the index
+     */
+    explicit SpatialIndex(const CsrGraph& g);
+
+    /** @return the number of vertices indexed */
+    size_t size() const { return ids_.size(); }
+
+    /**
+     * @return the id of the vertex closest to (x, y), or InvalidId if the
+     *  graph has no vertices
+     */
+    VertexId nearest(double x, double y) const;
+
+    /**
+     * Finds the k vertices closest to (x, y).
+     * @param k - the number of vertices wanted
+     * @param out - cleared and filled with min(k, size()) ids, closest first
+     */
+    void nearest(double x, double y, size_t k, vector<VertexId>& out) const;
+
+    /**
+     * Finds the arc closest to (x, y) and projects the point onto it. An
+     * undirected edge may be reported from either end.
+     * @param snap - set to the arc and the projection if one was found
+     * @return false, if the graph has no arcs
+     */
+    bool nearestEdge(double x, double y, EdgeSnap& snap) const;
+
+  private:
+    /** Bounding box of the arcs below a node. */
+    struct Box {
+        double minX, minY, maxX, maxY;
+    };
+
+    const CsrGraph* graph_;
+    vector<VertexId> ids_;      /**< vertex ids in tree order */
+    vector<double> coords_;     /**< interleaved x, y in tree order */
+    vector<Box> boxes_;         /**< box of the subtree rooted at each position */
+
+    /** Sorts ids_[lo, hi) into a subtree and fills in its boxes. */
+    void build(size_t lo, size_t hi, unsigned axis);
+
+    /** Looks for vertices closer than the farthest in best, a max-heap of at most k. */
+    void search(size_t lo, size_t hi, unsigned axis, double x, double y, size_t k,
+                vector<std::pair<double, size_t>>& best) const;
+
+    /** Looks for arcs closer than snap below the node of [lo, hi). */
+    void searchEdges(size_t lo, size_t hi, double x, double y, EdgeSnap& snap) const;
+
+    /** @return the squared distance from (x, y) to a box */
+    static double distanceSquared(const Box& box, double x, double y);
+};
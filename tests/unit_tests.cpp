@@ -1,15 +1,71 @@
 #include "../cs225/catch/catch.hpp"
 
+#include "../basemap.h"
 #include "../edge.h"
+#include "../edgetree.h"
 #include "../random.h"
 #include "../graph.h"
 #include "../search.h"
+#include "../csvparser.h"
+#include "../compressedgraph.h"
+#include "../contractionhierarchy.h"
+#include "../landmarks.h"
+#include "../spatialindex.h"
+#include "../tilepyramid.h"
+#include "../vertexorder.h"
+#include "../cs225/PNGEncoder.h"
+#include "../cs225/lodepng/lodepng.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <queue>
+#include <random>
+#include <set>
 #include <string>
 #include <fstream>
+#include <thread>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
+// Counts every heap allocation made by the test program.
+static std::atomic<size_t> allocations(0);
+
+void* operator new(std::size_t size) {
+  allocations++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// A new empty directory for files a test writes, outside the source tree.
+static string makeTempDirectory() {
+  char name[] = "/tmp/finalproj-test-XXXXXX";
+  return mkdtemp(name) != NULL ? string(name) : string();
+}
+
+// Removes a directory and everything in it.
+static bool removeDirectory(const string& directory) {
+  auto remove = [](const char* path, const struct stat*, int, struct FTW*) { return std::remove(path); };
+  return nftw(directory.c_str(), remove, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
 std::ifstream connections;
 std::ifstream vertices;
 Graph graph(true, false);
@@ -160,4 +216,1498 @@ TEST_CASE("Test search methods on graph from file") {
 
   REQUIRE(search.BFS(start, end) == correct);
   REQUIRE(search.astar(start, end) != correct);
-}
\ No newline at end of file
+}
+TEST_CASE("Frozen snapshot matches the graph") {
+  Graph g("tests/test_connections.csv", "tests/test_vertices.csv", true);
+  CsrGraph csr = g.freeze();
+
+  REQUIRE(csr.numVertices() == 6);
+  REQUIRE(csr.numArcs() == 2 * g.getEdges().size());
+
+  vector<Vertex> vertices = g.getVertices();
+  for (size_t i = 0; i < vertices.size(); i++) {
+    CsrGraph::VertexId id = csr.getId(vertices[i]);
+    REQUIRE(id == i);
+    REQUIRE(csr.getVertex(id) == vertices[i]);
+
+    vector<Vertex> adjacent = g.getAdjacent(vertices[i]);
+    REQUIRE(csr.arcEnd(id) - csr.arcBegin(id) == adjacent.size());
+    for (uint32_t arc = csr.arcBegin(id); arc < csr.arcEnd(id); arc++) {
+      Vertex neighbor = csr.getVertex(csr.target(arc));
+      REQUIRE(neighbor == adjacent[arc - csr.arcBegin(id)]);
+      REQUIRE(csr.weight(arc) == g.getEdgeWeight(vertices[i], neighbor));
+    }
+  }
+  REQUIRE(csr.getId(Vertex(42)) == CsrGraph::InvalidId);
+
+  Search graphSearch(g);
+  Search csrSearch(csr);
+  // a search keeps the snapshot it was given alive
+  Search temporarySearch(g.freeze());
+  for (Vertex start : vertices) {
+    for (Vertex end : vertices) {
+      REQUIRE(graphSearch.BFS(start, end) == csrSearch.BFS(start, end));
+      REQUIRE(graphSearch.astar(start, end) == csrSearch.astar(start, end));
+      REQUIRE(temporarySearch.astar(start, end) == csrSearch.astar(start, end));
+    }
+  }
+}
+
+TEST_CASE("CSV parser reads files in place without allocating") {
+  MappedFile vertexFile("sampledata/vertices_test_data.csv");
+  MappedFile connectionsFile("sampledata/oldenburg_road_network.csv");
+  REQUIRE(vertexFile.isOpen());
+  REQUIRE(connectionsFile.isOpen());
+
+  vector<VertexRecord> vertexRows;
+  vector<ConnectionRecord> connectionRows;
+  vertexRows.reserve(csv::countLines(vertexFile.begin(), vertexFile.end()));
+  connectionRows.reserve(csv::countLines(connectionsFile.begin(), connectionsFile.end()));
+
+  size_t malformed = 0;
+  size_t before = allocations;
+  const char* begin = csv::skipBom(vertexFile.begin(), vertexFile.end());
+  csv::forEachRow<VertexRecord>(begin, vertexFile.end(),
+      [&](const VertexRecord& r) { vertexRows.push_back(r); }, &malformed);
+  begin = csv::skipBom(connectionsFile.begin(), connectionsFile.end());
+  csv::forEachRow<ConnectionRecord>(begin, connectionsFile.end(),
+      [&](const ConnectionRecord& r) { connectionRows.push_back(r); }, &malformed);
+  REQUIRE(allocations == before);
+  REQUIRE(malformed == 0);
+
+  SECTION("Byte order mark is skipped") {
+    REQUIRE(vertexRows.size() == 19);
+    REQUIRE(vertexRows[0].index == 0);
+    REQUIRE(vertexRows[0].x == 1000);
+    REQUIRE(vertexRows[0].y == 592);
+    REQUIRE(vertexRows[18].index == 18);
+    REQUIRE(vertexRows[18].x == 8000);
+  }
+
+  SECTION("Fractional weights are kept") {
+    REQUIRE(connectionRows.size() == 7035);
+    REQUIRE(connectionRows[0].first == 1609);
+    REQUIRE(connectionRows[0].second == 1622);
+    REQUIRE(connectionRows[0].weight == Approx(57.403187));
+  }
+}
+
+TEST_CASE("CSV parser rejects malformed lines") {
+  const char text[] = "\xEF\xBB\xBF" "0,1,2,3.5\r\n\r\n1,2,x,4\n2,3,4\n3,4,5,6,7\n4,5,6,7";
+  const char* end = text + sizeof(text) - 1;
+  vector<ConnectionRecord> rows;
+  size_t malformed = 0;
+  csv::forEachRow<ConnectionRecord>(csv::skipBom(text, end), end,
+      [&](const ConnectionRecord& r) { rows.push_back(r); }, &malformed);
+
+  REQUIRE(rows.size() == 2);
+  REQUIRE(rows[0].weight == 3.5);
+  REQUIRE(rows[1].index == 4);
+  REQUIRE(rows[1].weight == 7);
+  REQUIRE(malformed == 3);
+}
+
+TEST_CASE("CSV parser reads exponents and negative numbers") {
+  const char text[] = "0,-1.5e3,2.5E-2\n1,-7,1e+2\r\n2, 3.25,-0.0\n3 4 5\n4,1e,2\n5,1.5 2,3";
+  const char* end = text + sizeof(text) - 1;
+  vector<VertexRecord> rows;
+  size_t malformed = 0;
+  csv::forEachRow<VertexRecord>(text, end, [&](const VertexRecord& r) { rows.push_back(r); }, &malformed);
+
+  REQUIRE(rows.size() == 3);
+  REQUIRE(rows[0].x == -1500);
+  REQUIRE(rows[0].y == 0.025);
+  REQUIRE(rows[1].x == -7);
+  REQUIRE(rows[1].y == 100);
+  REQUIRE(rows[2].x == 3.25);
+  REQUIRE(rows[2].y == 0);
+  // whitespace does not separate fields
+  REQUIRE(malformed == 3);
+
+  const char negative[] = "-3,-4,-5,-0.5e-1\n";
+  vector<ConnectionRecord> connections;
+  csv::forEachRow<ConnectionRecord>(negative, negative + sizeof(negative) - 1,
+      [&](const ConnectionRecord& r) { connections.push_back(r); });
+  REQUIRE(connections.size() == 1);
+  REQUIRE(connections[0].index == -3);
+  REQUIRE(connections[0].second == -5);
+  REQUIRE(connections[0].weight == -0.05);
+}
+
+TEST_CASE("Parallel CSV load matches the single-threaded load") {
+  Graph serial("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true, 1);
+
+  for (unsigned threads : {2u, 3u, 8u}) {
+    Graph parallel("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true, threads);
+    REQUIRE(parallel.getVertices() == serial.getVertices());
+
+    vector<Edge> serialEdges = serial.getEdges();
+    vector<Edge> parallelEdges = parallel.getEdges();
+    REQUIRE(parallelEdges == serialEdges);
+    for (size_t i = 0; i < serialEdges.size(); i++) {
+      REQUIRE(parallelEdges[i].getWeight() == serialEdges[i].getWeight());
+    }
+  }
+
+  SECTION("More threads than lines") {
+    Graph small("tests/test_connections.csv", "tests/test_vertices.csv", true, 1);
+    Graph many("tests/test_connections.csv", "tests/test_vertices.csv", true, 64);
+    REQUIRE(many.getVertices() == small.getVertices());
+    REQUIRE(many.getEdges() == small.getEdges());
+  }
+}
+
+TEST_CASE("Binary snapshot round trip") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph frozen = g.freeze();
+  REQUIRE(frozen.writeToFile("test_snapshot.csrg"));
+
+  CsrGraph mapped;
+  REQUIRE(mapped.readFromFile("test_snapshot.csrg"));
+  std::remove("test_snapshot.csrg");
+
+  REQUIRE(mapped.numVertices() == frozen.numVertices());
+  REQUIRE(mapped.numArcs() == frozen.numArcs());
+  REQUIRE(mapped.isWeighted());
+  REQUIRE(!mapped.isDirected());
+  for (CsrGraph::VertexId v = 0; v < frozen.numVertices(); v++) {
+    REQUIRE(mapped.getVertex(v) == frozen.getVertex(v));
+    REQUIRE(mapped.getId(frozen.getVertex(v)) == v);
+    REQUIRE(mapped.arcBegin(v) == frozen.arcBegin(v));
+    REQUIRE(mapped.arcEnd(v) == frozen.arcEnd(v));
+  }
+  for (uint32_t arc = 0; arc < frozen.numArcs(); arc++) {
+    REQUIRE(mapped.target(arc) == frozen.target(arc));
+    REQUIRE(mapped.weight(arc) == frozen.weight(arc));
+  }
+
+  Search search(mapped);
+  Search reference(frozen);
+  REQUIRE(search.astar(frozen.getVertex(0), frozen.getVertex(516))
+          == reference.astar(frozen.getVertex(0), frozen.getVertex(516)));
+
+  SECTION("Other files are rejected") {
+    CsrGraph bad;
+    REQUIRE(!bad.readFromFile("tests/test_vertices.csv"));
+    REQUIRE(!bad.readFromFile("does_not_exist.csrg"));
+    REQUIRE(bad.numVertices() == 0);
+  }
+
+  SECTION("Snapshots with out of range arrays are rejected") {
+    REQUIRE(frozen.writeToFile("test_snapshot.csrg"));
+    std::ifstream in("test_snapshot.csrg", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    // the header's section table starts at byte 48: Offsets, Targets, ...
+    uint64_t offsets = 0, targets = 0;
+    memcpy(&offsets, bytes.data() + 48, sizeof(offsets));
+    memcpy(&targets, bytes.data() + 56, sizeof(targets));
+    uint32_t outside = frozen.numVertices();
+    uint32_t past = (uint32_t) frozen.numArcs();
+
+    std::string badTarget = bytes;
+    memcpy(&badTarget[targets + 4 * 10], &outside, sizeof(outside));
+    std::string badOffset = bytes;
+    memcpy(&badOffset[offsets + 4 * 5], &past, sizeof(past));
+    for (const std::string& corrupt : {badTarget, badOffset}) {
+      std::ofstream("test_snapshot.csrg", std::ios::binary | std::ios::trunc) << corrupt;
+      CsrGraph bad;
+      REQUIRE(!bad.readFromFile("test_snapshot.csrg"));
+      REQUIRE(bad.numVertices() == 0);
+    }
+    std::remove("test_snapshot.csrg");
+  }
+
+  SECTION("Rewriting a snapshot leaves existing mappings intact") {
+    REQUIRE(frozen.writeToFile("test_snapshot.csrg"));
+    CsrGraph before;
+    REQUIRE(before.readFromFile("test_snapshot.csrg"));
+    vector<CsrGraph::VertexId> order(frozen.numVertices());
+    for (CsrGraph::VertexId v = 0; v < order.size(); v++) order[v] = order.size() - 1 - v;
+    REQUIRE(frozen.permuted(order).writeToFile("test_snapshot.csrg"));
+
+    for (CsrGraph::VertexId v = 0; v < frozen.numVertices(); v++) REQUIRE(before.getVertex(v) == frozen.getVertex(v));
+    CsrGraph after;
+    REQUIRE(after.readFromFile("test_snapshot.csrg"));
+    REQUIRE(after.getVertex(0) == frozen.getVertex(order[0]));
+    std::remove("test_snapshot.csrg");
+  }
+
+  SECTION("Writers of one snapshot never mix their files") {
+    string directory = makeTempDirectory();
+    string file = directory + "/snapshot.csrg";
+    vector<CsrGraph::VertexId> order(frozen.numVertices());
+    for (CsrGraph::VertexId v = 0; v < order.size(); v++) order[v] = order.size() - 1 - v;
+    const CsrGraph versions[2] = {frozen, frozen.permuted(order)};
+    std::atomic<int> failures(0);
+    vector<std::thread> writers;
+    for (int w = 0; w < 4; w++) {
+      writers.push_back(std::thread([&, w]() {
+        for (int i = 0; i < 5; i++) failures += !versions[(w + i) % 2].writeToFile(file);
+      }));
+    }
+    for (std::thread& writer : writers) writer.join();
+    REQUIRE(failures == 0);
+
+    CsrGraph written;
+    REQUIRE(written.readFromFile(file));
+    bool matches[2] = {true, true};
+    for (int k = 0; k < 2; k++) {
+      for (CsrGraph::VertexId v = 0; v < written.numVertices(); v++) {
+        matches[k] = matches[k] && written.getVertex(v) == versions[k].getVertex(v)
+                     && written.arcEnd(v) == versions[k].arcEnd(v);
+      }
+      for (uint32_t arc = 0; arc < written.numArcs(); arc++)
+        matches[k] = matches[k] && written.target(arc) == versions[k].target(arc);
+    }
+    REQUIRE(matches[0] != matches[1]);
+    // and no temporary file is left behind
+    REQUIRE(std::remove(file.c_str()) == 0);
+    REQUIRE(rmdir(directory.c_str()) == 0);
+  }
+}
+
+TEST_CASE("Reused search workspace does not allocate") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  Search search(csr);
+  SearchWorkspace workspace;
+  vector<CsrGraph::VertexId> path;
+  vector<CsrGraph::VertexId> fresh;
+
+  auto queries = [&]() {
+    for (CsrGraph::VertexId end = 1; end < 200; end++) {
+      search.astar(0, end, workspace, path);
+      search.BFS(end, 0, workspace, path);
+    }
+  };
+
+  // warm up: the first pass grows the arrays, queue, heap and path
+  queries();
+  size_t before = allocations;
+  queries();
+  REQUIRE(allocations == before);
+
+  for (CsrGraph::VertexId end = 1; end < 200; end += 37) {
+    SearchWorkspace once;
+    REQUIRE(search.astar(0, end, workspace, path) == search.astar(0, end, once, fresh));
+    REQUIRE(path == fresh);
+    REQUIRE(workspace.reachedCount() == once.reachedCount());
+  }
+}
+
+TEST_CASE("Search sees changes to its graph") {
+  Graph g(true, false);
+  Vertex a(0, 0, 0), b(1, 0, 10), c(2, 10, 10);
+  g.insertEdge(a, b);
+  g.insertEdge(b, c);
+  Search search(g);
+  REQUIRE(search.BFS(a, c).size() == 3);
+
+  g.insertEdge(a, c);
+  REQUIRE(search.BFS(a, c).size() == 2);
+
+  g.removeEdge(a, c);
+  g.removeEdge(b, c);
+  REQUIRE(search.BFS(a, c).empty());
+}
+
+TEST_CASE("Indexed heap orders keys and lowers them in place") {
+  IndexedHeap<> heap;
+  heap.resize(10);
+  double keys[] = {5, 3, 9, 1, 7, 8, 2, 6, 4, 0};
+  for (uint32_t v = 0; v < 10; v++) heap.push(v, keys[v]);
+  REQUIRE(heap.contains(2));
+
+  heap.decreaseKey(2, -1);
+  heap.decreaseKey(4, 2.5);
+  vector<uint32_t> order;
+  while (!heap.empty()) order.push_back(heap.pop().vertex);
+  REQUIRE(order == vector<uint32_t>({2, 9, 3, 6, 4, 1, 8, 0, 7, 5}));
+  REQUIRE(!heap.contains(2));
+}
+
+TEST_CASE("astar finds the cheaper path to an already queued vertex") {
+  Graph graph(true, false);
+  Vertex a(0, 0, 0), b(1, 1, 0), t(2, 2, 0);
+  graph.insertEdge(a, t);
+  graph.setEdgeWeight(a, t, 10);
+  graph.insertEdge(a, b);
+  graph.setEdgeWeight(a, b, 1.25);
+  graph.insertEdge(b, t);
+  graph.setEdgeWeight(b, t, 1.25);
+  REQUIRE(graph.getEdgeWeight(a, b) == 1.25);
+
+  Search search(graph);
+  REQUIRE(search.astar(a, t) == vector<Vertex>({a, b, t}));
+}
+
+TEST_CASE("astar matches Dijkstra on the Oldenburg graph") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  Search search(csr);
+  SearchWorkspace workspace;
+  vector<CsrGraph::VertexId> path;
+
+  auto pathCost = [&](const vector<CsrGraph::VertexId>& p) {
+    double cost = 0;
+    for (size_t i = 1; i < p.size(); i++) {
+      double best = std::numeric_limits<double>::infinity();
+      for (uint32_t arc = csr.arcBegin(p[i - 1]); arc < csr.arcEnd(p[i - 1]); arc++) {
+        if (csr.target(arc) == p[i]) best = std::min(best, csr.weight(arc));
+      }
+      cost += best;
+    }
+    return cost;
+  };
+
+  // plain Dijkstra from a few sources as the reference
+  for (CsrGraph::VertexId source : {0u, 516u, 3000u}) {
+    typedef std::pair<double, CsrGraph::VertexId> Item;
+    vector<double> dist(csr.numVertices(), std::numeric_limits<double>::infinity());
+    std::priority_queue<Item, vector<Item>, std::greater<Item>> queue;
+    dist[source] = 0;
+    queue.push(Item(0, source));
+    while (!queue.empty()) {
+      Item top = queue.top();
+      queue.pop();
+      if (top.first > dist[top.second]) continue;
+      for (uint32_t arc = csr.arcBegin(top.second); arc < csr.arcEnd(top.second); arc++) {
+        double d = top.first + csr.weight(arc);
+        if (d < dist[csr.target(arc)]) {
+          dist[csr.target(arc)] = d;
+          queue.push(Item(d, csr.target(arc)));
+        }
+      }
+    }
+
+    for (CsrGraph::VertexId target = 0; target < csr.numVertices(); target += 97) {
+      bool reachable = !std::isinf(dist[target]);
+      REQUIRE(search.astar(source, target, workspace, path) == reachable);
+      if (!reachable) continue;
+      REQUIRE(path.front() == source);
+      REQUIRE(path.back() == target);
+      REQUIRE(pathCost(path) == Approx(dist[target]));
+      REQUIRE(workspace.distance(target) == Approx(dist[target]));
+
+      REQUIRE(search.astar(source, target, workspace, path, Search::LazyDeletion));
+      REQUIRE(pathCost(path) == Approx(dist[target]));
+    }
+  }
+}
+
+TEST_CASE("Bidirectional searches find shortest paths") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  Search search(csr);
+  SearchWorkspace workspace, forward, backward;
+  vector<CsrGraph::VertexId> expected, path;
+
+  std::mt19937 rng(8);
+  for (int i = 0; i < 100; i++) {
+    CsrGraph::VertexId s = rng() % csr.numVertices(), t = rng() % csr.numVertices();
+    bool reachable = search.astar(s, t, workspace, expected);
+    double cost = workspace.distance(t);
+
+    REQUIRE(search.bidirectionalDijkstra(s, t, forward, backward, path) == reachable);
+    if (reachable) {
+      REQUIRE(path.front() == s);
+      REQUIRE(path.back() == t);
+      double total = 0;
+      for (size_t k = 1; k < path.size(); k++) total += g.getEdgeWeight(csr.getVertex(path[k - 1]), csr.getVertex(path[k]));
+      REQUIRE(total == Approx(cost));
+    }
+
+    REQUIRE(search.bidirectionalAstar(s, t, forward, backward, path) == reachable);
+    if (reachable) {
+      REQUIRE(path.front() == s);
+      REQUIRE(path.back() == t);
+      double total = 0;
+      for (size_t k = 1; k < path.size(); k++) total += g.getEdgeWeight(csr.getVertex(path[k - 1]), csr.getVertex(path[k]));
+      REQUIRE(total == Approx(cost));
+    }
+  }
+
+  REQUIRE(search.bidirectionalAstar(7, 7, forward, backward, path));
+  REQUIRE(path == vector<CsrGraph::VertexId>({7}));
+}
+
+TEST_CASE("Bidirectional search follows one-way edges") {
+  Graph g(true, true);
+  Vertex a(0, 0, 0), b(1, 10, 0), c(2, 10, 10), d(3, 0, 10);
+  g.insertEdge(a, b);
+  g.setEdgeWeight(a, b, 10);
+  g.insertEdge(b, c);
+  g.setEdgeWeight(b, c, 10);
+  g.insertEdge(c, d);
+  g.setEdgeWeight(c, d, 10);
+  g.insertEdge(d, a);
+  g.setEdgeWeight(d, a, 10);
+
+  Search search(g);
+  REQUIRE(search.bidirectionalDijkstra(a, d) == vector<Vertex>({a, b, c, d}));
+  REQUIRE(search.bidirectionalAstar(d, c) == vector<Vertex>({d, a, b, c}));
+  REQUIRE(search.astar(d, c) == vector<Vertex>({d, a, b, c}));
+
+  g.removeEdge(d, a);
+  REQUIRE(search.bidirectionalAstar(d, c).empty());
+}
+
+TEST_CASE("Contraction hierarchy matches astar") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  ContractionHierarchy serial(csr, 1);
+  ContractionHierarchy parallel(csr, 4);
+  REQUIRE(serial.numVertices() == csr.numVertices());
+  REQUIRE(serial.numShortcuts() > 0);
+
+  Search search(csr);
+  SearchWorkspace workspace, forward, backward;
+  vector<CsrGraph::VertexId> expected, path;
+  std::mt19937 rng(9);
+  for (int i = 0; i < 200; i++) {
+    CsrGraph::VertexId s = rng() % csr.numVertices(), t = rng() % csr.numVertices();
+    bool reachable = search.astar(s, t, workspace, expected);
+    double cost = -1;
+    for (const ContractionHierarchy* ch : {&serial, &parallel}) {
+      REQUIRE(ch->query(s, t, forward, backward, path, &cost) == reachable);
+      if (!reachable) continue;
+      REQUIRE(cost == Approx(workspace.distance(t)));
+
+      // the unpacked path is made of original arcs
+      REQUIRE(path.front() == s);
+      REQUIRE(path.back() == t);
+      double total = 0;
+      for (size_t k = 1; k < path.size(); k++) {
+        double weight = g.getEdgeWeight(csr.getVertex(path[k - 1]), csr.getVertex(path[k]));
+        REQUIRE(weight != Graph::InvalidWeight);
+        total += weight;
+      }
+      REQUIRE(total == Approx(cost));
+    }
+  }
+
+  SECTION("Saved hierarchies answer the same queries") {
+    REQUIRE(serial.writeToFile("test_hierarchy.ch"));
+    ContractionHierarchy mapped;
+    REQUIRE(!mapped.readFromFile("test_hierarchy.ch", CsrGraph()));
+    REQUIRE(mapped.readFromFile("test_hierarchy.ch", csr));
+    std::remove("test_hierarchy.ch");
+
+    REQUIRE(mapped.numArcs() == serial.numArcs());
+    Vertex start = csr.getVertex(0), end = csr.getVertex(516);
+    REQUIRE(mapped.shortestPath(start, end) == serial.shortestPath(start, end));
+    REQUIRE(mapped.shortestPath(start, end) == search.astar(start, end));
+  }
+
+  SECTION("Hierarchies with out of range arrays are rejected") {
+    REQUIRE(serial.writeToFile("test_hierarchy.ch"));
+    std::ifstream in("test_hierarchy.ch", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    // the header's section table starts at byte 56: Ranks, UpOffsets, UpTargets, ...
+    uint64_t ranks = 0, upTargets = 0;
+    memcpy(&ranks, bytes.data() + 56, sizeof(ranks));
+    memcpy(&upTargets, bytes.data() + 72, sizeof(upTargets));
+    uint32_t outside = csr.numVertices();
+
+    std::string repeatedRank = bytes;
+    memcpy(&repeatedRank[ranks + 4], &repeatedRank[ranks], 4);
+    std::string badTarget = bytes;
+    memcpy(&badTarget[upTargets], &outside, sizeof(outside));
+    for (const std::string& corrupt : {repeatedRank, badTarget}) {
+      std::ofstream("test_hierarchy.ch", std::ios::binary | std::ios::trunc) << corrupt;
+      ContractionHierarchy bad;
+      REQUIRE(!bad.readFromFile("test_hierarchy.ch", csr));
+    }
+    std::remove("test_hierarchy.ch");
+  }
+
+  SECTION("Writers of one hierarchy never mix their files") {
+    string directory = makeTempDirectory();
+    string file = directory + "/hierarchy.ch";
+    std::atomic<int> failures(0);
+    vector<std::thread> writers;
+    for (int w = 0; w < 4; w++) {
+      writers.push_back(std::thread([&, w]() {
+        for (int i = 0; i < 5; i++) failures += !((w + i) % 2 ? parallel : serial).writeToFile(file);
+      }));
+    }
+    for (std::thread& writer : writers) writer.join();
+    REQUIRE(failures == 0);
+
+    ContractionHierarchy mapped;
+    REQUIRE(mapped.readFromFile(file, csr));
+    REQUIRE((mapped.numArcs() == serial.numArcs() || mapped.numArcs() == parallel.numArcs()));
+    Vertex start = csr.getVertex(0), end = csr.getVertex(516);
+    REQUIRE(mapped.shortestPath(start, end) == search.astar(start, end));
+    // and no temporary file is left behind
+    REQUIRE(std::remove(file.c_str()) == 0);
+    REQUIRE(rmdir(directory.c_str()) == 0);
+  }
+}
+
+TEST_CASE("Contraction hierarchy on a one-way graph") {
+  Graph g(true, true);
+  vector<Vertex> ring;
+  for (int i = 0; i < 8; i++) ring.push_back(Vertex(i, 10 * (i % 4), 10 * (i / 4)));
+  for (int i = 0; i < 8; i++) {
+    g.insertEdge(ring[i], ring[(i + 1) % 8]);
+    g.setEdgeWeight(ring[i], ring[(i + 1) % 8], 10);
+  }
+  ContractionHierarchy ch(g.freeze());
+
+  vector<Vertex> path = ch.shortestPath(ring[5], ring[2]);
+  REQUIRE(path == vector<Vertex>({ring[5], ring[6], ring[7], ring[0], ring[1], ring[2]}));
+  REQUIRE(ch.shortestPath(ring[3], ring[3]) == vector<Vertex>({ring[3]}));
+}
+
+TEST_CASE("ALT astar finds shortest paths with fewer settled vertices") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  Search euclidean(csr), alt(csr);
+  for (Landmarks::Strategy strategy : {Landmarks::Farthest, Landmarks::Avoid}) {
+    Landmarks landmarks(csr, 8, strategy, 3);
+    REQUIRE(landmarks.count() == 8);
+    REQUIRE(landmarks.memoryUsage() == csr.numVertices() * 8 * sizeof(double));
+    alt.setLandmarks(&landmarks);
+
+    SearchWorkspace expectedSpace, workspace;
+    vector<CsrGraph::VertexId> expected, path;
+    size_t euclideanSettled = 0, altSettled = 0;
+    std::mt19937 rng(5);
+    for (int i = 0; i < 200; i++) {
+      CsrGraph::VertexId s = rng() % csr.numVertices(), t = rng() % csr.numVertices();
+      bool reachable = euclidean.astar(s, t, expectedSpace, expected);
+      REQUIRE(alt.astar(s, t, workspace, path) == reachable);
+      euclideanSettled += expectedSpace.settledCount();
+      altSettled += workspace.settledCount();
+      if (!reachable) continue;
+      REQUIRE(landmarks.lowerBound(s, t) <= expectedSpace.distance(t));
+      REQUIRE(workspace.distance(t) == Approx(expectedSpace.distance(t)));
+
+      // consistent: the bound drops by at most the weight of any arc
+      for (CsrGraph::VertexId u = 0; u < csr.numVertices(); u += 97) {
+        for (uint32_t arc = csr.arcBegin(u); arc < csr.arcEnd(u); arc++)
+          REQUIRE(landmarks.lowerBound(u, t) <= csr.weight(arc) + landmarks.lowerBound(csr.target(arc), t) + 1e-9);
+      }
+    }
+    REQUIRE(altSettled < euclideanSettled);
+  }
+}
+
+TEST_CASE("ALT follows one-way edges") {
+  Graph g(true, true);
+  vector<Vertex> ring;
+  for (int i = 0; i < 8; i++) ring.push_back(Vertex(i, 10 * (i % 4), 10 * (i / 4)));
+  for (int i = 0; i < 8; i++) {
+    g.insertEdge(ring[i], ring[(i + 1) % 8]);
+    g.setEdgeWeight(ring[i], ring[(i + 1) % 8], 10);
+  }
+  Search search(g);
+  Landmarks landmarks(search.snapshot(), 2);
+  search.setLandmarks(&landmarks);
+
+  CsrGraph::VertexId from = search.snapshot().getId(ring[5]);
+  CsrGraph::VertexId to = search.snapshot().getId(ring[2]);
+  REQUIRE(landmarks.lowerBound(from, to) <= 50);
+  REQUIRE(landmarks.lowerBound(to, from) <= 30);
+
+  vector<Vertex> path({ring[5], ring[6], ring[7], ring[0], ring[1], ring[2]});
+  REQUIRE(search.astar(ring[5], ring[2]) == path);
+  REQUIRE(search.bidirectionalAstar(ring[5], ring[2]) == path);
+}
+
+TEST_CASE("Batched queries match single queries in input order") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+  Search search(csr);
+
+  std::mt19937 rng(11);
+  vector<Search::Query> queries;
+  for (int i = 0; i < 300; i++) {
+    Search::Query query = {(CsrGraph::VertexId) (rng() % csr.numVertices()),
+                           (CsrGraph::VertexId) (rng() % csr.numVertices())};
+    queries.push_back(query);
+  }
+  Search::Query unknown = {0, CsrGraph::InvalidId};
+  queries.push_back(unknown);
+
+  vector<Search::QueryResult> results;
+  SearchWorkspace workspace;
+  vector<CsrGraph::VertexId> path;
+  for (unsigned threads : {1u, 4u}) {
+    search.batch(queries, results, threads);
+    REQUIRE(results.size() == queries.size());
+    for (size_t i = 0; i + 1 < queries.size(); i++) {
+      bool reachable = search.astar(queries[i].source, queries[i].target, workspace, path);
+      REQUIRE(results[i].path == path);
+      if (reachable) REQUIRE(results[i].cost == workspace.distance(queries[i].target));
+      else REQUIRE(std::isinf(results[i].cost));
+      REQUIRE(results[i].seconds >= 0);
+    }
+    REQUIRE(results.back().path.empty());
+    REQUIRE(std::isinf(results.back().cost));
+  }
+}
+
+TEST_CASE("CSV parser reads query files") {
+  const char text[] = "0,516\r\n\r\n7,x\n12,3\n";
+  const char* end = text + sizeof(text) - 1;
+  vector<QueryRecord> rows;
+  size_t malformed = 0;
+  csv::forEachRow<QueryRecord>(text, end, [&](const QueryRecord& r) { rows.push_back(r); }, &malformed);
+
+  REQUIRE(rows.size() == 2);
+  REQUIRE(rows[0].source == 0);
+  REQUIRE(rows[0].target == 516);
+  REQUIRE(rows[1].source == 12);
+  REQUIRE(malformed == 1);
+}
+
+TEST_CASE("Concurrent readers of one Graph see the same answers") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  vector<Vertex> vertices = g.getVertices();
+  size_t before = g.getVersion();
+
+  std::mt19937 rng(13);
+  vector<std::pair<Vertex, Vertex>> pairs;
+  for (int i = 0; i < 40; i++)
+    pairs.push_back(std::make_pair(vertices[rng() % vertices.size()], vertices[rng() % vertices.size()]));
+
+  Search serial(g);
+  vector<vector<Vertex>> expected;
+  for (const auto& p : pairs) expected.push_back(serial.astar(p.first, p.second));
+
+  const int threads = 4;
+  vector<int> mismatches(threads, 0);
+  vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      // every thread has its own Search, which takes its own snapshot
+      Search search(g);
+      for (size_t i = t; i < pairs.size(); i += threads) {
+        if (search.astar(pairs[i].first, pairs[i].second) != expected[i]) mismatches[t]++;
+      }
+      for (size_t i = 0; i < vertices.size(); i += threads) {
+        Vertex v = vertices[(i + t) % vertices.size()];
+        for (Vertex w : g.getAdjacent(v)) {
+          if (!g.edgeExists(v, w) || g.getEdgeWeight(v, w) != g.getEdgeWeight(w, v)) mismatches[t]++;
+          if (g.getEdgeLabel(v, w) != g.getEdge(w, v).getLabel()) mismatches[t]++;
+        }
+        if (g.edgeExists(v, Vertex(-7)) || g.vertexExists(Vertex(-7))) mismatches[t]++;
+      }
+    }));
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  for (int t = 0; t < threads; t++) REQUIRE(mismatches[t] == 0);
+  REQUIRE(g.getVersion() == before);
+  REQUIRE(g.getVertices().size() == vertices.size());
+}
+
+TEST_CASE("Vertex and edge ranges walk the graph without copying") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph csr = g.freeze();
+
+  size_t before = allocations;
+  size_t vertexCount = 0, neighborCount = 0, edgeCount = 0, arcCount = 0;
+  double edgeWeight = 0, neighborWeight = 0, arcWeight = 0;
+  for (const Vertex& v : g.vertices()) {
+    vertexCount++;
+    for (const auto& neighbor : g.neighbors(v)) {
+      neighborCount++;
+      neighborWeight += neighbor.second.getWeight();
+    }
+  }
+  for (const Edge& e : g.edges()) {
+    edgeCount++;
+    edgeWeight += e.getWeight();
+  }
+  for (CsrGraph::VertexId u = 0; u < csr.numVertices(); u++) {
+    for (CsrGraph::Arc arc : csr.neighbors(u)) {
+      arcCount++;
+      arcWeight += arc.weight;
+    }
+  }
+  REQUIRE(allocations == before);
+
+  REQUIRE(g.vertices().size() == vertexCount);
+  REQUIRE(vertexCount == g.getVertices().size());
+  REQUIRE(edgeCount == g.getEdges().size());
+  REQUIRE(neighborCount == 2 * edgeCount);
+  REQUIRE(arcCount == csr.numArcs());
+  REQUIRE(neighborWeight == Approx(2 * edgeWeight));
+  REQUIRE(arcWeight == Approx(neighborWeight));
+  REQUIRE(g.neighbors(Vertex(-5)).empty());
+
+  vector<Vertex> vertices = g.getVertices();
+  for (size_t i = 0; i < vertices.size(); i += 97) {
+    vector<Vertex> adjacent;
+    for (const auto& neighbor : g.neighbors(vertices[i])) adjacent.push_back(neighbor.first);
+    REQUIRE(adjacent == g.getAdjacent(vertices[i]));
+  }
+
+  Graph oneWay(true, true);
+  oneWay.insertEdge(Vertex(0), Vertex(1));
+  oneWay.insertEdge(Vertex(1), Vertex(0));
+  oneWay.insertEdge(Vertex(1), Vertex(2));
+  REQUIRE(oneWay.edges().size() == 3);
+}
+
+TEST_CASE("Reordered snapshots answer the same queries") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph base = g.freeze();
+  Search baseSearch(base);
+  vector<Vertex> vertices = g.getVertices();
+
+  for (vertexorder::Ordering ordering : {vertexorder::Hilbert, vertexorder::BreadthFirst,
+                                         vertexorder::ReverseCuthillMcKee}) {
+    vector<CsrGraph::VertexId> order = vertexorder::compute(base, ordering);
+    vector<CsrGraph::VertexId> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    for (CsrGraph::VertexId i = 0; i < sorted.size(); i++) REQUIRE(sorted[i] == i);
+
+    CsrGraph g2 = base.permuted(order);
+    vector<CsrGraph::VertexId> position = vertexorder::inverse(order);
+    REQUIRE(g2.numVertices() == base.numVertices());
+    REQUIRE(g2.numArcs() == base.numArcs());
+    for (CsrGraph::VertexId v = 0; v < base.numVertices(); v++) {
+      REQUIRE(g2.getVertex(position[v]) == base.getVertex(v));
+      REQUIRE(g2.getId(base.getVertex(v)) == position[v]);
+    }
+
+    vertexorder::Ordering parsed;
+    REQUIRE(vertexorder::parse(vertexorder::name(ordering), parsed));
+    REQUIRE(parsed == ordering);
+
+    Search search(g2);
+    std::mt19937 rng(17);
+    for (int i = 0; i < 50; i++) {
+      Vertex s = vertices[rng() % vertices.size()], t = vertices[rng() % vertices.size()];
+      vector<Vertex> expected = baseSearch.astar(s, t);
+      vector<Vertex> path = search.astar(s, t);
+      REQUIRE(path.size() > 0);
+      REQUIRE(path.front() == expected.front());
+      REQUIRE(path.back() == expected.back());
+      double expectedCost = 0, cost = 0;
+      for (size_t k = 0; k + 1 < expected.size(); k++) expectedCost += g.getEdgeWeight(expected[k], expected[k + 1]);
+      for (size_t k = 0; k + 1 < path.size(); k++) cost += g.getEdgeWeight(path[k], path[k + 1]);
+      REQUIRE(cost == Approx(expectedCost));
+    }
+  }
+}
+
+TEST_CASE("Compressed graph decodes its arcs and answers the same queries") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph base = g.freeze();
+  CsrGraph ordered = base.permuted(vertexorder::hilbert(base));
+  Search search(ordered);
+  SearchWorkspace expectedWorkspace, workspace;
+  vector<CsrGraph::VertexId> expectedPath, path;
+
+  for (CompressedGraph::WeightBits bits : {CompressedGraph::Weight32, CompressedGraph::Weight16}) {
+    CompressedGraph compressed(ordered, bits);
+    REQUIRE(compressed.numVertices() == ordered.numVertices());
+    REQUIRE(compressed.numArcs() == ordered.numArcs());
+    REQUIRE(compressed.arcBytes() < ordered.numArcs() * (sizeof(CsrGraph::VertexId) + sizeof(double)));
+
+    for (CsrGraph::VertexId u = 0; u < ordered.numVertices(); u++) {
+      REQUIRE(compressed.getVertex(u) == ordered.getVertex(u));
+      vector<CsrGraph::Arc> expected, arcs;
+      for (CsrGraph::Arc arc : ordered.neighbors(u)) expected.push_back(arc);
+      for (CsrGraph::Arc arc : compressed.neighbors(u)) arcs.push_back(arc);
+      REQUIRE(arcs.size() == compressed.neighbors(u).size());
+      REQUIRE(arcs.size() == expected.size());
+      // parallel arcs may come in any order; rounding weights keeps their order
+      auto byTargetAndWeight = [](const CsrGraph::Arc& a, const CsrGraph::Arc& b) {
+        return a.target != b.target ? a.target < b.target : a.weight < b.weight;
+      };
+      std::sort(expected.begin(), expected.end(), byTargetAndWeight);
+      std::sort(arcs.begin(), arcs.end(), byTargetAndWeight);
+      for (size_t i = 0; i < arcs.size(); i++) {
+        REQUIRE(arcs[i].target == expected[i].target);
+        REQUIRE(std::abs(arcs[i].weight - expected[i].weight) <= compressed.weightScale() / 2 + 1e-9);
+      }
+    }
+
+    std::mt19937 rng(31);
+    for (int i = 0; i < 50; i++) {
+      CsrGraph::VertexId s = rng() % ordered.numVertices(), t = rng() % ordered.numVertices();
+      bool expectedFound = search.astar(s, t, expectedWorkspace, expectedPath);
+      REQUIRE(compressed.astar(s, t, workspace, path) == expectedFound);
+      if (!expectedFound) continue;
+      REQUIRE(path.front() == s);
+      REQUIRE(path.back() == t);
+      double expectedCost = expectedWorkspace.distance(t);
+      REQUIRE(workspace.distance(t) == Approx(expectedCost).epsilon(1e-3));
+    }
+  }
+
+  CompressedGraph empty;
+  REQUIRE(empty.numVertices() == 0);
+  REQUIRE(empty.memoryUsage() > 0);
+}
+
+TEST_CASE("Spatial index snaps coordinates like a linear scan") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  CsrGraph snapshot = g.freeze();
+  SpatialIndex index(snapshot);
+  REQUIRE(index.size() == snapshot.numVertices());
+
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> xs(-500, 11000), ys(-500, 11000);
+  vector<CsrGraph::VertexId> near;
+  for (int i = 0; i < 200; i++) {
+    double x = xs(rng), y = ys(rng);
+    vector<std::pair<double, CsrGraph::VertexId>> all;
+    for (CsrGraph::VertexId v = 0; v < snapshot.numVertices(); v++) {
+      all.push_back(std::make_pair(std::hypot(snapshot.getX(v) - x, snapshot.getY(v) - y), v));
+    }
+    std::sort(all.begin(), all.end());
+
+    CsrGraph::VertexId nearest = index.nearest(x, y);
+    REQUIRE(std::hypot(snapshot.getX(nearest) - x, snapshot.getY(nearest) - y) == all[0].first);
+    index.nearest(x, y, 5, near);
+    REQUIRE(near.size() == 5);
+    for (size_t k = 0; k < near.size(); k++) {
+      REQUIRE(std::hypot(snapshot.getX(near[k]) - x, snapshot.getY(near[k]) - y) == all[k].first);
+    }
+
+    double best = std::numeric_limits<double>::infinity();
+    for (CsrGraph::VertexId u = 0; u < snapshot.numVertices(); u++) {
+      for (CsrGraph::Arc arc : snapshot.neighbors(u)) {
+        double ax = snapshot.getX(u), ay = snapshot.getY(u);
+        double ex = snapshot.getX(arc.target) - ax, ey = snapshot.getY(arc.target) - ay;
+        double t = (ex == 0 && ey == 0) ? 0 : ((x - ax) * ex + (y - ay) * ey) / (ex * ex + ey * ey);
+        t = std::min(1.0, std::max(0.0, t));
+        best = std::min(best, std::hypot(ax + t * ex - x, ay + t * ey - y));
+      }
+    }
+    SpatialIndex::EdgeSnap snap;
+    REQUIRE(index.nearestEdge(x, y, snap));
+    REQUIRE(snap.distance == Approx(best));
+    REQUIRE(std::hypot(snap.x - x, snap.y - y) == Approx(snap.distance));
+    REQUIRE(snap.fraction >= 0);
+    REQUIRE(snap.fraction <= 1);
+  }
+
+  // a vertex's own coordinates snap to it
+  vector<Vertex> vertices = g.getVertices();
+  Vertex v = vertices[100];
+  REQUIRE(snapshot.getVertex(index.nearest(v.getX(), v.getY())) == v);
+
+  // batches of coordinates match batches of the snapped ids
+  Search search(snapshot);
+  vector<Search::PointQuery> points;
+  vector<Search::Query> queries;
+  for (int i = 0; i < 20; i++) {
+    Search::PointQuery point = {xs(rng), ys(rng), xs(rng), ys(rng)};
+    Search::Query query = {index.nearest(point.sourceX, point.sourceY), index.nearest(point.targetX, point.targetY)};
+    points.push_back(point);
+    queries.push_back(query);
+  }
+  vector<Search::QueryResult> fromPoints, fromIds;
+  search.batch(points, index, fromPoints, 2);
+  search.batch(queries, fromIds, 2);
+  REQUIRE(fromPoints.size() == fromIds.size());
+  for (size_t i = 0; i < fromIds.size(); i++) {
+    REQUIRE(fromPoints[i].cost == fromIds[i].cost);
+    REQUIRE(fromPoints[i].path == fromIds[i].path);
+  }
+
+  SpatialIndex empty;
+  REQUIRE(empty.nearest(0, 0) == CsrGraph::InvalidId);
+  SpatialIndex::EdgeSnap none;
+  REQUIRE(!empty.nearestEdge(0, 0, none));
+}
+
+TEST_CASE("Edge tree range queries match a scan of every edge") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  EdgeTree tree(g);
+  vector<Edge> edges = g.getEdges();
+  REQUIRE(tree.size() >= edges.size() / 2);
+
+  auto key = [](const EdgeTree::Segment& s) {
+    return std::make_pair(std::min(s.first.getIndex(), s.second.getIndex()),
+                          std::max(s.first.getIndex(), s.second.getIndex()));
+  };
+  vector<EdgeTree::Segment> all;
+  tree.inRectangle(-1e9, -1e9, 1e9, 1e9, all);
+  REQUIRE(all.size() == tree.size());
+
+  std::mt19937 rng(9);
+  std::uniform_real_distribution<double> coordinate(0, 10000), extent(0, 800);
+  vector<EdgeTree::Segment> found;
+  for (int i = 0; i < 50; i++) {
+    double x = coordinate(rng), y = coordinate(rng), w = extent(rng), h = extent(rng);
+    tree.inRectangle(x, y, x + w, y + h, found);
+    std::set<std::pair<int, int>> got;
+    for (const EdgeTree::Segment& s : found) got.insert(key(s));
+    REQUIRE(got.size() == found.size());
+
+    // a segment meets the rectangle iff an endpoint is inside or it
+    // crosses one of its sides; sample each segment densely instead
+    for (const EdgeTree::Segment& s : all) {
+      bool inside = false;
+      for (int k = 0; k <= 1000 && !inside; k++) {
+        double px = s.first.getExactX() + (s.second.getExactX() - s.first.getExactX()) * k / 1000;
+        double py = s.first.getExactY() + (s.second.getExactY() - s.first.getExactY()) * k / 1000;
+        inside = px >= x && px <= x + w && py >= y && py <= y + h;
+      }
+      if (inside) REQUIRE(got.count(key(s)) == 1);
+    }
+    for (const EdgeTree::Segment& s : found) {
+      REQUIRE(std::max(s.first.getExactX(), s.second.getExactX()) >= x);
+      REQUIRE(std::min(s.first.getExactX(), s.second.getExactX()) <= x + w);
+    }
+
+    double radius = w / 2;
+    tree.inRadius(x, y, radius, found);
+    size_t expected = 0;
+    for (const EdgeTree::Segment& s : all) {
+      double ax = s.first.getExactX(), ay = s.first.getExactY();
+      double ex = s.second.getExactX() - ax, ey = s.second.getExactY() - ay;
+      double t = (ex == 0 && ey == 0) ? 0 : ((x - ax) * ex + (y - ay) * ey) / (ex * ex + ey * ey);
+      t = std::min(1.0, std::max(0.0, t));
+      if (std::hypot(ax + t * ex - x, ay + t * ey - y) <= radius) expected++;
+    }
+    REQUIRE(found.size() == expected);
+  }
+
+  EdgeTree empty;
+  empty.inRectangle(0, 0, 100, 100, found);
+  REQUIRE(found.empty());
+}
+
+TEST_CASE("Rendering through the edge tree matches drawing every edge") {
+  // a small graph with integer coordinates, drawn the old way: every
+  // adjacency entry, then every vertex marker
+  Graph g(true, false);
+  std::mt19937 rng(3);
+  vector<Vertex> vs;
+  for (int i = 0; i < 40; i++) {
+    vs.push_back(Vertex(i, 20 + rng() % 200, 20 + rng() % 150));
+    g.insertVertex(vs.back());
+  }
+  for (int i = 0; i < 60; i++) {
+    size_t a = rng() % vs.size(), b = rng() % vs.size();
+    if (a != b) g.insertEdge(vs[a], vs[b]);
+  }
+
+  cs225::PNG blank(260, 200);
+  cs225::PNG expected(blank);
+  cs225::HSLAPixel black(226, 1, 0, 1), pink(328, 1, 0.76, 1);
+  for (const Vertex& v : g.vertices()) {
+    for (const auto& neighbor : g.neighbors(v)) Graph::drawPathHelper(expected, black, v, neighbor.first, 10);
+  }
+  for (const Vertex& v : g.vertices()) {
+    for (int i = 0; i <= 10; i++) {
+      for (int j = 0; j <= 10; j++) expected.getPixel(v.getX() + i, v.getY() + j) = pink;
+    }
+  }
+  REQUIRE(g.render(g, blank) == expected);
+  REQUIRE(Graph::render(g.freeze(), blank) == expected);
+
+  // a crop shows the same pixels as the full image
+  EdgeTree tree(g);
+  cs225::PNG crop = Graph::render(tree, cs225::PNG(90, 70), 100, 60);
+  for (unsigned x = 0; x < crop.width(); x++) {
+    for (unsigned y = 0; y < crop.height(); y++) {
+      REQUIRE(crop.getPixel(x, y) == expected.getPixel(x + 100, y + 60));
+    }
+  }
+}
+
+TEST_CASE("Span line drawing matches the stamped squares") {
+  std::mt19937 rng(18);
+  std::uniform_int_distribution<int> coordinate(-40, 240);
+  cs225::HSLAPixel black(226, 1, 0, 1);
+  for (int i = 0; i < 400; i++) {
+    Vertex a(0, coordinate(rng), coordinate(rng)), b(1, coordinate(rng), coordinate(rng));
+    if (a.getX() == b.getX() && a.getY() == b.getY()) continue;
+    double size = (i % 3 == 0) ? 15 : (i % 3 == 1) ? 10 : 1 + rng() % 4;
+    cs225::PNG expected(200, 160), png(200, 160);
+    Graph::drawPathStamped(expected, black, a, b, size);
+    Graph::drawPathHelper(png, black, a, b, size);
+    REQUIRE(png == expected);
+  }
+
+  // a point is one square
+  cs225::PNG png(30, 30);
+  Graph::drawPathHelper(png, black, Vertex(0, 5, 7), Vertex(1, 5, 7), 10);
+  size_t drawn = 0;
+  for (unsigned x = 0; x < png.width(); x++) {
+    for (unsigned y = 0; y < png.height(); y++) drawn += png.getPixel(x, y) == black;
+  }
+  REQUIRE(drawn == 100);
+}
+
+TEST_CASE("RGBA8 images match HSLA images pixel for pixel") {
+  // an HSLA image with a spread of colors
+  cs225::PNG hsla(64, 48);
+  for (unsigned x = 0; x < hsla.width(); x++) {
+    for (unsigned y = 0; y < hsla.height(); y++) {
+      hsla.getPixel(x, y) = cs225::HSLAPixel(x * 5.6, (y % 5) / 4.0, (x + y) / 110.0, 1);
+    }
+  }
+  REQUIRE(hsla.writeToFile("test_hsla.png"));
+  cs225::RGBAPNG packed;
+  REQUIRE(packed.readFromFile("test_hsla.png"));
+  REQUIRE(packed == cs225::RGBAPNG(hsla));
+  REQUIRE(packed.row(3)[7] == packed.getPixel(7, 3));
+
+  REQUIRE(packed.writeToFile("test_rgba.png"));
+  cs225::PNG reread, original;
+  REQUIRE(reread.readFromFile("test_rgba.png"));
+  REQUIRE(original.readFromFile("test_hsla.png"));
+  REQUIRE(reread == original);
+  REQUIRE(packed.toHSLA() == original);
+  std::remove("test_hsla.png");
+  std::remove("test_rgba.png");
+
+  // rendering and path drawing give the same colors on either image
+  Graph g(true, false);
+  std::mt19937 rng(4);
+  vector<Vertex> vs;
+  for (int i = 0; i < 30; i++) {
+    vs.push_back(Vertex(i, 10 + rng() % 180, 10 + rng() % 130));
+    g.insertVertex(vs.back());
+  }
+  for (int i = 0; i + 1 < 30; i++) g.insertEdge(vs[i], vs[i + 1]);
+  Search search(g);
+  cs225::PNG drawn = search.drawPath(g.render(g, cs225::PNG(220, 170)), vs[0], vs[20]);
+  cs225::RGBAPNG drawnPacked = search.drawPath(g.render(g, cs225::RGBAPNG(220, 170)), vs[0], vs[20]);
+  REQUIRE(drawnPacked == cs225::RGBAPNG(drawn));
+}
+
+TEST_CASE("Route markers are clipped to the image") {
+  Graph g(true, false);
+  Vertex top(0, 2, -12), bottom(1, 2, 40);
+  g.insertEdge(top, bottom);
+  Search search(g);
+  cs225::RGBAPNG png(20, 20);
+  search.drawPathInto(png, top, bottom);
+
+  // the top marker covers what is left of its square; the bottom one is
+  // off the image and draws nothing, instead of smearing its last row
+  cs225::RGBAPixel red = cs225::HSLAPixel(5, 1, 0.50, 1);
+  cs225::RGBAPixel white;
+  for (unsigned y = 0; y < 18; y++) REQUIRE(png.getPixel(19, y) == red);
+  for (unsigned y = 18; y < 20; y++) REQUIRE(png.getPixel(19, y) == white);
+  REQUIRE(png.getPixel(1, 19) == white);
+}
+
+TEST_CASE("Tile-parallel rendering matches the serial render") {
+  Graph g("sampledata/oldenburg_road_network.csv", "sampledata/OL_road_coords.csv", true);
+  EdgeTree tree(g);
+  cs225::RGBAPNG serial = Graph::render(tree, cs225::RGBAPNG(1500, 1100), 3000, 2500, 1);
+  for (unsigned threads : {2u, 4u, 7u}) {
+    REQUIRE(Graph::render(tree, cs225::RGBAPNG(1500, 1100), 3000, 2500, threads) == serial);
+  }
+
+  // the whole small graph drawn the old way, on tiles
+  Graph small(true, false);
+  std::mt19937 rng(11);
+  vector<Vertex> vs;
+  for (int i = 0; i < 80; i++) {
+    vs.push_back(Vertex(i, rng() % 700, rng() % 560));
+    small.insertVertex(vs.back());
+  }
+  for (int i = 0; i < 120; i++) {
+    size_t a = rng() % vs.size(), b = rng() % vs.size();
+    if (a != b) small.insertEdge(vs[a], vs[b]);
+  }
+  cs225::RGBAPNG expected(720, 580);
+  cs225::HSLAPixel black(226, 1, 0, 1), pink(328, 1, 0.76, 1);
+  for (const Vertex& v : small.vertices()) {
+    for (const auto& neighbor : small.neighbors(v)) Graph::drawPathHelper(expected, black, v, neighbor.first, 10);
+  }
+  for (const Vertex& v : small.vertices()) {
+    for (int i = 0; i <= 10; i++) {
+      for (int j = 0; j <= 10; j++) expected.getPixel(v.getX() + i, v.getY() + j) = pink;
+    }
+  }
+  REQUIRE(Graph::render(EdgeTree(small), cs225::RGBAPNG(720, 580), 0, 0, 3) == expected);
+}
+
+TEST_CASE("Base map routes match rendering everything again") {
+  Graph g(true, false);
+  std::mt19937 rng(5);
+  vector<Vertex> vs;
+  for (int i = 0; i < 60; i++) {
+    vs.push_back(Vertex(i, rng() % 500, rng() % 400));
+    g.insertVertex(vs.back());
+    if (i > 0) g.insertEdge(vs[i - 1], vs[i]);
+  }
+  cs225::RGBAPNG background(520, 420);
+  for (unsigned y = 0; y < background.height(); y++) {
+    for (unsigned x = 0; x < background.width(); x++) background.getPixel(x, y).g = (x * y) % 251;
+  }
+
+  Search search(g);
+  BaseMap map(g, background);
+  auto expected = [&](Vertex start, Vertex end) {
+    return search.drawPath(g.render(g, background), start, end);
+  };
+  // the second and third routes are drawn over the undone first one; the
+  // third ends at the bottom right corner, where its marker is clipped
+  REQUIRE(map.route(search, vs[3], vs[40]) == expected(vs[3], vs[40]));
+  REQUIRE(map.route(search, vs[50], vs[10]) == expected(vs[50], vs[10]));
+  Vertex corner(60, 510, 415);
+  g.insertVertex(corner);
+  g.insertEdge(vs[59], corner);
+  REQUIRE(map.route(search, vs[20], corner) == expected(vs[20], corner));
+  REQUIRE(map.route(search, vs[0], vs[1]) == expected(vs[0], vs[1]));
+  REQUIRE(map.renders() == 2);
+
+  // a second map of the same snapshot reads the base the first one saved
+  CsrGraph snapshot = g.freeze();
+  string directory = makeTempDirectory();
+  REQUIRE(!directory.empty());
+  BaseMap first(snapshot, background, directory);
+  BaseMap second(snapshot, background, directory);
+  REQUIRE(first.key() == map.key());
+  REQUIRE(second.base() == first.base());
+  REQUIRE(first.renders() == 1);
+  REQUIRE(second.renders() == 0);
+  REQUIRE(second.loads() == 1);
+  char name[40];
+  snprintf(name, sizeof(name), "/basemap-%016llx.png", (unsigned long long) first.key());
+  REQUIRE(std::remove((directory + name).c_str()) == 0);
+  REQUIRE(rmdir(directory.c_str()) == 0);
+}
+
+TEST_CASE("Tile pyramid crops the full render and updates only changed tiles") {
+  Graph g(true, false);
+  std::mt19937 rng(8);
+  vector<Vertex> vs;
+  for (int i = 0; i < 40; i++) {
+    vs.push_back(Vertex(i, rng() % 700, rng() % 560));
+    g.insertVertex(vs.back());
+    if (i > 0) g.insertEdge(vs[i - 1], vs[i]);
+  }
+  EdgeTree before(g);
+  string directory = makeTempDirectory();
+  REQUIRE(!directory.empty());
+  TilePyramid pyramid(directory + "/before");
+  REQUIRE(pyramid.extent() == 0);
+  size_t built = pyramid.build(before, 3);
+  REQUIRE(pyramid.maxZoom() == 2);
+  REQUIRE(pyramid.extent() == 1024);
+
+  auto exists = [](const string& file) { return std::ifstream(file.c_str()).good(); };
+  auto read = [](const string& file) {
+    cs225::RGBAPNG image;
+    image.readFromFile(file);
+    return image;
+  };
+
+  // the deepest tiles are crops of the whole map drawn on a transparent image
+  cs225::RGBAPNG whole(1024, 1024);
+  for (unsigned y = 0; y < whole.height(); y++)
+    std::fill(whole.row(y), whole.row(y) + whole.width(), cs225::RGBAPixel(0, 0, 0, 0));
+  whole = Graph::render(before, whole);
+  size_t files = 0;
+  for (unsigned z = 0; z <= 2; z++) {
+    for (unsigned x = 0; x < (1u << z); x++) {
+      for (unsigned y = 0; y < (1u << z); y++) {
+        string file = pyramid.tileFile(z, x, y);
+        files += exists(file);
+        if (z < 2) continue;
+        cs225::RGBAPNG crop(256, 256);
+        bool empty = true;
+        for (unsigned j = 0; j < 256; j++) {
+          std::copy(whole.row(y * 256 + j) + x * 256, whole.row(y * 256 + j) + x * 256 + 256, crop.row(j));
+          for (unsigned i = 0; i < 256; i++) empty = empty && crop.row(j)[i].a == 0;
+        }
+        REQUIRE(exists(file) == !empty);
+        if (!empty) REQUIRE(read(file) == crop);
+      }
+    }
+  }
+  REQUIRE(files == built);
+  REQUIRE(files < 21);
+  REQUIRE(exists(pyramid.tileFile(0, 0, 0)));
+
+  // the same pixels as a fresh build, at every zoom
+  auto matches = [&](const TilePyramid& updated, const EdgeTree& tree) {
+    TilePyramid fresh(directory + "/fresh");
+    fresh.build(tree, 1);
+    REQUIRE(updated.maxZoom() == fresh.maxZoom());
+    for (unsigned z = 0; z <= fresh.maxZoom(); z++) {
+      for (unsigned x = 0; x < (1u << z); x++) {
+        for (unsigned y = 0; y < (1u << z); y++) {
+          string file = updated.tileFile(z, x, y);
+          REQUIRE(exists(file) == exists(fresh.tileFile(z, x, y)));
+          if (exists(file)) REQUIRE(read(file) == read(fresh.tileFile(z, x, y)));
+        }
+      }
+    }
+  };
+
+  // a new edge redraws the tiles under it, also from a pyramid opened
+  // again on the directory, as a later run would
+  g.insertEdge(vs[0], vs[2]);
+  EdgeTree after(g);
+  vector<EdgeTree::Segment> changed;
+  TilePyramid::changedSegments(before, after, changed);
+  REQUIRE(changed.size() == 1);
+  TilePyramid reopened(directory + "/before");
+  REQUIRE(reopened.maxZoom() == 2);
+  REQUIRE(reopened.extent() == 1024);
+  size_t updated = reopened.update(after, changed, 2);
+  REQUIRE(updated > 2);
+  REQUIRE(updated < built);
+  matches(reopened, after);
+
+  // a network grown past the pyramid is built again one zoom deeper
+  Vertex far(40, 1500, 100);
+  g.insertEdge(vs[39], far);
+  EdgeTree grown(g);
+  TilePyramid::changedSegments(after, grown, changed);
+  REQUIRE(TilePyramid(directory + "/before").update(grown, changed, 2) > updated);
+  TilePyramid rebuilt(directory + "/before");
+  REQUIRE(rebuilt.maxZoom() == 3);
+  matches(rebuilt, grown);
+
+  // two edges far apart: only the tiles above them are visited, one at
+  // zoom 0 and two at each zoom below, and removing one removes its tiles
+  Vertex a(0, 10, 10), b(1, 20, 20), c(2, 200000, 200000), d(3, 200010, 200010);
+  EdgeTree sparse(vector<EdgeTree::Segment>{{a, b}, {c, d}});
+  TilePyramid spread(directory + "/sparse");
+  REQUIRE(spread.build(sparse, 2) == 21);
+  REQUIRE(spread.maxZoom() == 10);
+  for (unsigned z = 0; z <= 10; z++) {
+    REQUIRE(exists(spread.tileFile(z, 0, 0)));
+    REQUIRE(exists(spread.tileFile(z, 781 >> (10 - z), 781 >> (10 - z))));
+  }
+  EdgeTree near(vector<EdgeTree::Segment>{{a, b}});
+  TilePyramid::changedSegments(sparse, near, changed);
+  REQUIRE(spread.update(near, changed, 2) == 1);
+  for (unsigned z = 1; z <= 10; z++) {
+    REQUIRE(exists(spread.tileFile(z, 0, 0)));
+    REQUIRE(!exists(spread.tileFile(z, 781 >> (10 - z), 781 >> (10 - z))));
+  }
+
+  REQUIRE(removeDirectory(directory));
+}
+
+TEST_CASE("Scaled rendering draws the transformed edges and merges subpixel ones") {
+  std::mt19937 rng(13);
+  vector<EdgeTree::Segment> segments;
+  for (int i = 0; i < 3000; i++) {
+    double x = rng() % 4000, y = rng() % 3000;
+    Vertex a(2 * i, x, y), b(2 * i + 1, x + (int) (rng() % 21) - 10, y + (int) (rng() % 21) - 10);
+    segments.push_back(EdgeTree::Segment{a, b});
+  }
+  // and a dense street grid, which an overview draws as filled cells
+  for (int i = 0; i < 40; i++) {
+    for (int j = 0; j < 40; j++) {
+      Vertex v(10000 + i * 40 + j, 1000 + 5 * i, 2000 + 5 * j);
+      segments.push_back(EdgeTree::Segment{v, Vertex(v.getIndex() + 40, v.getExactX() + 5, v.getExactY())});
+      segments.push_back(EdgeTree::Segment{v, Vertex(v.getIndex() + 1, v.getExactX(), v.getExactY() + 5)});
+    }
+  }
+  EdgeTree tree(segments);
+
+  // scale and offset: the same as drawing every transformed edge
+  Graph::RenderOptions options;
+  options.scale = 0.25;
+  options.originX = 300;
+  options.originY = -100;
+  options.pen = 2;
+  options.marker = 0;
+  options.threads = 3;
+  cs225::RGBAPNG expected(900, 800);
+  cs225::HSLAPixel black(226, 1, 0, 1);
+  auto transform = [&](const Vertex& v) {
+    return Vertex(v.getIndex(), std::floor((v.getExactX() - options.originX) * options.scale),
+                  std::floor((v.getExactY() - options.originY) * options.scale));
+  };
+  for (const EdgeTree::Segment& s : segments) {
+    Graph::drawPathHelper(expected, black, transform(s.first), transform(s.second), 2);
+  }
+  REQUIRE(Graph::render(tree, cs225::RGBAPNG(900, 800), options) == expected);
+
+  // an overview that merges short edges and dense cells stays within a
+  // pixel of drawing every edge, both ways
+  Graph::RenderOptions overview = Graph::RenderOptions::fit(tree, 200, 150);
+  REQUIRE(overview.scale == Approx(0.04975).epsilon(0.01));
+  REQUIRE(overview.cellSize > 0);
+  Graph::RenderOptions exact = overview;
+  exact.minLength = 0;
+  exact.cellSize = 0;
+  cs225::RGBAPNG merged = Graph::render(tree, cs225::RGBAPNG(200, 150), overview);
+  cs225::RGBAPNG full = Graph::render(tree, cs225::RGBAPNG(200, 150), exact);
+  cs225::RGBAPixel white;
+  auto nearDrawn = [&](const cs225::RGBAPNG& image, unsigned x, unsigned y) {
+    for (unsigned j = y > 0 ? y - 1 : 0; j <= std::min(y + 1, 149u); j++) {
+      for (unsigned i = x > 0 ? x - 1 : 0; i <= std::min(x + 1, 199u); i++) {
+        if (image.getPixel(i, j) != white) return true;
+      }
+    }
+    return false;
+  };
+  size_t drawn = 0;
+  for (unsigned y = 0; y < 150; y++) {
+    for (unsigned x = 0; x < 200; x++) {
+      if (merged.getPixel(x, y) != white) {
+        drawn++;
+        REQUIRE(nearDrawn(full, x, y));
+      }
+      if (full.getPixel(x, y) != white) REQUIRE(nearDrawn(merged, x, y));
+    }
+  }
+  REQUIRE(drawn > 1000);
+}
+
+/**
+ * Runs finalproj, built next to the tests, with arguments.
+ * @param output - what it printed, on either stream
+ * @return its exit status
+ */
+static int runFinalproj(const string& arguments, string& output) {
+  FILE* pipe = popen(("./finalproj " + arguments + " 2>&1").c_str(), "r");
+  REQUIRE(pipe != NULL);
+  output.clear();
+  char buffer[256];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), pipe)) > 0;) output.append(buffer, n);
+  int status = pclose(pipe);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+TEST_CASE("Overview sizes that are not whole positive numbers print the usage") {
+  string output;
+  for (const char* sizes : {"abc 100", "100 abc", "-5 100", "0 0", "1.5 100", "100 1e9", "12x 100"}) {
+    INFO(sizes);
+    REQUIRE(runFinalproj(string("--overview ") + sizes + " missing.snapshot", output) == 1);
+    REQUIRE(output.find("usage:") != string::npos);
+  }
+  // good sizes get as far as reading the snapshot
+  REQUIRE(runFinalproj("--overview 100 16384 missing.snapshot", output) == 1);
+  REQUIRE(output.find("Could not read snapshot") != string::npos);
+  REQUIRE(output.find("usage:") == string::npos);
+}
+
+TEST_CASE("Rendering and drawing routes in place copies no images") {
+  Graph g(true, false);
+  std::mt19937 rng(11);
+  vector<Vertex> vs;
+  for (int i = 0; i < 40; i++) {
+    vs.push_back(Vertex(i, rng() % 300, rng() % 200));
+    g.insertVertex(vs.back());
+    if (i > 0) g.insertEdge(vs[i - 1], vs[i]);
+  }
+  CsrGraph snapshot = g.freeze();
+  Search search(snapshot);
+  cs225::RGBAPNG background(320, 220);
+  const cs225::RGBAPNG expected = search.drawPath(Graph::render(snapshot, background), vs[2], vs[30]);
+  const cs225::PNG expectedHSLA = expected.toHSLA();
+
+  unsigned long copies = cs225::PNG::copies();
+  unsigned long packedCopies = cs225::RGBAPNG::copies();
+
+  // the steps of main: one canvas, drawn on twice
+  cs225::RGBAPNG png(320, 220);
+  Graph::renderInto(snapshot, png);
+  search.drawPathInto(png, vs[2], vs[30]);
+
+  // the value overloads, chained and given their input to keep
+  cs225::PNG hsla = search.drawPath(Graph::render(snapshot, cs225::PNG(320, 220)), vs[2], vs[30]);
+  cs225::RGBAPNG moved(320, 220);
+  moved = Graph::render(snapshot, std::move(moved));
+  moved = search.drawPath(std::move(moved), vs[2], vs[30]);
+
+  REQUIRE(cs225::PNG::copies() == copies);
+  REQUIRE(cs225::RGBAPNG::copies() == packedCopies);
+  REQUIRE(png == expected);
+  REQUIRE(moved == expected);
+  REQUIRE(hsla == expectedHSLA);
+
+  // a move leaves an empty image behind, and a copy is counted
+  cs225::PNG taken(std::move(hsla));
+  REQUIRE(hsla.width() == 0);
+  REQUIRE(taken == expectedHSLA);
+  cs225::RGBAPNG copy = png;
+  REQUIRE(cs225::RGBAPNG::copies() == packedCopies + 1);
+  REQUIRE(copy == expected);
+}
+
+TEST_CASE("Encoder options and striped encoding write the same pixels") {
+  std::mt19937 rng(12);
+  // translucent noise, an opaque gradient, and maps of five and two colors;
+  // 160 pixel rows make three stripes of the noise
+  vector<cs225::RGBAPNG> images(4, cs225::RGBAPNG(160, 900));
+  for (unsigned y = 0; y < 900; y++) {
+    for (unsigned x = 0; x < 160; x++) {
+      images[0].getPixel(x, y) = cs225::RGBAPixel(rng() % 256, x % 256, y % 256, rng() % 2 ? 255 : rng() % 256);
+      images[1].getPixel(x, y) = cs225::RGBAPixel(x % 256, y % 256, (x + y) % 256);
+      unsigned k = (x / 9 + y / 13) % 5;
+      images[2].getPixel(x, y) = cs225::RGBAPixel(40 * k, 255 - 30 * k, 7 * k, k == 4 ? 100 : 255);
+      if ((x + y) % 17 == 0) images[3].getPixel(x, y) = cs225::RGBAPixel(0, 0, 0);
+    }
+  }
+  // a map of 200 colors, whose 1100 byte palette rows make five stripes
+  images.push_back(cs225::RGBAPNG(1100, 1000));
+  for (unsigned y = 0; y < 1000; y++) {
+    for (unsigned x = 0; x < 1100; x++) {
+      unsigned k = (x / 7 + y / 11) % 200;
+      images[4].getPixel(x, y) = cs225::RGBAPixel(k, 255 - k, (3 * k) % 256, k % 50 == 0 ? 128 : 255);
+    }
+  }
+  const unsigned char colorTypes[] = {6, 2, 3, 3, 3};
+  const unsigned char bitDepths[] = {8, 8, 4, 1, 8};
+
+  vector<cs225::EncodeOptions> modes(8);
+  modes[1].fast = true;
+  modes[2].level = 0;
+  modes[3].level = 1;
+  modes[4].level = 9;
+  modes[5].filter = cs225::EncodeOptions::Paeth;
+  modes[6].filter = cs225::EncodeOptions::Entropy;
+  modes[7].filter = cs225::EncodeOptions::None;
+  for (size_t i = 0; i < images.size(); i++) {
+    const unsigned char * pixels = reinterpret_cast<const unsigned char *>(images[i].row(0));
+    unsigned w = images[i].width(), h = images[i].height();
+    for (cs225::EncodeOptions options : modes) {
+      vector<unsigned char> serial, striped, threaded;
+      REQUIRE(cs225::encodePNG(pixels, w, h, options, serial));
+      options.parallel = true;
+      options.threads = 1;
+      REQUIRE(cs225::encodePNG(pixels, w, h, options, striped));
+      options.threads = 4;
+      REQUIRE(cs225::encodePNG(pixels, w, h, options, threaded));
+      REQUIRE(striped == threaded);
+      REQUIRE(serial[24] == bitDepths[i]);
+      REQUIRE(serial[25] == colorTypes[i]);
+
+      for (const vector<unsigned char>* file : {&serial, &striped}) {
+        vector<unsigned char> decoded;
+        unsigned width, height;
+        REQUIRE(lodepng::decode(decoded, width, height, *file) == 0);
+        REQUIRE(width == w);
+        REQUIRE(height == h);
+        REQUIRE(std::equal(decoded.begin(), decoded.end(), pixels));
+      }
+    }
+  }
+
+  // both image classes write through the encoder, HSLA images a row at a time
+  string directory = makeTempDirectory();
+  string file = directory + "/striped.png";
+  cs225::EncodeOptions options;
+  options.parallel = true;
+  REQUIRE(images[2].writeToFile(file, options));
+  cs225::RGBAPNG reread;
+  REQUIRE(reread.readFromFile(file));
+  REQUIRE(reread == images[2]);
+  for (size_t i : {1, 4}) {
+    cs225::PNG hsla = images[i].toHSLA();
+    REQUIRE(hsla.writeToFile(file, options));
+    cs225::PNG rereadHSLA;
+    REQUIRE(rereadHSLA.readFromFile(file));
+    REQUIRE(rereadHSLA == hsla);
+  }
+  REQUIRE(removeDirectory(directory));
+}
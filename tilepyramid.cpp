@@ -0,0 +1,333 @@
+#include "tilepyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace {
+
+    /** How far right of and below their points lines and markers reach, as Graph::render draws them. */
+    const double Reach = 11;
+
+    /** Deepest level of which every tile is held in memory while a level is built. */
+    const unsigned MaxSplit = 5;
+
+    /** Deepest zoom a pyramid can have. */
+    const unsigned MaxZoom = 24;
+
+    uint64_t key(unsigned x, unsigned y)
+    {
+        return (uint64_t) x << 32 | y;
+    }
+
+    /** @return a tile of transparent pixels */
+    cs225::RGBAPNG clearTile()
+    {
+        cs225::RGBAPNG tile(TilePyramid::TileSize, TilePyramid::TileSize);
+        for (unsigned y = 0; y < tile.height(); y++)
+            std::fill(tile.row(y), tile.row(y) + tile.width(), cs225::RGBAPixel(0, 0, 0, 0));
+        return tile;
+    }
+
+    /** @return true, if any pixel of an image is not transparent */
+    bool anyDrawn(const cs225::RGBAPNG& image)
+    {
+        for (unsigned y = 0; y < image.height(); y++) {
+            const cs225::RGBAPixel* row = image.row(y);
+            for (unsigned x = 0; x < image.width(); x++) {
+                if (row[x].a != 0) return true;
+            }
+        }
+        return false;
+    }
+
+    /** Removes one file or emptied directory of an old pyramid, for nftw. */
+    int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+    {
+        std::remove(path);
+        return 0;
+    }
+
+    /** @return a segment with its lesser end first, for comparing by coordinates */
+    std::tuple<double, double, double, double> canonical(const EdgeTree::Segment& s)
+    {
+        std::pair<double, double> a(s.first.getExactX(), s.first.getExactY());
+        std::pair<double, double> b(s.second.getExactX(), s.second.getExactY());
+        if (b < a) std::swap(a, b);
+        return std::make_tuple(a.first, a.second, b.first, b.second);
+    }
+}
+
+TilePyramid::TilePyramid(const string& directory)
+    : directory_(directory), maxZoom_(0), extent_(0)
+{
+    std::ifstream metadata(metadataFile().c_str());
+    string zoomName, extentName;
+    unsigned zoom = 0;
+    double extent = 0;
+    if (metadata >> zoomName >> zoom >> extentName >> extent && zoomName == "maxZoom" && extentName == "extent"
+        && zoom <= MaxZoom && extent == std::ldexp((double) TileSize, zoom)) {
+        maxZoom_ = zoom;
+        extent_ = extent;
+    }
+}
+
+unsigned TilePyramid::zoomFor(const EdgeTree& tree)
+{
+    unsigned zoom = 0;
+    if (tree.size() > 0) {
+        double minX, minY, maxX, maxY;
+        tree.bounds(minX, minY, maxX, maxY);
+        double extent = std::max(maxX, maxY) + Reach;
+        while (zoom < MaxZoom && std::ldexp((double) TileSize, zoom) < extent) zoom++;
+    }
+    return zoom;
+}
+
+/**
+ * Removes the tiles of any pyramid built there before, so generate() has
+ * no old files to remove for tiles left empty.
+ */
+size_t TilePyramid::build(const EdgeTree& tree, unsigned threads)
+{
+    std::remove(metadataFile().c_str());
+    for (unsigned z = 0; z <= MaxZoom; z++)
+        nftw((directory_ + "/" + std::to_string(z)).c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    maxZoom_ = zoomFor(tree);
+    size_t written = generate(tree, NULL, threads);
+    extent_ = std::ldexp((double) TileSize, maxZoom_);
+    std::ofstream metadata(metadataFile().c_str(), std::ios::trunc);
+    metadata << "maxZoom " << maxZoom_ << "\nextent " << (unsigned long long) extent_ << "\n";
+    return written;
+}
+
+/**
+ * Marks the deepest tiles that the boxes of the changed segments touch,
+ * and every tile above them.
+ */
+size_t TilePyramid::update(const EdgeTree& tree, const vector<EdgeTree::Segment>& changed, unsigned threads)
+{
+    if (extent_ == 0 || zoomFor(tree) > maxZoom_) return build(tree, threads);
+
+    DirtySet dirty(maxZoom_ + 1);
+    double limit = std::ldexp(1.0, maxZoom_) - 1;
+    auto toTile = [&](double coordinate) {
+        return (unsigned) std::min(std::max(std::floor(coordinate / TileSize), 0.0), limit);
+    };
+    for (const EdgeTree::Segment& s : changed) {
+        double maxX = std::max(s.first.getX(), s.second.getX()) + Reach;
+        double maxY = std::max(s.first.getY(), s.second.getY()) + Reach;
+        if (maxX < 0 || maxY < 0) continue;
+        unsigned x0 = toTile(std::min(s.first.getX(), s.second.getX()));
+        unsigned y0 = toTile(std::min(s.first.getY(), s.second.getY()));
+        for (unsigned y = y0; y <= toTile(maxY); y++) {
+            for (unsigned x = x0; x <= toTile(maxX); x++) {
+                for (unsigned z = 0; z <= maxZoom_; z++)
+                    dirty[z].insert(key(x >> (maxZoom_ - z), y >> (maxZoom_ - z)));
+            }
+        }
+    }
+    return generate(tree, &dirty, threads);
+}
+
+/**
+ * Builds the subpyramids below a middle level in parallel, holding their
+ * tops, then the levels above them from those, one level at a time.
+ */
+size_t TilePyramid::generate(const EdgeTree& tree, const DirtySet* dirty, unsigned threads) const
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    mkdir(directory_.c_str(), 0755);
+
+    // enough subpyramids that threads finishing early find more to do
+    unsigned split = 0;
+    while (split < maxZoom_ && split < MaxSplit && (1ul << (2 * split)) < 64ul * threads) split++;
+
+    std::atomic<size_t> written(0);
+    size_t side = (size_t) 1 << split;
+    vector<cs225::RGBAPNG> level(side * side);
+    parallelFor(level.size(), threads, [&](size_t i, unsigned) {
+        unsigned x = i % side, y = i / side;
+        if (!needed(dirty, split, x, y)) return;
+        size_t count = 0;
+        tile(tree, dirty, split, x, y, level[i], count);
+        written += count;
+    }, 1);
+
+    for (unsigned z = split; z-- > 0;) {
+        size_t below = side;
+        side /= 2;
+        vector<cs225::RGBAPNG> above(side * side);
+        parallelFor(above.size(), threads, [&](size_t i, unsigned) {
+            unsigned x = i % side, y = i / side;
+            if (!needed(dirty, z, x, y)) return;
+            if (dirty != NULL && (*dirty)[z].count(key(x, y)) == 0) {
+                load(z, x, y, above[i]);
+                return;
+            }
+            const cs225::RGBAPNG* children[4];
+            for (unsigned q = 0; q < 4; q++)
+                children[q] = &level[(2 * y + q / 2) * below + 2 * x + q % 2];
+            size_t count = 0;
+            combine(dirty, z, x, y, children, above[i], count);
+            written += count;
+        }, 1);
+        level.swap(above);
+    }
+    return written;
+}
+
+bool TilePyramid::tile(const EdgeTree& tree, const DirtySet* dirty, unsigned z, unsigned x, unsigned y,
+                       cs225::RGBAPNG& out, size_t& written) const
+{
+    if (dirty != NULL && (*dirty)[z].count(key(x, y)) == 0) return load(z, x, y, out);
+
+    // most of a sparse network's extent is empty, so whole subpyramids
+    // with nothing near them are skipped
+    double side = std::ldexp((double) TileSize, maxZoom_ - z);
+    double left = x * side, top = y * side;
+    out = cs225::RGBAPNG();
+    if (!tree.anyInRectangle(left - Reach, top - Reach, left + side, top + side)) {
+        if (dirty != NULL) removeDirty(*dirty, z, x, y);
+        return false;
+    }
+
+    if (z < maxZoom_) {
+        cs225::RGBAPNG children[4];
+        const cs225::RGBAPNG* pointers[4];
+        for (unsigned q = 0; q < 4; q++) {
+            tile(tree, dirty, z + 1, 2 * x + q % 2, 2 * y + q / 2, children[q], written);
+            pointers[q] = &children[q];
+        }
+        return combine(dirty, z, x, y, pointers, out, written);
+    }
+
+    out = Graph::render(tree, clearTile(), (int) left, (int) top, 1);
+    if (!anyDrawn(out)) out = cs225::RGBAPNG();
+    bool drawn = out.width() > 0;
+    store(dirty, z, x, y, drawn, out, written);
+    return drawn;
+}
+
+/**
+ * Averages each 2x2 block of pixels with colors weighted by alpha, so
+ * transparent pixels do not darken the lines next to them.
+ */
+bool TilePyramid::combine(const DirtySet* dirty, unsigned z, unsigned x, unsigned y,
+                          const cs225::RGBAPNG* children[4], cs225::RGBAPNG& out, size_t& written) const
+{
+    out = cs225::RGBAPNG();
+    const unsigned half = TileSize / 2;
+    for (unsigned q = 0; q < 4; q++) {
+        const cs225::RGBAPNG& child = *children[q];
+        if (child.width() != TileSize || child.height() != TileSize) continue;
+        if (out.width() == 0) out = clearTile();
+        for (unsigned j = 0; j < half; j++) {
+            const cs225::RGBAPixel* upper = child.row(2 * j);
+            const cs225::RGBAPixel* lower = child.row(2 * j + 1);
+            cs225::RGBAPixel* row = out.row((q / 2) * half + j) + (q % 2) * half;
+            for (unsigned i = 0; i < half; i++) {
+                const cs225::RGBAPixel* block[4] = {&upper[2 * i], &upper[2 * i + 1],
+                                                    &lower[2 * i], &lower[2 * i + 1]};
+                unsigned alpha = 0, r = 0, g = 0, b = 0;
+                for (const cs225::RGBAPixel* p : block) {
+                    alpha += p->a;
+                    r += p->r * p->a;
+                    g += p->g * p->a;
+                    b += p->b * p->a;
+                }
+                if (alpha == 0) continue;
+                row[i] = cs225::RGBAPixel((r + alpha / 2) / alpha, (g + alpha / 2) / alpha,
+                                          (b + alpha / 2) / alpha, (alpha + 2) / 4);
+            }
+        }
+    }
+    bool drawn = out.width() > 0;
+    store(dirty, z, x, y, drawn, out, written);
+    return drawn;
+}
+
+void TilePyramid::store(const DirtySet* dirty, unsigned z, unsigned x, unsigned y, bool drawn,
+                        const cs225::RGBAPNG& image, size_t& written) const
+{
+    string file = tileFile(z, x, y);
+    if (!drawn) {
+        if (dirty != NULL) std::remove(file.c_str());
+        return;
+    }
+    string column = directory_ + "/" + std::to_string(z);
+    mkdir(column.c_str(), 0755);
+    column += "/" + std::to_string(x);
+    mkdir(column.c_str(), 0755);
+    if (image.writeToFile(file)) written++;
+}
+
+bool TilePyramid::load(unsigned z, unsigned x, unsigned y, cs225::RGBAPNG& out) const
+{
+    string file = tileFile(z, x, y);
+    if (std::ifstream(file.c_str()).good() && out.readFromFile(file)) return true;
+    out = cs225::RGBAPNG();
+    return false;
+}
+
+/** Every ancestor of a dirty tile is dirty, so only dirty tiles are walked. */
+void TilePyramid::removeDirty(const DirtySet& dirty, unsigned z, unsigned x, unsigned y) const
+{
+    if (dirty[z].count(key(x, y)) == 0) return;
+    std::remove(tileFile(z, x, y).c_str());
+    if (z == maxZoom_) return;
+    for (unsigned q = 0; q < 4; q++)
+        removeDirty(dirty, z + 1, 2 * x + q % 2, 2 * y + q / 2);
+}
+
+bool TilePyramid::needed(const DirtySet* dirty, unsigned z, unsigned x, unsigned y)
+{
+    if (dirty == NULL || (*dirty)[z].count(key(x, y)) > 0) return true;
+    return z > 0 && (*dirty)[z - 1].count(key(x / 2, y / 2)) > 0;
+}
+
+string TilePyramid::metadataFile() const
+{
+    return directory_ + "/pyramid.txt";
+}
+
+string TilePyramid::tileFile(unsigned z, unsigned x, unsigned y) const
+{
+    return directory_ + "/" + std::to_string(z) + "/" + std::to_string(x) + "/" + std::to_string(y) + ".png";
+}
+
+void TilePyramid::changedSegments(const EdgeTree& before, const EdgeTree& after, vector<EdgeTree::Segment>& out)
+{
+    typedef std::pair<std::tuple<double, double, double, double>, size_t> Keyed;
+    auto sorted = [](const EdgeTree& tree) {
+        vector<Keyed> keys;
+        for (size_t i = 0; i < tree.segments().size(); i++)
+            keys.push_back(Keyed(canonical(tree.segments()[i]), i));
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    };
+    vector<Keyed> a = sorted(before), b = sorted(after);
+
+    out.clear();
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        if (j == b.size() || (i < a.size() && a[i].first < b[j].first)) {
+            out.push_back(before.segments()[a[i++].second]);
+        } else if (i == a.size() || b[j].first < a[i].first) {
+            out.push_back(after.segments()[b[j++].second]);
+        } else {
+            i++;
+            j++;
+        }
+    }
+}
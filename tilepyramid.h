@@ -0,0 +1,149 @@
+/**
+ * @file tilepyramid.h
+ * Slippy-map tiles of a road network, for web map viewers.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "cs225/RGBAPNG.h"
+#include "edgetree.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * A z/x/y pyramid of 256x256 PNG tiles of a road network, written as
+ * directory/z/x/y.png.
+ *
+ * At the deepest zoom, maxZoom(), one map unit is one pixel and tiles
+ * are drawn as Graph::render draws the map; each level above halves the
+ * scale, its tiles averaged from the four tiles below them. Zoom 0 is a
+ * single tile covering [0, 256 * 2^maxZoom()) on both axes, the smallest
+ * such square that holds the whole network. Parts of the network at
+ * negative coordinates are left out.
+ *
+ * Tiles are transparent but for the network, so a viewer can lay them
+ * over any background. Only the segments near a tile are drawn on it. A
+ * tile with nothing on it is not written, and subpyramids with no
+ * segments near them are not visited, so building costs about as much as
+ * the tiles the network covers, however large the extent.
+ *
+ * build() also writes directory/pyramid.txt with maxZoom() and extent(),
+ * which a TilePyramid opened later on the same directory reads, so a
+ * later run can update() the tiles without building them again.
+ *
+ * Tiles are drawn and encoded on several threads: each thread builds the
+ * whole subpyramid below a tile of a middle level, depth first, so only
+ * a few tiles per thread are held in memory at once.
+ */
+class TilePyramid
+{
+  public:
+    /** Pixels on a side of a tile. */
+    static const unsigned TileSize = 256;
+
+    /**
+     * Opens the pyramid in a directory: with no tiles if it has none, or
+     * with the maxZoom() and extent() saved by the last build() there.
+     * @param directory - where the tiles go; created if missing
+     */
+    explicit TilePyramid(const string& directory);
+
+    /**
+     * Draws and writes every tile of a network, after picking maxZoom()
+     * from its bounds. The tiles of an earlier pyramid in the directory
+     * are removed first.
+     * @param tree - the segments of the network
+     * @param threads - number of threads; 0 for one per core
+     * @return the number of tiles written
+     */
+    size_t build(const EdgeTree& tree, unsigned threads = 0);
+
+    /**
+     * Draws again only the tiles that changed segments fall on, at every
+     * zoom, and removes the files of those left empty. Tiles around them
+     * are read back from the directory where a level above needs them. If the directory holds no pyramid, or the
+     * network has grown past extent(), the whole pyramid is built instead.
+     * @param tree - the segments of the network after the change
+     * @param changed - segments added or removed, where they were drawn;
+     *  see changedSegments()
+     * @param threads - number of threads; 0 for one per core
+     * @return the number of tiles written
+     */
+    size_t update(const EdgeTree& tree, const vector<EdgeTree::Segment>& changed, unsigned threads = 0);
+
+    /**
+     * Finds the segments of one tree that are not in another, by their
+     * coordinates in either direction.
+     * @param out - cleared and filled with the segments in just one tree
+     */
+    static void changedSegments(const EdgeTree& before, const EdgeTree& after, vector<EdgeTree::Segment>& out);
+
+    /** @return the deepest zoom level */
+    unsigned maxZoom() const { return maxZoom_; }
+
+    /**
+     * @return the side, in map units, of the square the pyramid covers:
+     *  256 * 2^maxZoom(), or 0 if no pyramid has been built
+     */
+    double extent() const { return extent_; }
+
+    /** @return the file of a tile */
+    string tileFile(unsigned z, unsigned x, unsigned y) const;
+
+  private:
+    /** For each zoom, the tiles to draw again, as x << 32 | y. */
+    typedef vector<std::unordered_set<uint64_t>> DirtySet;
+
+    string directory_;
+    unsigned maxZoom_;
+    double extent_;
+
+    /** @return the zoom at which the network fits in the pyramid */
+    static unsigned zoomFor(const EdgeTree& tree);
+
+    /** @return the file that holds maxZoom() and extent() */
+    string metadataFile() const;
+
+    /** Draws and writes the tiles of dirty, or every tile if it is NULL. */
+    size_t generate(const EdgeTree& tree, const DirtySet* dirty, unsigned threads) const;
+
+    /**
+     * Sets out to a tile, drawn again with everything below it if it is
+     * dirty, else read from its file.
+     * @return false, if the tile is empty
+     */
+    bool tile(const EdgeTree& tree, const DirtySet* dirty, unsigned z, unsigned x, unsigned y,
+              cs225::RGBAPNG& out, size_t& written) const;
+
+    /**
+     * Averages four tiles into their parent and writes it.
+     * @param children - the tiles below, left to right, top to bottom;
+     *  empty images for empty tiles
+     * @return false, if all four are empty
+     */
+    bool combine(const DirtySet* dirty, unsigned z, unsigned x, unsigned y, const cs225::RGBAPNG* children[4],
+                 cs225::RGBAPNG& out, size_t& written) const;
+
+    /**
+     * Writes a tile. The old file of an empty tile is removed in an
+     * update, where dirty is not NULL; a build starts with none.
+     */
+    void store(const DirtySet* dirty, unsigned z, unsigned x, unsigned y, bool drawn, const cs225::RGBAPNG& image,
+               size_t& written) const;
+
+    /** Removes the files of a dirty tile and the dirty tiles below it. */
+    void removeDirty(const DirtySet& dirty, unsigned z, unsigned x, unsigned y) const;
+
+    /** Reads a tile written earlier; empty if there is no file. */
+    bool load(unsigned z, unsigned x, unsigned y, cs225::RGBAPNG& out) const;
+
+    /** @return true, if a tile is dirty or is needed to draw a dirty one */
+    static bool needed(const DirtySet* dirty, unsigned z, unsigned x, unsigned y);
+};
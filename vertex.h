@@ -38,6 +38,12 @@ class Vertex {
         int getIndex() const { return index; }
         int getX() const { return x_; }
         int getY() const { return y_; }
+
+        /**
+         * Gets the coordinates without truncating them to integers.
+         */
+        double getExactX() const { return x_; }
+        double getExactY() const { return y_; }
         
         /**
          * Assignment operator for Vertex.
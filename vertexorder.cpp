@@ -0,0 +1,259 @@
+#include "vertexorder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+    typedef CsrGraph::VertexId VertexId;
+
+    /** Bits per coordinate of the Hilbert curve. */
+    const unsigned HilbertBits = 16;
+
+    /** @return the distance of cell (x, y) along a Hilbert curve */
+    uint64_t hilbertIndex(uint32_t x, uint32_t y)
+    {
+        const uint32_t side = 1u << HilbertBits;
+        uint64_t d = 0;
+        for (uint32_t s = side / 2; s > 0; s /= 2) {
+            uint32_t rx = (x & s) > 0;
+            uint32_t ry = (y & s) > 0;
+            d += (uint64_t) s * s * ((3 * rx) ^ ry);
+            // rotate the quadrant so the curve inside it starts where the
+            // previous one ended
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = side - 1 - x;
+                    y = side - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    /**
+     * Breadth-first walks that treat every arc as two-way, so one-way
+     * streets do not split a component.
+     */
+    class Walker
+    {
+      public:
+        Walker(const CsrGraph& g)
+            : g(g), reverse(g.reversed()), mark(g.numVertices(), 0), generation(0), lastLevel_(0) {}
+
+        /** @return the number of vertices adjacent to v */
+        uint32_t degree(VertexId v) const
+        {
+            uint32_t d = g.neighbors(v).size();
+            return g.isDirected() ? d + reverse.neighbors(v).size() : d;
+        }
+
+        /** Calls visit(w) for every vertex adjacent to v. */
+        template <class Visit>
+        void forEachNeighbor(VertexId v, Visit visit) const
+        {
+            for (CsrGraph::Arc arc : g.neighbors(v))
+                visit(arc.target);
+            if (g.isDirected()) {
+                for (CsrGraph::Arc arc : reverse.neighbors(v))
+                    visit(arc.target);
+            }
+        }
+
+        /**
+         * Runs a BFS from start over vertices not in done and appends the
+         * vertices it reaches to order, in the order reached.
+         * @param byDegree - visit the neighbors of each vertex by increasing
+         *  degree, as Cuthill-McKee does
+         * @return the number of levels below start; lastLevel() tells
+         *  where the deepest one begins in order
+         */
+        uint32_t walk(VertexId start, const vector<char>& done, bool byDegree, vector<VertexId>& order)
+        {
+            generation++;
+            size_t head = order.size();
+            order.push_back(start);
+            mark[start] = generation;
+            uint32_t depth = 0;
+            lastLevel_ = head;
+            while (head < order.size()) {
+                size_t levelEnd = order.size();
+                for (; head < levelEnd; head++) {
+                    size_t first = order.size();
+                    forEachNeighbor(order[head], [&](VertexId w) {
+                        if (mark[w] != generation && !done[w]) {
+                            mark[w] = generation;
+                            order.push_back(w);
+                        }
+                    });
+                    if (byDegree) {
+                        std::stable_sort(order.begin() + first, order.end(), [&](VertexId a, VertexId b) {
+                            return degree(a) < degree(b);
+                        });
+                    }
+                }
+                if (order.size() > levelEnd) {
+                    depth++;
+                    lastLevel_ = levelEnd;
+                }
+            }
+            return depth;
+        }
+
+        /** @return where the deepest level of the last walk begins */
+        size_t lastLevel() const { return lastLevel_; }
+
+      private:
+        const CsrGraph& g;
+        CsrGraph reverse;
+        vector<uint32_t> mark;
+        uint32_t generation;
+        size_t lastLevel_;
+    };
+}
+
+namespace vertexorder {
+
+    vector<VertexId> compute(const CsrGraph& g, Ordering ordering)
+    {
+        switch (ordering) {
+            case Hilbert: return hilbert(g);
+            case BreadthFirst: return breadthFirst(g);
+            case ReverseCuthillMcKee: return reverseCuthillMcKee(g);
+            default: break;
+        }
+        vector<VertexId> order(g.numVertices());
+        std::iota(order.begin(), order.end(), 0);
+        return order;
+    }
+
+    vector<VertexId> hilbert(const CsrGraph& g)
+    {
+        uint32_t n = g.numVertices();
+        double minX = std::numeric_limits<double>::infinity(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+        for (VertexId v = 0; v < n; v++) {
+            minX = std::min(minX, g.getX(v));
+            maxX = std::max(maxX, g.getX(v));
+            minY = std::min(minY, g.getY(v));
+            maxY = std::max(maxY, g.getY(v));
+        }
+        // one scale for both axes keeps the curve's cells square
+        double extent = std::max(maxX - minX, maxY - minY);
+        double scale = extent > 0 ? ((1u << HilbertBits) - 1) / extent : 0;
+
+        vector<std::pair<uint64_t, VertexId>> keys;
+        keys.reserve(n);
+        for (VertexId v = 0; v < n; v++) {
+            uint32_t x = (uint32_t) ((g.getX(v) - minX) * scale);
+            uint32_t y = (uint32_t) ((g.getY(v) - minY) * scale);
+            keys.push_back(std::make_pair(hilbertIndex(x, y), v));
+        }
+        std::sort(keys.begin(), keys.end());
+
+        vector<VertexId> order;
+        order.reserve(n);
+        for (const std::pair<uint64_t, VertexId>& key : keys)
+            order.push_back(key.second);
+        return order;
+    }
+
+    vector<VertexId> breadthFirst(const CsrGraph& g)
+    {
+        uint32_t n = g.numVertices();
+        Walker walker(g);
+        vector<char> done(n, 0);
+        vector<VertexId> order;
+        order.reserve(n);
+        for (VertexId v = 0; v < n; v++) {
+            if (done[v])
+                continue;
+            size_t first = order.size();
+            walker.walk(v, done, false, order);
+            for (size_t i = first; i < order.size(); i++)
+                done[order[i]] = 1;
+        }
+        return order;
+    }
+
+    vector<VertexId> reverseCuthillMcKee(const CsrGraph& g)
+    {
+        uint32_t n = g.numVertices();
+        Walker walker(g);
+        vector<char> done(n, 0);
+        vector<VertexId> order, scratch;
+        order.reserve(n);
+        for (VertexId v = 0; v < n; v++) {
+            if (done[v])
+                continue;
+
+            // find a pseudo-peripheral start (George and Liu): from the
+            // lowest-degree vertex of the component, move to the
+            // lowest-degree vertex of the last BFS level while that makes
+            // the BFS deeper
+            scratch.clear();
+            walker.walk(v, done, false, scratch);
+            VertexId start = v;
+            for (VertexId u : scratch) {
+                if (walker.degree(u) < walker.degree(start))
+                    start = u;
+            }
+            scratch.clear();
+            uint32_t depth = walker.walk(start, done, false, scratch);
+            for (int round = 0; round < 8; round++) {
+                VertexId candidate = scratch.back();
+                for (size_t i = walker.lastLevel(); i < scratch.size(); i++) {
+                    if (walker.degree(scratch[i]) < walker.degree(candidate))
+                        candidate = scratch[i];
+                }
+                scratch.clear();
+                uint32_t candidateDepth = walker.walk(candidate, done, false, scratch);
+                if (candidateDepth <= depth)
+                    break;
+                start = candidate;
+                depth = candidateDepth;
+            }
+
+            size_t first = order.size();
+            walker.walk(start, done, true, order);
+            for (size_t i = first; i < order.size(); i++)
+                done[order[i]] = 1;
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    vector<VertexId> inverse(const vector<VertexId>& order)
+    {
+        vector<VertexId> position(order.size());
+        for (VertexId i = 0; i < order.size(); i++)
+            position[order[i]] = i;
+        return position;
+    }
+
+    bool parse(const string& name, Ordering& ordering)
+    {
+        const Ordering all[] = {Original, Hilbert, BreadthFirst, ReverseCuthillMcKee};
+        for (Ordering candidate : all) {
+            if (name == vertexorder::name(candidate)) {
+                ordering = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    string name(Ordering ordering)
+    {
+        switch (ordering) {
+            case Hilbert: return "hilbert";
+            case BreadthFirst: return "bfs";
+            case ReverseCuthillMcKee: return "rcm";
+            default: return "original";
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file vertexorder.h
+ * Vertex orderings that improve the memory locality of graph snapshots.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "csrgraph.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Orderings of the vertices of a CsrGraph, for CsrGraph::permuted().
+ *
+ * Graph::freeze() numbers vertices in hash order, so the neighbors of a
+ * vertex are scattered over the id range and a search touches a new cache
+ * line for almost every arc. Each ordering here numbers vertices that are
+ * near each other consecutively:
+ *   - Hilbert sorts them along a Hilbert curve over their coordinates;
+ *   - BreadthFirst numbers them in the order a BFS reaches them;
+ *   - ReverseCuthillMcKee is a BFS that starts from a peripheral vertex,
+ *     takes neighbors by increasing degree and is then reversed, which
+ *     keeps the arcs of each vertex within a narrow band of ids.
+ *
+ * Every function returns order, a permutation of the ids in which
+ * order[i] is the vertex that becomes vertex i.
+ */
+namespace vertexorder {
+
+    typedef CsrGraph::VertexId VertexId;
+
+    /** The orderings available. */
+    enum Ordering { Original, Hilbert, BreadthFirst, ReverseCuthillMcKee };
+
+    /**
+     * @return the order of the given kind; Original is the identity
+     */
+    vector<VertexId> compute(const CsrGraph& g, Ordering ordering);
+
+    /** @return the vertices sorted along a Hilbert curve */
+    vector<VertexId> hilbert(const CsrGraph& g);
+
+    /**
+     * @return the vertices in BFS order, one component after another,
+     *  each started from its lowest id
+     */
+    vector<VertexId> breadthFirst(const CsrGraph& g);
+
+    /** @return the reverse Cuthill-McKee order of the vertices */
+    vector<VertexId> reverseCuthillMcKee(const CsrGraph& g);
+
+    /**
+     * @return the inverse of a permutation: for an order, the new id of
+     *  every old id
+     */
+    vector<VertexId> inverse(const vector<VertexId>& order);
+
+    /**
+     * Reads the name of an ordering: "original", "hilbert", "bfs" or
+     * "rcm".
+     * @param name - the name
+     * @param ordering - set to the ordering if the name is known
+     * @return whether the name is known
+     */
+    bool parse(const string& name, Ordering& ordering);
+
+    /** @return the name parse() reads for an ordering */
+    string name(Ordering ordering);
+}